@@ -0,0 +1,34 @@
+#!/bin/sh
+# Scheduler overhead benchmark: builds fate_sim with FATE_BENCH and the bench
+# application (v*/bench.c) for each kernel, NUM_TASKS and (v2_0) scheduling
+# policy below, runs it, and prints all results as one CSV table on stdout:
+#
+#   kernel,policy,num_tasks,path,active,unit,count,min,avg,max
+#
+# Times are host nanoseconds: compare them between kernels, task counts and
+# commits on the same machine, not with cycle counts from the Launchpad.
+# Rebuilds from clean, so run "make" again afterwards for a normal build.
+#
+#   ./bench.sh > bench.csv
+
+set -e
+cd "$(dirname "$0")"
+
+CONFIGS="v1_1:4 v1_1:8 v1_2:4 v1_2:8 v1_2:16 v1_2:32
+         v2_0:8:EDF v2_0:32:EDF v2_0:8:RM v2_0:32:RM v2_0:8:DM v2_0:32:DM v2_0:8:FP v2_0:32:FP
+         v2_0:8:LLF v2_0:32:LLF v2_0:8:EDZL v2_0:32:EDZL v2_0:8:CYCLIC v2_0:32:CYCLIC"
+
+echo "kernel,policy,num_tasks,path,active,unit,count,min,avg,max"
+for config in $CONFIGS
+do
+    kernel=${config%%:*}
+    tasks=${config#*:}
+    policy=
+    case $tasks in
+        *:*) policy="-DFATE_POLICY=FATE_POLICY_${tasks#*:}"; tasks=${tasks%%:*} ;;
+    esac
+    make -s clean
+    make -s fate_sim KERNEL=../$kernel APP=bench DEFS="-DFATE_BENCH -DNUM_TASKS=$tasks $policy" >&2
+    ./fate_sim | grep -v '^kernel,'
+done
+make -s clean
@@ -0,0 +1,133 @@
+#!/bin/sh
+# Simulator regression check. Compares the context switches (time and task)
+# of builds that must schedule alike, and exits with 1 on any difference:
+# - v2_0/main.c under EDF, ticked, tickless and FATE_HIRES, against
+#   v1_2/main.c, ticked and tickless, over one simulated minute;
+# - SETS random task sets (taskset.c, 2 to 7 periodic tasks, deadlines up to
+#   the period, 20% to 100% utilization) on the same builds, over SET_MS
+#   simulated milliseconds each (default 6000); SEED picks the task sets;
+# - then runs laxity_check.sh.
+# Prints one line per comparison that differs, and a summary line per part.
+# Rebuilds from clean, so run "make" again afterwards for a normal build.
+#
+#   ./check.sh
+#   SETS=200 SEED=7 ./check.sh
+
+set -e
+cd "$(dirname "$0")"
+
+SETS=${SETS:-60}
+SEED=${SEED:-1}
+SET_MS=${SET_MS:-6000}
+BUILDS="v1_2:- v1_2:FATE_TICKLESS v2_0:- v2_0:FATE_TICKLESS v2_0:FATE_HIRES v2_0:FATE_HIRES,FATE_TICKLESS"
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# Builds fate_sim for each of BUILDS with application $1 ("main" or "taskset")
+# into $work/<app>.<kernel>.<options>
+build()
+{
+    for config in $BUILDS
+    do
+        kernel=${config%%:*}
+        defs=
+        for option in $(echo "${config#*:}" | tr ',' ' ')
+        do
+            [ "$option" = - ] || defs="$defs -D$option"
+        done
+        if [ "$1" = main ]
+        then
+            app_dir=../$kernel
+        else
+            app_dir=.
+        fi
+        make -s clean
+        make -s fate_sim KERNEL=../$kernel APP_DIR=$app_dir APP=$1 DEFS="$defs" >&2
+        mv fate_sim "$work/$1.$kernel.${config#*:}"
+    done
+}
+
+# Context switches of build $1 over $2 simulated milliseconds
+switches()
+{
+    "$work/$1" -t "$2" -v < /dev/null | grep 'switch to task' || true
+}
+
+# Compares every build of application $1 with the first, over $2 milliseconds;
+# $3 names the run in messages. Returns 1 if any differs.
+compare()
+{
+    status=0
+    reference=
+    for config in $BUILDS
+    do
+        name=$1.${config%%:*}.${config#*:}
+        switches "$name" "$2" > "$work/$name.out"
+        if [ -z "$reference" ]
+        then
+            reference=$name
+            if [ ! -s "$work/$name.out" ]
+            then
+                echo "$3: $name: no context switch"
+                status=1
+            fi
+        elif ! cmp -s "$work/$reference.out" "$work/$name.out"
+        then
+            echo "$3: ${config%%:*} ${config#*:} differs from $reference:"
+            diff "$work/$reference.out" "$work/$name.out" | head -4
+            status=1
+        fi
+    done
+    return $status
+}
+
+failed=0
+
+build main
+if compare main 60000 main.c
+then
+    echo "main.c: v2.0 EDF context switches match v1.2's"
+else
+    failed=1
+fi
+
+build taskset
+# One task set per line: "period,start_offset,deadline,work" per task (see taskset.c)
+awk -v sets="$SETS" -v seed="$SEED" 'BEGIN {
+    srand(seed)
+    for(s = 0; s < sets; s++)
+    {
+        n = 2 + int(rand() * 6)
+        left = 0.2 + rand() * 0.8
+        line = ""
+        for(i = 0; i < n; i++)
+        {
+            period = 5 + int(rand() * 96)
+            deadline = int(period / 2) + 1 + int(rand() * (period - int(period / 2)))
+            offset = int(rand() * period)
+            share = (i == n - 1) ? left : left * rand() * 0.7
+            left -= share
+            work = int(share * period * 10040)
+            line = line (i ? " " : "") period "," offset "," deadline "," (work ? work : 1)
+        }
+        print line
+    }
+}' > "$work/sets"
+mismatches=0
+set=0
+while read -r TASKSET
+do
+    set=$((set + 1))
+    export TASKSET
+    if ! compare taskset $SET_MS "task set $set ($TASKSET)"
+    then
+        mismatches=$((mismatches + 1))
+    fi
+done < "$work/sets"
+echo "$SETS random task sets (seed $SEED): $mismatches differ"
+[ $mismatches -eq 0 ] || failed=1
+
+make -s clean
+./laxity_check.sh || failed=1
+exit $failed
@@ -0,0 +1,697 @@
+/*****************************************************
+
+
+ FATE_OS_CYCLIC v1.0
+ The "Fake Time Environment Operating System"
+
+ Developed by
+ Paulo Garcia
+ Dpt. of Systems and Computer Engineering
+ Carleton University
+ Ottawa, Ontario, Canada
+
+ This code if for educational purposes only (SYSC3310 - Introduction to Real Time Systems)
+ We do not guarantee this code will work on any given situation.
+ Do not use this code in production software.
+
+
+ Offline schedule synthesis for a v2.0 kernel built with FATE_POLICY_CYCLIC.
+
+ Reads a task set, and simulates one cycle (the hyperperiod: the least common
+ multiple of the periods) of its schedule under a priority driven policy. The
+ schedule is printed as a dispatch table for "Task_set_table"; a Gantt chart
+ of the cycle, and each task's worst case response time, are printed on stderr.
+
+ The task set is read from the FATE_ADMISSION form of the "Task_add" calls of a
+ C source file (e.g. main.c; other calls, and lines commented out with //, are
+ ignored), or from a file of one task per line (# starts a comment), with the
+ arguments of "Task_add" in the same order:
+
+   name period offset deadline priority wcet
+
+ with the period, start offset and deadline in system ticks, and the worst case
+ execution time in microseconds. A "Task_event_add" call (FATE_ADMISSION form),
+ or a "name event" line, adds an aperiodic task: it is not in the table (it runs
+ in the time the table leaves idle), but takes a position in "Task_list", like
+ every task, in the order the tasks are added. Entries name tasks by position.
+ "Task_add_us", "Task_add_ms", "Task_event_add_us" and "Task_event_add_ms" calls
+ are read too, their times converted to ticks as the kernel does (rounded to the
+ nearest, and refused if off by more than TIME_TOLERANCE). Ticks are of the
+ default length: a source file that calls "Task_set_tick" is refused.
+
+ Time is simulated in whole ticks, the table's resolution: a job takes its
+ execution time rounded up to whole ticks (one that finishes early leaves the
+ rest of its slot to other jobs). The simulation jumps from one release or job
+ completion to the next, so its cost grows with the number of jobs, not the
+ length of the cycle. As in the kernel, a release is skipped if the task's
+ previous job is still active, and a start offset only delays the releases by
+ less than a period (a table repeats: only the offset modulo the period counts).
+
+ The schedule is periodic once no more work is carried into a cycle than out
+ of it: cycles are simulated until one starts and ends in the same state, and
+ that one becomes the table (entries that resume a job carried over from the
+ previous cycle find it not started yet in the first cycle, and give its time
+ to other jobs). Response times are those of the jobs that complete in it.
+
+ Usage: fate_cyclic [-p edf|rm|dm|fp] [-n name] [-w width] [file]
+   -p  policy the schedule is built with (default edf)
+   -n  name of the table (default schedule)
+   -w  width of the Gantt chart, in characters (default 72)
+   file  task set or C source (default standard input)
+
+ Exits with status 1 if a job misses its deadline (after printing the table).
+
+ ******************************************************/
+
+#include <msp.h>
+#include "fate.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum policy {
+    POLICY_EDF,
+    POLICY_RM,
+    POLICY_DM,
+    POLICY_FP
+};
+
+// Most cycles simulated in search of one that repeats
+#define MAX_CYCLES 16
+
+// Task set, in "Task_list" order (position in "Task_list" minus one)
+static struct task {
+    char name[64];
+    int event;
+    uint32_t period;
+    uint32_t offset;
+    uint32_t deadline;
+    long priority;
+    uint64_t wcet;
+    uint64_t ticks;             // execution time, rounded up to whole ticks
+    // Simulation state
+    uint64_t next_release;
+    int due;                    // released on the current tick (or the release skipped)
+    uint64_t released;          // release of the active job
+    uint64_t absolute_deadline;
+    uint64_t remaining;         // ticks of work the active job has left (0: not active)
+    // Jobs that completed in the current cycle
+    uint64_t worst;
+    uint64_t jobs;
+    uint64_t misses;
+    uint64_t skipped;
+} tasks[NUM_TASKS - 1];
+
+// Calls that add a task, and the unit of their times in microseconds (0: system ticks)
+static const struct call {
+    const char *name;
+    int event;
+    unsigned long unit_us;
+} calls[] = {
+    {"Task_add(", 0, 0},
+    {"Task_add_us(", 0, 1},
+    {"Task_add_ms(", 0, 1000},
+    {"Task_event_add(", 1, 0},
+    {"Task_event_add_us(", 1, 1},
+    {"Task_event_add_ms(", 1, 1000}
+};
+
+static int num_tasks;
+static enum policy policy = POLICY_EDF;
+static const char *table_name = "schedule";
+static int chart_width = 72;
+
+// Dispatch table of the cycle being simulated
+static cyclic_entry *entries;
+static size_t num_entries, entries_size;
+
+// Who ran when in the cycle being simulated, from each segment's start to the next one's
+static struct segment {
+    uint64_t start;
+    int task;                   // -1: idle
+} *segments;
+static size_t num_segments, segments_size;
+
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: fate_cyclic [-p edf|rm|dm|fp] [-n name] [-w width] [file]\n");
+    exit(2);
+}
+
+static void *grow(void *array, size_t *size, size_t element)
+{
+    *size = *size ? *size * 2 : 1024;
+    if(!(array = realloc(array, *size * element)))
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(2);
+    }
+    return array;
+}
+
+/**
+ *  Does the active job of task "a" run ahead of that of task "b"?
+ *  (as "deadline_heap" or "higher_priority" in the kernel: ties go to the task added first)
+ */
+static int runs_before(const struct task *a, const struct task *b)
+{
+    switch(policy)
+    {
+        case POLICY_EDF:
+            if(a->absolute_deadline != b->absolute_deadline)
+                return a->absolute_deadline < b->absolute_deadline;
+            break;
+        case POLICY_FP:
+            if(a->priority != b->priority)
+                return a->priority > b->priority;
+            break;
+        case POLICY_RM:
+            if(a->period != b->period)
+                return a->period < b->period;
+            break;
+        case POLICY_DM:
+            if(a->deadline != b->deadline)
+                return a->deadline < b->deadline;
+            break;
+    }
+    return a < b;
+}
+
+/**
+ *  Task whose active job runs (-1 if none is active)
+ */
+static int running(void)
+{
+    int i, best = -1;
+
+    for(i=0;i<num_tasks;i++)
+    {
+        if(tasks[i].remaining && ((best < 0) || runs_before(&tasks[i], &tasks[best])))
+            best = i;
+    }
+    return best;
+}
+
+static void add_entry(uint64_t tick, int task, enum cyclic_action action)
+{
+    if(num_entries == entries_size)
+        entries = grow(entries, &entries_size, sizeof(*entries));
+    entries[num_entries].tick = (uint32_t)tick;
+    entries[num_entries].task = (uint8_t)(task + 1);
+    entries[num_entries].action = action;
+    num_entries++;
+}
+
+static void add_segment(uint64_t start, int task)
+{
+    if(num_segments == segments_size)
+        segments = grow(segments, &segments_size, sizeof(*segments));
+    segments[num_segments].start = start;
+    segments[num_segments].task = task;
+    num_segments++;
+}
+
+/**
+ *  Simulates one cycle, from tick "start" to "start + cycle", given the task that
+ *  was running at its start: fills in the entries, segments and response times
+ *  of the cycle, and returns the task running at its end
+ */
+static int simulate_cycle(uint64_t start, uint64_t cycle, int previous)
+{
+    uint64_t now = start, end = start + cycle, next, response;
+    int i, run, released;
+    struct task *task;
+
+    num_entries = 0;
+    num_segments = 0;
+    for(i=0;i<num_tasks;i++)
+    {
+        tasks[i].worst = 0;
+        tasks[i].jobs = 0;
+        tasks[i].misses = 0;
+        tasks[i].skipped = 0;
+    }
+
+    while(now < end)
+    {
+        //Releases due now (the job that ran up to now has been charged already)
+        released = 0;
+        for(i=0;i<num_tasks;i++)
+        {
+            task = &tasks[i];
+            task->due = !task->event && (task->next_release == now);
+            if(!task->due)
+                continue;
+            task->next_release += task->period;
+            if(task->remaining)
+                task->skipped++;
+            else
+            {
+                task->released = now;
+                task->absolute_deadline = now + task->deadline;
+                task->remaining = task->ticks;
+            }
+            released = 1;
+        }
+        run = running();
+
+        //Entries: every release, then the task the CPU goes to, last
+        if(released || (run != previous))
+        {
+            for(i=0;i<num_tasks;i++)
+            {
+                if(tasks[i].due && (i != run))
+                    add_entry(now - start, i, CYCLIC_RELEASE);
+            }
+            add_entry(now - start, run, ((run >= 0) && tasks[run].due) ? CYCLIC_RELEASE : CYCLIC_RESUME);
+        }
+        if((run != previous) || !num_segments)
+            add_segment(now - start, run);
+        previous = run;
+
+        //Next event: a release, or the running job completing
+        next = end;
+        for(i=0;i<num_tasks;i++)
+        {
+            if(!tasks[i].event && (tasks[i].next_release < next))
+                next = tasks[i].next_release;
+        }
+        if((run >= 0) && (now + tasks[run].remaining < next))
+            next = now + tasks[run].remaining;
+        if(run >= 0)
+        {
+            task = &tasks[run];
+            task->remaining -= next - now;
+            if(!task->remaining)
+            {
+                response = next - task->released;
+                task->jobs++;
+                if(response > task->worst)
+                    task->worst = response;
+                if(response > task->deadline)
+                    task->misses++;
+            }
+        }
+        now = next;
+    }
+    return previous;
+}
+
+/**
+ *  Does the state at tick "now" match that saved at tick "then"?
+ */
+static int same_state(const struct task *saved, uint64_t then, int saved_run, uint64_t now, int run)
+{
+    int i;
+
+    if(saved_run != run)
+        return 0;
+    for(i=0;i<num_tasks;i++)
+    {
+        if(tasks[i].event)
+            continue;
+        if((tasks[i].remaining != saved[i].remaining) ||
+           (tasks[i].next_release - now != saved[i].next_release - then))
+            return 0;
+        if(tasks[i].remaining && ((tasks[i].released - now != saved[i].released - then) ||
+                                  (tasks[i].absolute_deadline - now != saved[i].absolute_deadline - then)))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ *  Prints a Gantt chart of the cycle: one row per task (and idle), one column per
+ *  "cycle / chart_width" ticks (at least one): '#' if the task ran the whole time,
+ *  '+' if part of it
+ */
+static void print_gantt(uint64_t cycle)
+{
+    uint64_t *busy, from, to, a, b;
+    size_t k;
+    int row, column, width = (cycle < (uint64_t)chart_width) ? (int)cycle : chart_width;
+
+    busy = calloc((size_t)(num_tasks + 1) * (size_t)width, sizeof(*busy));
+    if(!busy)
+        return;
+    for(k=0;k<num_segments;k++)
+    {
+        row = (segments[k].task < 0) ? num_tasks : segments[k].task;
+        from = segments[k].start;
+        to = (k + 1 < num_segments) ? segments[k + 1].start : cycle;
+        //Spread the segment over the columns it covers
+        for(column = (int)(from * (uint64_t)width / cycle); (column < width) && (from < to); column++)
+        {
+            a = (uint64_t)column * cycle / (uint64_t)width;
+            b = (uint64_t)(column + 1) * cycle / (uint64_t)width;
+            if(from > a)
+                a = from;
+            if(to < b)
+                b = to;
+            if(b > a)
+                busy[row * width + column] += b - a;
+        }
+    }
+
+    fprintf(stderr, "\n%-16s  0%*llu ticks\n", "", width - 1, (unsigned long long)cycle);
+    for(row=0;row<=num_tasks;row++)
+    {
+        if((row < num_tasks) && tasks[row].event)
+            continue;
+        fprintf(stderr, "%-16s |", (row < num_tasks) ? tasks[row].name : "idle");
+        for(column=0;column<width;column++)
+        {
+            a = (uint64_t)column * cycle / (uint64_t)width;
+            b = (uint64_t)(column + 1) * cycle / (uint64_t)width;
+            if(!busy[row * width + column])
+                fputc((b > a) ? '.' : ' ', stderr);
+            else
+                fputc((busy[row * width + column] == b - a) ? '#' : '+', stderr);
+        }
+        fprintf(stderr, "|\n");
+    }
+    free(busy);
+}
+
+static uint64_t gcd(uint64_t a, uint64_t b)
+{
+    uint64_t t;
+
+    while(b)
+    {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/**
+ *  Reads the arguments of a "Task_add" or "Task_event_add" call, or a task line,
+ *  into "fields" (the function name first); returns how many there are
+ */
+static int split(char *text, char **fields, int max)
+{
+    char *token;
+    int n = 0;
+
+    for(token = strtok(text, " \t\r\n(),;"); token && (n < max); token = strtok((char *)0, " \t\r\n(),;"))
+    {
+        //Casts of the function to intptr_t
+        if(!strcmp(token, "intptr_t"))
+            continue;
+        fields[n++] = token;
+    }
+    return n;
+}
+
+static unsigned long number(const char *field, int line)
+{
+    char *end;
+    unsigned long value = strtoul(field, &end, 0);
+
+    //Integer suffixes, as in C
+    while(*end && strchr("uUlL", *end))
+        end++;
+    if(*end)
+    {
+        fprintf(stderr, "line %d: \"%s\" is not a number\n", line, field);
+        exit(1);
+    }
+    return value;
+}
+
+/**
+ *  Finds the first call in "text" that adds a task; returns its entry in "calls"
+ *  and sets "call" to its opening parenthesis, or returns 0
+ */
+static const struct call *find_call(char *text, char **call)
+{
+    const struct call *found = 0;
+    char *at;
+    size_t i;
+
+    for(i=0;i<sizeof(calls)/sizeof(calls[0]);i++)
+    {
+        at = strstr(text, calls[i].name);
+        if(at && (!found || (at < *call)))
+        {
+            found = &calls[i];
+            *call = at;
+        }
+    }
+    if(found)
+        *call += strlen(found->name) - 1;
+    return found;
+}
+
+/**
+ *  Converts a time of a _us or _ms call ("unit_us" microseconds per unit) to system
+ *  ticks of the default length, rounded to the nearest as by the kernel; exits if
+ *  it is off by more than TIME_TOLERANCE, as the kernel would refuse the task
+ */
+static uint32_t time_ticks(unsigned long time, unsigned long unit_us, int line)
+{
+    uint64_t tick = (uint64_t)(TICK_COUNTS + 1) * 1000000, scaled, ticks, diff;
+
+    if(!unit_us)
+        return (uint32_t)time;
+    scaled = (uint64_t)time * unit_us * TIMER_HZ;
+    ticks = (scaled + tick / 2) / tick;
+    diff = (ticks * tick > scaled) ? (ticks * tick - scaled) : (scaled - ticks * tick);
+    if((ticks > UINT32_MAX) || (diff > scaled / 1000 * TIME_TOLERANCE))
+    {
+        fprintf(stderr, "line %d: %lu%s is not a whole number of %lu us ticks (the kernel refuses it)\n",
+                line, time, (unit_us == 1) ? "us" : "ms", (unsigned long)TICK_US);
+        exit(1);
+    }
+    return (uint32_t)ticks;
+}
+
+static void read_tasks(FILE *in)
+{
+    char (*lines)[512] = 0, *text, *call = 0, *fields[8], *comment;
+    size_t num_lines = 0, lines_size = 0;
+    int line, n, event, source = 0;
+    const struct call *added;
+    unsigned long unit_us;
+    struct task *task;
+
+    //A C source file if any line calls "Task_add" or "Task_event_add" (or their
+    //_us and _ms forms)
+    for(;;)
+    {
+        if(num_lines == lines_size)
+            lines = grow(lines, &lines_size, sizeof(*lines));
+        if(!fgets(lines[num_lines], sizeof(*lines), in))
+            break;
+        num_lines++;
+    }
+    for(line=0;line<(int)num_lines;line++)
+    {
+        if(find_call(lines[line], &call))
+            source = 1;
+    }
+
+    for(line=1;line<=(int)num_lines;line++)
+    {
+        text = lines[line - 1];
+        event = 0;
+        unit_us = 0;
+        call = 0;
+        if((added = find_call(text, &call)))
+        {
+            event = added->event;
+            unit_us = added->unit_us;
+        }
+        //Ticks of another length than the default would make the table wrong
+        else if(source && (call = strstr(text, "Task_set_tick(")))
+        {
+            comment = strstr(text, "//");
+            if(!comment || (comment > call))
+            {
+                fprintf(stderr, "line %d: Task_set_tick: only the default tick (%lu us) is supported\n",
+                        line, (unsigned long)TICK_US);
+                exit(1);
+            }
+            continue;
+        }
+        if(added)
+        {
+            //Commented out
+            comment = strstr(text, "//");
+            if(comment && (comment < call))
+                continue;
+            n = split(call, fields, 8);
+            //Calls without the execution time (FATE_ADMISSION off) are skipped
+            if(n != 6)
+                continue;
+        }
+        else if(source)
+            continue;
+        else
+        {
+            if((comment = strchr(text, '#')))
+                *comment = '\0';
+            n = split(text, fields, 8);
+            if(!n)
+                continue;
+            event = (n == 2) && !strcmp(fields[1], "event");
+            if(!event && (n != 6))
+            {
+                fprintf(stderr, "line %d: expected \"name period offset deadline priority wcet\" or \"name event\"\n",
+                        line);
+                exit(1);
+            }
+        }
+        if(num_tasks == NUM_TASKS - 1)
+        {
+            fprintf(stderr, "line %d: more than %d tasks\n", line, NUM_TASKS - 1);
+            exit(1);
+        }
+        task = &tasks[num_tasks++];
+        memset(task, 0, sizeof(*task));
+        snprintf(task->name, sizeof(task->name), "%s", fields[0]);
+        task->event = event;
+        if(event)
+            continue;
+        task->period = time_ticks(number(fields[1], line), unit_us, line);
+        task->offset = time_ticks(number(fields[2], line), unit_us, line);
+        task->deadline = time_ticks(number(fields[3], line), unit_us, line);
+        task->priority = (long)number(fields[4], line);
+        task->wcet = number(fields[5], line);
+        task->ticks = (task->wcet + TICK_US - 1) / TICK_US;
+        if(!task->period || !task->deadline || !task->ticks)
+        {
+            fprintf(stderr, "line %d: period, deadline and execution time must not be 0\n", line);
+            exit(1);
+        }
+    }
+    free(lines);
+}
+
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    struct task saved[NUM_TASKS - 1];
+    uint64_t cycle = 1, utilization = 0, start;
+    int i, c, run = -1, saved_run, periodic = 0, missed = 0, carried = 0;
+
+    for(i=1;i<argc;i++)
+    {
+        if(!strcmp(argv[i], "-p") && (i + 1 < argc))
+        {
+            i++;
+            if(!strcmp(argv[i], "edf"))
+                policy = POLICY_EDF;
+            else if(!strcmp(argv[i], "rm"))
+                policy = POLICY_RM;
+            else if(!strcmp(argv[i], "dm"))
+                policy = POLICY_DM;
+            else if(!strcmp(argv[i], "fp"))
+                policy = POLICY_FP;
+            else
+                usage();
+        }
+        else if(!strcmp(argv[i], "-n") && (i + 1 < argc))
+            table_name = argv[++i];
+        else if(!strcmp(argv[i], "-w") && (i + 1 < argc))
+        {
+            chart_width = atoi(argv[++i]);
+            if(chart_width < 8)
+                usage();
+        }
+        else if((argv[i][0] != '-') && (in == stdin))
+        {
+            if(!(in = fopen(argv[i], "r")))
+            {
+                perror(argv[i]);
+                return 2;
+            }
+        }
+        else
+            usage();
+    }
+
+    read_tasks(in);
+    for(i=0;i<num_tasks;i++)
+    {
+        if(tasks[i].event)
+            continue;
+        periodic++;
+        cycle = cycle / gcd(cycle, tasks[i].period) * tasks[i].period;
+        if(cycle > UINT32_MAX)
+        {
+            fprintf(stderr, "hyperperiod of more than %lu ticks\n", (unsigned long)UINT32_MAX);
+            return 1;
+        }
+        //Rounded up, as the ticks the jobs take
+        utilization += (tasks[i].ticks << 20) / tasks[i].period;
+        tasks[i].next_release = tasks[i].offset % tasks[i].period;
+    }
+    if(!periodic)
+    {
+        fprintf(stderr, "no periodic tasks (with their execution times: the FATE_ADMISSION form of Task_add)\n");
+        return 1;
+    }
+    //The work carried from cycle to cycle would grow for ever
+    if(utilization > ((uint64_t)1 << 20))
+    {
+        fprintf(stderr, "utilization over 100%% (execution times rounded up to whole ticks)\n");
+        return 1;
+    }
+
+    //Cycles until one starts and ends in the same state
+    for(c=0,start=0;c<MAX_CYCLES;c++,start+=cycle)
+    {
+        memcpy(saved, tasks, sizeof(saved));
+        saved_run = run;
+        run = simulate_cycle(start, cycle, run);
+        if(same_state(saved, start, saved_run, start + cycle, run))
+            break;
+    }
+    if(c == MAX_CYCLES)
+    {
+        fprintf(stderr, "no repeating schedule after %d cycles\n", MAX_CYCLES);
+        return 1;
+    }
+
+    printf("/* fate_cyclic -p %s: cycle of %llu ticks, %lu entries (%lu bytes) */\n",
+           (policy == POLICY_EDF) ? "edf" : (policy == POLICY_RM) ? "rm" : (policy == POLICY_DM) ? "dm" : "fp",
+           (unsigned long long)cycle, (unsigned long)num_entries, (unsigned long)(num_entries * sizeof(cyclic_entry)));
+    printf("static const cyclic_entry %s[] = {\n", table_name);
+    for(i=0;i<(int)num_entries;i++)
+    {
+        printf("    {%lu, %u, %s}%s /* %s */\n", (unsigned long)entries[i].tick, entries[i].task,
+               (entries[i].action == CYCLIC_RELEASE) ? "CYCLIC_RELEASE" : "CYCLIC_RESUME",
+               (i + 1 < (int)num_entries) ? "," : "", entries[i].task ? tasks[entries[i].task - 1].name : "idle");
+    }
+    printf("};\n");
+    printf("/* Task_set_table(%s, sizeof(%s) / sizeof(%s[0]), %llu); */\n",
+           table_name, table_name, table_name, (unsigned long long)cycle);
+
+    fprintf(stderr, "task              position  ticks  deadline  response  jobs  misses  skipped\n");
+    for(i=0;i<num_tasks;i++)
+    {
+        if(tasks[i].event)
+            continue;
+        fprintf(stderr, "%-16s  %8d  %5llu  %8lu  %8llu  %4llu  %6llu  %7llu\n", tasks[i].name, i + 1,
+                (unsigned long long)tasks[i].ticks, (unsigned long)tasks[i].deadline,
+                (unsigned long long)tasks[i].worst, (unsigned long long)tasks[i].jobs,
+                (unsigned long long)tasks[i].misses, (unsigned long long)tasks[i].skipped);
+        if(tasks[i].misses || tasks[i].skipped)
+            missed = 1;
+    }
+    for(i=0;i<num_tasks;i++)
+    {
+        if(saved[i].remaining)
+            carried = 1;
+    }
+    if(carried)
+        fprintf(stderr, "jobs carried over from one cycle to the next: the table repeats from cycle %d\n", c + 1);
+    print_gantt(cycle);
+    return missed;
+}
@@ -0,0 +1,349 @@
+/*****************************************************
+
+
+ FATE_OS_THRESHOLD v1.0
+ The "Fake Time Environment Operating System"
+
+ Developed by
+ Paulo Garcia
+ Dpt. of Systems and Computer Engineering
+ Carleton University
+ Ottawa, Ontario, Canada
+
+ This code if for educational purposes only (SYSC3310 - Introduction to Real Time Systems)
+ We do not guarantee this code will work on any given situation.
+ Do not use this code in production software.
+
+
+ Offline preemption threshold assignment for a v2.0 kernel built with
+ FATE_PREEMPTION_THRESHOLD and a fixed priority policy.
+
+ Reads a task set, one task per line (# starts a comment):
+
+   name periodic|event period deadline wcet [priority]
+
+ with the period (for event tasks, the minimum number of ticks between
+ events) and deadline in system ticks, and the worst case execution time
+ in microseconds, as given to "Task_add" and "Task_event_add". Tasks are
+ ranked as the kernel ranks them (ties broken by the order of the lines,
+ which should be the order the tasks are added in).
+
+ Each task's threshold is then raised, one priority level at a time, for as
+ long as every task still meets its deadline (Saksena and Wang's greedy
+ assignment, with the kernel's response time analysis). The thresholds are
+ printed as "Task_set_threshold" calls to paste after the tasks are added;
+ response times, and the number of jobs (and stacks) that can be started
+ at once, are printed on stderr.
+
+ Usage: fate_threshold [-p rm|dm|fp] [file]
+   -p  fixed priority policy (default fp: the priority column)
+   file  task set (default standard input)
+
+ ******************************************************/
+
+#include <msp.h>
+#include "fate.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum policy {
+    POLICY_RM,
+    POLICY_DM,
+    POLICY_FP
+};
+
+// Task set, in priority order once ranked (0 is the highest)
+static struct task {
+    char name[64];
+    int event;
+    uint32_t period;
+    uint32_t deadline;
+    uint64_t wcet;
+    long priority;
+    int line;
+    int threshold;      // rank of the preemption threshold
+} tasks[NUM_TASKS - 1];
+
+static int num_tasks;
+static enum policy policy = POLICY_FP;
+
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: fate_threshold [-p rm|dm|fp] [file]\n");
+    exit(2);
+}
+
+/**
+ *  Period and relative deadline of a task for the analysis, in microseconds
+ *  (as in the kernel's admission test)
+ */
+static uint64_t analysis_period(const struct task *task)
+{
+    return (uint64_t)task->period * TICK_US;
+}
+
+static uint64_t analysis_deadline(const struct task *task)
+{
+    return (uint64_t)task->deadline * TICK_US;
+}
+
+/**
+ *  Does task "a" have a higher priority than task "b"? (as "higher_priority" in the kernel)
+ */
+static int higher_priority(const struct task *a, const struct task *b)
+{
+    uint32_t rate_a, rate_b;
+
+    switch(policy)
+    {
+        case POLICY_FP:
+            if(a->priority != b->priority)
+                return a->priority > b->priority;
+            break;
+        case POLICY_RM:
+            //Aperiodic tasks rank by their deadline
+            rate_a = a->event ? a->deadline : a->period;
+            rate_b = b->event ? b->deadline : b->period;
+            if(rate_a != rate_b)
+                return rate_a < rate_b;
+            break;
+        case POLICY_DM:
+            if(a->deadline != b->deadline)
+                return a->deadline < b->deadline;
+            break;
+    }
+    return a->line < b->line;
+}
+
+/**
+ *  Worst case response time of the task of rank r, in microseconds, with the
+ *  current thresholds (as "task_set_schedulable" in the kernel); stops as soon
+ *  as it exceeds "limit", and returns a value above it
+ */
+static uint64_t response_time(int r, uint64_t limit)
+{
+    struct task *task = &tasks[r];
+    uint64_t blocking = 0, start, finish, next, period, q, worst = 0;
+    int j;
+
+    for(j=r+1;j<num_tasks;j++)
+    {
+        if((tasks[j].threshold <= r) && (tasks[j].wcet > blocking))
+            blocking = tasks[j].wcet;
+    }
+    for(q=0;;q++)
+    {
+        start = blocking + q * task->wcet;
+        do {
+            next = blocking + q * task->wcet;
+            for(j=0;j<r;j++)
+            {
+                period = analysis_period(&tasks[j]);
+                next += (start / period + 1) * tasks[j].wcet;
+            }
+            if(next == start)
+                break;
+            start = next;
+        } while(start - q * analysis_period(task) <= limit);
+        finish = start + task->wcet;
+        while(finish - q * analysis_period(task) <= limit)
+        {
+            next = start + task->wcet;
+            for(j=0;j<task->threshold;j++)
+            {
+                period = analysis_period(&tasks[j]);
+                next += ((finish + period - 1) / period - start / period - 1) * tasks[j].wcet;
+            }
+            if(next == finish)
+                break;
+            finish = next;
+        }
+        if(finish - q * analysis_period(task) > worst)
+            worst = finish - q * analysis_period(task);
+        if(worst > limit)
+            return worst;
+        if(finish <= (q + 1) * analysis_period(task))
+            return worst;
+    }
+}
+
+/**
+ *  Response time bound of the task of rank r: its deadline, or its period if shorter
+ */
+static uint64_t response_limit(int r)
+{
+    uint64_t limit = analysis_deadline(&tasks[r]);
+
+    if(analysis_period(&tasks[r]) < limit)
+        limit = analysis_period(&tasks[r]);
+    return limit;
+}
+
+static int schedulable(int r)
+{
+    return response_time(r, response_limit(r)) <= response_limit(r);
+}
+
+/**
+ *  Largest number of jobs started at once: a job preempts started jobs only if
+ *  its task ranks above all of their thresholds
+ */
+static int max_started(void)
+{
+    int depth[NUM_TASKS], r, j, most = 0;
+
+    for(r=num_tasks-1;r>=0;r--)
+    {
+        depth[r] = 1;
+        for(j=r+1;j<num_tasks;j++)
+        {
+            if((r < tasks[j].threshold) && (depth[j] + 1 > depth[r]))
+                depth[r] = depth[j] + 1;
+        }
+        if(depth[r] > most)
+            most = depth[r];
+    }
+    return most;
+}
+
+static void read_tasks(FILE *in)
+{
+    char text[256], kind[16];
+    unsigned long period, deadline, wcet;
+    int line = 0, fields, r;
+    struct task task;
+
+    while(fgets(text, sizeof(text), in))
+    {
+        line++;
+        if(strchr(text, '#'))
+            *strchr(text, '#') = '\0';
+        memset(&task, 0, sizeof(task));
+        fields = sscanf(text, "%63s %15s %lu %lu %lu %ld", task.name, kind,
+                        &period, &deadline, &wcet, &task.priority);
+        if(fields <= 0)
+            continue;
+        if((fields < 5) || (strcmp(kind, "periodic") && strcmp(kind, "event")) ||
+           !period || !deadline || ((policy == POLICY_FP) && (fields < 6)))
+        {
+            fprintf(stderr, "line %d: expected \"name periodic|event period deadline wcet%s\"\n",
+                    line, (policy == POLICY_FP) ? " priority" : " [priority]");
+            exit(1);
+        }
+        if(num_tasks == NUM_TASKS - 1)
+        {
+            fprintf(stderr, "line %d: more than %d tasks\n", line, NUM_TASKS - 1);
+            exit(1);
+        }
+        task.event = !strcmp(kind, "event");
+        task.period = (uint32_t)period;
+        task.deadline = (uint32_t)deadline;
+        task.wcet = wcet;
+        task.line = line;
+        //Insertion sort into priority order
+        for(r = num_tasks; (r > 0) && higher_priority(&task, &tasks[r - 1]); r--)
+            tasks[r] = tasks[r - 1];
+        tasks[r] = task;
+        num_tasks++;
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    uint64_t before[NUM_TASKS], utilization = 0;
+    int i, r, preemptive_stacks;
+
+    for(i=1;i<argc;i++)
+    {
+        if(!strcmp(argv[i], "-p") && (i + 1 < argc))
+        {
+            i++;
+            if(!strcmp(argv[i], "rm"))
+                policy = POLICY_RM;
+            else if(!strcmp(argv[i], "dm"))
+                policy = POLICY_DM;
+            else if(!strcmp(argv[i], "fp"))
+                policy = POLICY_FP;
+            else
+                usage();
+        }
+        else if((argv[i][0] != '-') && (in == stdin))
+        {
+            if(!(in = fopen(argv[i], "r")))
+            {
+                perror(argv[i]);
+                return 2;
+            }
+        }
+        else
+            usage();
+    }
+
+    read_tasks(in);
+    if(!num_tasks)
+    {
+        fprintf(stderr, "no tasks\n");
+        return 1;
+    }
+
+    //The busy periods would never end
+    for(r=0;r<num_tasks;r++)
+        utilization += (tasks[r].wcet << 20) / analysis_period(&tasks[r]);
+    if(utilization >= ((uint64_t)1 << 20))
+    {
+        fprintf(stderr, "utilization of 100%% or more\n");
+        return 1;
+    }
+
+    //Fully preemptive to begin with: every task must be schedulable already
+    for(r=0;r<num_tasks;r++)
+        tasks[r].threshold = r;
+    preemptive_stacks = max_started();
+    for(r=0;r<num_tasks;r++)
+    {
+        before[r] = response_time(r, response_limit(r));
+        if(before[r] > response_limit(r))
+        {
+            fprintf(stderr, "%s misses its deadline even fully preemptive\n", tasks[r].name);
+            return 1;
+        }
+    }
+
+    //Highest priority first: raise each threshold while the task it stops
+    //preempting still meets its deadline (the task itself only gets faster)
+    for(r=0;r<num_tasks;r++)
+    {
+        while(tasks[r].threshold > 0)
+        {
+            if(!schedulable(--tasks[r].threshold))
+            {
+                tasks[r].threshold++;
+                break;
+            }
+        }
+    }
+
+    for(r=0;r<num_tasks;r++)
+    {
+        if(tasks[r].threshold != r)
+            printf("    Task_set_threshold((intptr_t)%s, (intptr_t)%s);\n",
+                   tasks[r].name, tasks[tasks[r].threshold].name);
+    }
+
+    fprintf(stderr, "rank  task              threshold          deadline (us)  response (us)  fully preemptive\n");
+    for(r=0;r<num_tasks;r++)
+    {
+        fprintf(stderr, "%4d  %-16s  %-16s  %13llu  %13llu  %16llu\n", r, tasks[r].name,
+                tasks[tasks[r].threshold].name, (unsigned long long)response_limit(r),
+                (unsigned long long)response_time(r, response_limit(r)),
+                (unsigned long long)before[r]);
+    }
+    fprintf(stderr, "at most %d jobs started at once (%d fully preemptive)\n",
+            max_started(), preemptive_stacks);
+    return 0;
+}
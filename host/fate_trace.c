@@ -0,0 +1,402 @@
+/*****************************************************
+
+
+ FATE_OS_TRACE v1.0
+ The "Fake Time Environment Operating System"
+
+ Developed by
+ Paulo Garcia
+ Dpt. of Systems and Computer Engineering
+ Carleton University
+ Ottawa, Ontario, Canada
+
+ This code if for educational purposes only (SYSC3310 - Introduction to Real Time Systems)
+ We do not guarantee this code will work on any given situation.
+ Do not use this code in production software.
+
+
+ Decoder for the scheduler trace of a kernel built with FATE_TRACE.
+
+ Reads the ITM stream (as captured from SWO, or written by
+ "fate_sim -i"), picks the trace records out of the stimulus port
+ TRACE_ITM_PORT, and writes a timeline:
+ - chrome: Chrome trace event JSON (chrome://tracing, ui.perfetto.dev),
+   one track per task, with its execution intervals and instants for
+   releases, events, stops and deadline misses.
+ - vcd: Value Change Dump (GTKWave), a "running" wire per task and
+   event signals for releases, stops and deadline misses.
+ A per-task summary (jobs, deadline misses, worst release to start
+ latency) is printed on stderr, with the number of records the kernel
+ dropped (its ring buffer full) or the ITM lost: it is incomplete if
+ any were.
+
+ Usage: fate_trace [-f chrome|vcd] [-c hz] [file]
+   -f  output format (default chrome)
+   -c  DWT cycle counter (MCLK) frequency in Hz (default 3000000)
+   file  ITM stream (default standard input)
+
+ ******************************************************/
+
+#include <msp.h>
+#include "fate.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef FATE_TRACE
+#error "fate_trace needs the trace definitions in fate.h: build with -DFATE_TRACE"
+#endif
+
+enum format {
+    FORMAT_CHROME,
+    FORMAT_VCD
+};
+
+// Per-task summary
+static struct {
+    int seen;
+    uint32_t releases;
+    uint32_t skipped;
+    uint32_t stops;
+    uint32_t misses;
+    uint32_t events;
+    uint32_t lost;
+    int released;           // released, and not switched to since
+    uint64_t release_time;
+    uint64_t max_latency;
+} tasks[NUM_TASKS];
+
+static enum format format = FORMAT_CHROME;
+static double cycle_hz = 3000000.0;
+static uint32_t overflows;
+static uint32_t dropped;        // records the kernel dropped (TRACE_DROPPED)
+static uint32_t records;
+static int first_event = 1;
+
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: fate_trace [-f chrome|vcd] [-c hz] [file]\n");
+    exit(2);
+}
+
+/**
+ *  ITM stream parser
+ *  Returns 1 with the next word written to the trace stimulus port,
+ *  skipping synchronization, overflow, protocol and other ports' packets.
+ */
+static int read_word(FILE *in, uint32_t *word)
+{
+    int header, c, i, size;
+    uint32_t value;
+
+    while((header = fgetc(in)) != EOF)
+    {
+        //Synchronization: zero bytes, then 0x80
+        if((header == 0x00) || (header == 0x80))
+            continue;
+        if(header == 0x70)
+        {
+            overflows++;
+            continue;
+        }
+        //Protocol packet (timestamps, extension): continues while bit 7 is set
+        if(!(header & 0x03))
+        {
+            for(c = header; (c & 0x80) && ((c = fgetc(in)) != EOF); );
+            continue;
+        }
+        size = ((header & 0x03) == 3) ? 4 : (header & 0x03);
+        value = 0;
+        for(i=0;i<size;i++)
+        {
+            if((c = fgetc(in)) == EOF)
+                return 0;
+            value |= (uint32_t)c << (8 * i);
+        }
+        //Software source packet (hardware source packets have bit 2 set)
+        if(!(header & 0x04) && ((header >> 3) == TRACE_ITM_PORT) && (size == 4))
+        {
+            *word = value;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int read_record(FILE *in, trace_record *record)
+{
+    uint32_t info;
+
+    if(!read_word(in, &record->timestamp) || !read_word(in, &info))
+        return 0;
+    record->type = (uint8_t)info;
+    record->task = (uint8_t)(info >> 8);
+    record->arg = (uint16_t)(info >> 16);
+    return 1;
+}
+
+static const char *task_name(int task)
+{
+    static char name[16];
+
+    if(task == 0)
+        return "idle";
+    snprintf(name, sizeof(name), "task %d", task);
+    return name;
+}
+
+
+/**
+ *  Chrome trace event output (timestamps in microseconds)
+ */
+static void chrome_begin(void)
+{
+    printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+}
+
+static void chrome_event(const char *json)
+{
+    printf("%s%s", first_event ? "" : ",\n", json);
+    first_event = 0;
+}
+
+static void chrome_interval(int task, double start_us, double end_us)
+{
+    char json[160];
+
+    snprintf(json, sizeof(json),
+             "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+             task_name(task), task, start_us, end_us - start_us);
+    chrome_event(json);
+}
+
+static void chrome_instant(int task, double time_us, const char *name, int arg)
+{
+    char json[192];
+
+    snprintf(json, sizeof(json),
+             "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"arg\":%d}}",
+             name, task, time_us, arg);
+    chrome_event(json);
+}
+
+static void chrome_end(void)
+{
+    char json[128];
+    int i;
+
+    for(i=0;i<NUM_TASKS;i++)
+    {
+        if(tasks[i].seen)
+        {
+            snprintf(json, sizeof(json),
+                     "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                     i, task_name(i));
+            chrome_event(json);
+        }
+    }
+    printf("\n]}\n");
+}
+
+
+/**
+ *  VCD output (timestamps in nanoseconds)
+ *  Every task gets identifiers "tN" (running), "rN" (release), "sN" (stop)
+ *  and "mN" (deadline miss), declared up front since the tasks are not known yet.
+ */
+static uint64_t vcd_time = UINT64_MAX;
+
+static void vcd_begin(void)
+{
+    int i;
+
+    printf("$timescale 1ns $end\n$scope module fate $end\n");
+    for(i=0;i<NUM_TASKS;i++)
+    {
+        if(i)
+            printf("$var wire 1 t%d task%d_running $end\n", i, i);
+        else
+            printf("$var wire 1 t0 idle_running $end\n");
+        printf("$var event 1 r%d release_%d $end\n", i, i);
+        printf("$var event 1 s%d stop_%d $end\n", i, i);
+        printf("$var event 1 m%d deadline_miss_%d $end\n", i, i);
+    }
+    printf("$upscope $end\n$enddefinitions $end\n$dumpvars\n");
+    for(i=0;i<NUM_TASKS;i++)
+        printf("%dt%d\n", i == 0, i);
+    printf("$end\n");
+}
+
+static void vcd_change(uint64_t ns, const char *value, char id, int task)
+{
+    if(ns != vcd_time)
+    {
+        printf("#%llu\n", (unsigned long long)ns);
+        vcd_time = ns;
+    }
+    printf("%s%c%d\n", value, id, task);
+}
+
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    trace_record record;
+    uint32_t last = 0;
+    uint64_t now = 0, since = 0;
+    int running = 0, started = 0, i;
+    double us;
+
+    for(i=1;i<argc;i++)
+    {
+        if(!strcmp(argv[i], "-f") && (i + 1 < argc))
+        {
+            i++;
+            if(!strcmp(argv[i], "chrome"))
+                format = FORMAT_CHROME;
+            else if(!strcmp(argv[i], "vcd"))
+                format = FORMAT_VCD;
+            else
+                usage();
+        }
+        else if(!strcmp(argv[i], "-c") && (i + 1 < argc))
+        {
+            if((cycle_hz = atof(argv[++i])) <= 0)
+                usage();
+        }
+        else if((argv[i][0] != '-') && (in == stdin))
+        {
+            if(!(in = fopen(argv[i], "rb")))
+            {
+                perror(argv[i]);
+                return 2;
+            }
+        }
+        else
+            usage();
+    }
+
+    if(format == FORMAT_CHROME)
+        chrome_begin();
+    else
+        vcd_begin();
+    tasks[0].seen = 1;
+
+    while(read_record(in, &record))
+    {
+        if(record.task >= NUM_TASKS)
+            continue;
+        records++;
+        //The cycle counter wraps around. A record can be stamped a little before
+        //the one ahead of it (an interrupt traced in between): time stands still
+        if(!started)
+        {
+            now = since = last = record.timestamp;
+            started = 1;
+        }
+        else if((int32_t)(record.timestamp - last) > 0)
+        {
+            now += record.timestamp - last;
+            last = record.timestamp;
+        }
+        us = (double)now * 1e6 / cycle_hz;
+        tasks[record.task].seen = 1;
+
+        switch(record.type)
+        {
+            case TRACE_SWITCH:
+                if(format == FORMAT_CHROME)
+                    chrome_interval(running, (double)since * 1e6 / cycle_hz, us);
+                else if(running != record.task)
+                {
+                    vcd_change((uint64_t)(us * 1e3), "0", 't', running);
+                    vcd_change((uint64_t)(us * 1e3), "1", 't', record.task);
+                }
+                if(tasks[record.task].released)
+                {
+                    tasks[record.task].released = 0;
+                    if(now - tasks[record.task].release_time > tasks[record.task].max_latency)
+                        tasks[record.task].max_latency = now - tasks[record.task].release_time;
+                }
+                running = record.task;
+                since = now;
+                break;
+            case TRACE_TICK:
+                if(format == FORMAT_CHROME)
+                    chrome_instant(0, us, "tick", record.arg);
+                break;
+            case TRACE_RELEASE:
+                if(record.arg)
+                    tasks[record.task].skipped++;
+                else
+                {
+                    tasks[record.task].releases++;
+                    tasks[record.task].released = 1;
+                    tasks[record.task].release_time = now;
+                }
+                if(format == FORMAT_CHROME)
+                    chrome_instant(record.task, us, record.arg ? "release skipped" : "release", record.arg);
+                else
+                    vcd_change((uint64_t)(us * 1e3), "1", 'r', record.task);
+                break;
+            case TRACE_EVENT:
+            case TRACE_EVENT_LOST:
+                if(record.type == TRACE_EVENT)
+                    tasks[record.task].events++;
+                else
+                    tasks[record.task].lost++;
+                if(format == FORMAT_CHROME)
+                    chrome_instant(record.task, us, (record.type == TRACE_EVENT) ? "event" : "event lost", record.arg);
+                //An event starts a job if the task was not active (it is not known here)
+                if((record.type == TRACE_EVENT) && !tasks[record.task].released && (running != record.task))
+                {
+                    tasks[record.task].released = 1;
+                    tasks[record.task].release_time = now;
+                }
+                break;
+            case TRACE_STOP:
+                tasks[record.task].stops++;
+                if(format == FORMAT_CHROME)
+                    chrome_instant(record.task, us, "stop", 0);
+                else
+                    vcd_change((uint64_t)(us * 1e3), "1", 's', record.task);
+                break;
+            case TRACE_DEADLINE_MISS:
+                tasks[record.task].misses++;
+                if(format == FORMAT_CHROME)
+                    chrome_instant(record.task, us, "deadline miss", 0);
+                else
+                    vcd_change((uint64_t)(us * 1e3), "1", 'm', record.task);
+                break;
+            case TRACE_DROPPED:
+                dropped += record.arg;
+                if(format == FORMAT_CHROME)
+                    chrome_instant(0, us, "records dropped", record.arg);
+                break;
+            default:
+                break;
+        }
+    }
+
+    if(format == FORMAT_CHROME)
+    {
+        if(started)
+            chrome_interval(running, (double)since * 1e6 / cycle_hz, (double)now * 1e6 / cycle_hz);
+        chrome_end();
+    }
+
+    fprintf(stderr, "%u records, %u dropped by the kernel, %u ITM overflows\n", records, dropped, overflows);
+    if(dropped || overflows)
+        fprintf(stderr, "warning: records are missing, the jobs, misses and latencies below are incomplete\n");
+    fprintf(stderr, "task  releases  skipped  events  lost  jobs  misses  max latency (us)\n");
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        if(tasks[i].seen)
+            fprintf(stderr, "%4d  %8u  %7u  %6u  %4u  %4u  %6u  %16.3f\n", i, tasks[i].releases,
+                    tasks[i].skipped, tasks[i].events, tasks[i].lost, tasks[i].stops, tasks[i].misses,
+                    (double)tasks[i].max_latency * 1e6 / cycle_hz);
+    }
+    return 0;
+}
@@ -0,0 +1,54 @@
+#!/bin/sh
+# Laxity policy check: builds fate_sim with ../v2_0/main.c under EDF, LLF and
+# EDZL, with budgets measured by the kernel and with FATE_ADMISSION's worst case
+# execution times, for each timing mode below. It then runs each build for
+# 30 simulated seconds and compares every task's dispatch count with EDF's.
+# Jobs of about the same laxity must not take turns on the CPU: a count over
+# twice EDF's (plus 2) fails the check. Prints one line per build, and exits
+# with 1 if any check failed.
+# Rebuilds from clean, so run "make" again afterwards for a normal build.
+#
+#   ./laxity_check.sh
+
+set -e
+cd "$(dirname "$0")"
+
+MODES="- FATE_TICKLESS FATE_HIRES FATE_HIRES,FATE_TICKLESS"
+BUDGETS="- FATE_ADMISSION"
+
+dispatches()
+{
+    make -s clean
+    make -s fate_sim KERNEL=../v2_0 DEFS="$*" >&2
+    ./fate_sim -t 30000 | awk '/^ +[0-9]+ +[0-9]+ /{ printf "%s ", $2 }'
+}
+
+failed=0
+for mode in $MODES
+do
+    for budget in $BUDGETS
+    do
+        defs=
+        for option in $(echo "$mode,$budget" | tr ',' ' ')
+        do
+            [ "$option" = - ] || defs="$defs -D$option"
+        done
+        edf=$(dispatches $defs)
+        for policy in LLF EDZL
+        do
+            counts=$(dispatches $defs -DFATE_POLICY=FATE_POLICY_$policy)
+            result=$(echo "$edf" "$counts" | awk '{
+                n = NF / 2
+                for(i = 1; i <= n; i++)
+                    if($(n + i) > 2 * $i + 2)
+                        bad = bad " task " (i - 1)
+                print bad ? "FAIL:" bad : "ok" }')
+            echo "$policy$defs: dispatches $counts(EDF $edf) $result"
+            case $result in
+                FAIL*) failed=1 ;;
+            esac
+        done
+    done
+done
+make -s clean
+exit $failed
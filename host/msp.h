@@ -0,0 +1,410 @@
+/*****************************************************
+
+
+ msp.h (host simulation)
+ The "Fake Time Environment Operating System"
+
+ Developed by
+ Paulo Garcia
+ Dpt. of Systems and Computer Engineering
+ Carleton University
+ Ottawa, Ontario, Canada
+
+ This code if for educational purposes only (SYSC3310 - Introduction to Real Time Systems)
+ We do not guarantee this code will work on any given situation.
+ Do not use this code in production software.
+
+
+ Stand-in for the TI "msp.h" device header, used to build FATE-OS
+ on a workstation (see "sim.c").
+
+ Only the peripherals FATE-OS and its example applications touch are
+ provided: Timer_A0-A3, Digital I/O ports P1-P6, the NVIC, the
+ PendSV bit of the SCB, the DWT cycle counter and ITM stimulus ports.
+ Registers are plain memory, except that every Timer_A access from
+ thread context costs a little virtual time, so that tasks which
+ busy-wait on a timer flag make progress.
+
+ ******************************************************/
+
+#ifndef FATE_SIM_MSP_H
+#define FATE_SIM_MSP_H
+
+#include <stdint.h>
+
+/** Lets the kernel select its host-simulation code paths */
+#ifndef FATE_SIM
+#define FATE_SIM 1
+#endif
+
+/** Clock frequencies (Hz) after reset */
+#define SIM_ACLK_HZ  32768u
+#define SIM_SMCLK_HZ 3000000u
+#define SIM_MCLK_HZ  3000000u
+
+
+/** Bit definitions */
+#define BIT0  (uint16_t)(0x0001)
+#define BIT1  (uint16_t)(0x0002)
+#define BIT2  (uint16_t)(0x0004)
+#define BIT3  (uint16_t)(0x0008)
+#define BIT4  (uint16_t)(0x0010)
+#define BIT5  (uint16_t)(0x0020)
+#define BIT6  (uint16_t)(0x0040)
+#define BIT7  (uint16_t)(0x0080)
+#define BIT8  (uint16_t)(0x0100)
+#define BIT9  (uint16_t)(0x0200)
+#define BITA  (uint16_t)(0x0400)
+#define BITB  (uint16_t)(0x0800)
+#define BITC  (uint16_t)(0x1000)
+#define BITD  (uint16_t)(0x2000)
+#define BITE  (uint16_t)(0x4000)
+#define BITF  (uint16_t)(0x8000)
+
+
+/** Interrupt numbers (same values as the MSP432P401R) */
+typedef enum IRQn
+{
+    NonMaskableInt_IRQn = -14,
+    HardFault_IRQn      = -13,
+    SVCall_IRQn         = -5,
+    PendSV_IRQn         = -2,
+    SysTick_IRQn        = -1,
+    TA0_0_IRQn          = 8,
+    TA0_N_IRQn          = 9,
+    TA1_0_IRQn          = 10,
+    TA1_N_IRQn          = 11,
+    TA2_0_IRQn          = 12,
+    TA2_N_IRQn          = 13,
+    TA3_0_IRQn          = 14,
+    TA3_N_IRQn          = 15,
+    PORT1_IRQn          = 35,
+    PORT2_IRQn          = 36,
+    PORT3_IRQn          = 37,
+    PORT4_IRQn          = 38,
+    PORT5_IRQn          = 39,
+    PORT6_IRQn          = 40
+} IRQn_Type;
+
+/** Number of simulated interrupt lines (exceptions are offset by 16) */
+#define SIM_NUM_IRQS (16 + 41)
+
+
+/** Timer_A register block */
+typedef struct
+{
+    volatile uint16_t CTL;
+    volatile uint16_t CCTL[7];
+    volatile uint16_t R;
+    volatile uint16_t CCR[7];
+    volatile uint16_t EX0;
+    volatile uint16_t IV;
+}
+Timer_A_Type;
+
+#define TIMER_A_CTL_IFG          ((uint16_t)0x0001)
+#define TIMER_A_CTL_IE           ((uint16_t)0x0002)
+#define TIMER_A_CTL_CLR          ((uint16_t)0x0004)
+#define TIMER_A_CTL_MC_MASK      ((uint16_t)0x0030)
+#define TIMER_A_CTL_MC_0         ((uint16_t)0x0000)
+#define TIMER_A_CTL_MC_1         ((uint16_t)0x0010)
+#define TIMER_A_CTL_MC_2         ((uint16_t)0x0020)
+#define TIMER_A_CTL_MC_3         ((uint16_t)0x0030)
+#define TIMER_A_CTL_MC__STOP     TIMER_A_CTL_MC_0
+#define TIMER_A_CTL_MC__UP       TIMER_A_CTL_MC_1
+#define TIMER_A_CTL_MC__CONTINUOUS TIMER_A_CTL_MC_2
+#define TIMER_A_CTL_ID_MASK      ((uint16_t)0x00C0)
+#define TIMER_A_CTL_ID__1        ((uint16_t)0x0000)
+#define TIMER_A_CTL_ID__2        ((uint16_t)0x0040)
+#define TIMER_A_CTL_ID__4        ((uint16_t)0x0080)
+#define TIMER_A_CTL_ID__8        ((uint16_t)0x00C0)
+#define TIMER_A_CTL_SSEL_MASK    ((uint16_t)0x0300)
+#define TIMER_A_CTL_TASSEL_0     ((uint16_t)0x0000)
+#define TIMER_A_CTL_TASSEL_1     ((uint16_t)0x0100)
+#define TIMER_A_CTL_TASSEL_2     ((uint16_t)0x0200)
+#define TIMER_A_CTL_TASSEL_3     ((uint16_t)0x0300)
+#define TIMER_A_CTL_SSEL__ACLK   TIMER_A_CTL_TASSEL_1
+#define TIMER_A_CTL_SSEL__SMCLK  TIMER_A_CTL_TASSEL_2
+
+#define TIMER_A_CCTLN_CCIFG      ((uint16_t)0x0001)
+#define TIMER_A_CCTLN_CCIE       ((uint16_t)0x0010)
+
+/*
+ Every access goes through the simulator, which brings the counters
+ up to date (and charges thread code for the access, see "sim.c")
+ */
+Timer_A_Type *sim_timer_a(int n);
+
+#define TIMER_A0 (sim_timer_a(0))
+#define TIMER_A1 (sim_timer_a(1))
+#define TIMER_A2 (sim_timer_a(2))
+#define TIMER_A3 (sim_timer_a(3))
+
+#define TA0CTL   (TIMER_A0->CTL)
+#define TA0CCTL0 (TIMER_A0->CCTL[0])
+#define TA0CCR0  (TIMER_A0->CCR[0])
+#define TA0R     (TIMER_A0->R)
+#define TA1CTL   (TIMER_A1->CTL)
+#define TA1CCR0  (TIMER_A1->CCR[0])
+#define TA1R     (TIMER_A1->R)
+#define TA2CTL   (TIMER_A2->CTL)
+#define TA2CCR0  (TIMER_A2->CCR[0])
+#define TA2R     (TIMER_A2->R)
+#define TA3CTL   (TIMER_A3->CTL)
+#define TA3CCR0  (TIMER_A3->CCR[0])
+#define TA3R     (TIMER_A3->R)
+
+
+/** Digital I/O port register block (byte-wide ports only) */
+typedef struct
+{
+    volatile uint8_t IN;
+    volatile uint8_t OUT;
+    volatile uint8_t DIR;
+    volatile uint8_t REN;
+    volatile uint8_t DS;
+    volatile uint8_t SEL0;
+    volatile uint8_t SEL1;
+    volatile uint8_t SELC;
+    volatile uint8_t IES;
+    volatile uint8_t IE;
+    volatile uint8_t IFG;
+}
+DIO_PORT_Type;
+
+extern DIO_PORT_Type sim_port[7];
+
+#define P1 (&sim_port[1])
+#define P2 (&sim_port[2])
+#define P3 (&sim_port[3])
+#define P4 (&sim_port[4])
+#define P5 (&sim_port[5])
+#define P6 (&sim_port[6])
+
+/*
+ Reading PxIV returns 2 * (pin + 1) for the lowest pin whose flag is set and
+ enabled, or 0, and clears that flag: reads go through the simulator
+ */
+uint16_t sim_port_iv(int n);
+
+#define P1IN   (P1->IN)
+#define P1OUT  (P1->OUT)
+#define P1DIR  (P1->DIR)
+#define P1REN  (P1->REN)
+#define P1SEL0 (P1->SEL0)
+#define P1SEL1 (P1->SEL1)
+#define P1IES  (P1->IES)
+#define P1IE   (P1->IE)
+#define P1IFG  (P1->IFG)
+#define P1IV   (sim_port_iv(1))
+#define P2IN   (P2->IN)
+#define P2OUT  (P2->OUT)
+#define P2DIR  (P2->DIR)
+#define P2REN  (P2->REN)
+#define P2SEL0 (P2->SEL0)
+#define P2SEL1 (P2->SEL1)
+#define P2IES  (P2->IES)
+#define P2IE   (P2->IE)
+#define P2IFG  (P2->IFG)
+#define P2IV   (sim_port_iv(2))
+#define P3IN   (P3->IN)
+#define P3OUT  (P3->OUT)
+#define P3DIR  (P3->DIR)
+#define P3REN  (P3->REN)
+#define P3SEL0 (P3->SEL0)
+#define P3SEL1 (P3->SEL1)
+#define P3IES  (P3->IES)
+#define P3IE   (P3->IE)
+#define P3IFG  (P3->IFG)
+#define P3IV   (sim_port_iv(3))
+#define P4IN   (P4->IN)
+#define P4OUT  (P4->OUT)
+#define P4DIR  (P4->DIR)
+#define P4REN  (P4->REN)
+#define P4SEL0 (P4->SEL0)
+#define P4SEL1 (P4->SEL1)
+#define P4IES  (P4->IES)
+#define P4IE   (P4->IE)
+#define P4IFG  (P4->IFG)
+#define P4IV   (sim_port_iv(4))
+#define P5IN   (P5->IN)
+#define P5OUT  (P5->OUT)
+#define P5DIR  (P5->DIR)
+#define P5REN  (P5->REN)
+#define P5SEL0 (P5->SEL0)
+#define P5SEL1 (P5->SEL1)
+#define P5IES  (P5->IES)
+#define P5IE   (P5->IE)
+#define P5IFG  (P5->IFG)
+#define P5IV   (sim_port_iv(5))
+#define P6IN   (P6->IN)
+#define P6OUT  (P6->OUT)
+#define P6DIR  (P6->DIR)
+#define P6REN  (P6->REN)
+#define P6SEL0 (P6->SEL0)
+#define P6SEL1 (P6->SEL1)
+#define P6IES  (P6->IES)
+#define P6IE   (P6->IE)
+#define P6IFG  (P6->IFG)
+#define P6IV   (sim_port_iv(6))
+
+
+/** Number of NVIC priority bits (priorities 0 to 7) */
+#define __NVIC_PRIO_BITS 3
+
+/** NVIC and core intrinsics */
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+void NVIC_DisableIRQ(IRQn_Type IRQn);
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority);
+void NVIC_SetPendingIRQ(IRQn_Type IRQn);
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn);
+
+/** System control block (interrupt control and state register only) */
+typedef struct
+{
+    volatile uint32_t ICSR;
+}
+SCB_Type;
+
+#define SCB_ICSR_PENDSVSET_Pos 28
+#define SCB_ICSR_PENDSVSET_Msk (1UL << SCB_ICSR_PENDSVSET_Pos)
+
+/*
+ Setting PENDSVSET from an ISR pends PendSV like the hardware does;
+ from thread code it takes effect at the next simulator call
+ */
+extern SCB_Type sim_scb;
+#define SCB (&sim_scb)
+
+/** Debug exception and monitor control (trace enable only) */
+typedef struct
+{
+    volatile uint32_t DEMCR;
+}
+CoreDebug_Type;
+
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+extern CoreDebug_Type sim_core_debug;
+#define CoreDebug (&sim_core_debug)
+
+/** Data watchpoint and trace unit (cycle counter only) */
+typedef struct
+{
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT;
+}
+DWT_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+
+/*
+ Every access goes through the simulator, which counts the MCLK cycles
+ of virtual time since the previous access
+ */
+DWT_Type *sim_dwt(void);
+#define DWT (sim_dwt())
+
+/*
+ Virtual time does not pass in interrupt handlers: code that measures
+ its own cost (FATE_BENCH) reads the host clock instead, in nanoseconds
+ */
+uint32_t sim_host_clock(void);
+
+/** Instrumentation trace macrocell (enable registers only) */
+typedef struct
+{
+    volatile uint32_t TER;
+    volatile uint32_t TCR;
+}
+ITM_Type;
+
+#define ITM_TCR_ITMENA_Msk (1UL << 0)
+
+/*
+ The simulator enables the ITM when it is given a file to write the stream to
+ (see "sim.c"); stimulus port writes go through it, framed like SWO output
+ */
+extern ITM_Type sim_itm;
+#define ITM (&sim_itm)
+void sim_itm_write(int port, uint32_t word);
+
+/*
+ Exclusive access: nothing can interrupt the simulator between a load and
+ a store, so the store always succeeds
+ */
+static inline uint32_t __LDREXW(volatile uint32_t *addr)
+{
+    return *addr;
+}
+
+static inline uint32_t __STREXW(uint32_t value, volatile uint32_t *addr)
+{
+    *addr = value;
+    return 0;
+}
+
+static inline void __CLREX(void)
+{
+}
+
+/** Count leading zeros (CLZ instruction) */
+static inline uint32_t __CLZ(uint32_t value)
+{
+    return value ? (uint32_t)__builtin_clz(value) : 32u;
+}
+
+/*
+ Process stack pointer: host code cannot run on a stack the kernel lays out,
+ so a simulated stack pointer is a handle to a host thread context (see "sim.c").
+ Thread code sets it to name the context it runs in; handlers read the interrupted
+ thread's and set the one to return to.
+ */
+uintptr_t __get_PSP(void);
+void __set_PSP(uintptr_t topOfProcStack);
+
+/**
+ *  Creates the thread context of a new job, known by stack pointer "top",
+ *  which calls "entry" and then "exit" (which must not return)
+ */
+uintptr_t sim_init_stack(uintptr_t top, void (*entry)(void), void (*exit)(void));
+
+static inline void __set_CONTROL(uint32_t control)
+{
+    (void)control;
+}
+
+static inline void __ISB(void)
+{
+}
+
+static inline void __DSB(void)
+{
+}
+
+static inline void __DMB(void)
+{
+}
+
+void __WFI(void);
+void __enable_irq(void);
+void __disable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+
+/*
+ Inline assembly cannot run on the host; the simulator understands
+ the few instructions FATE-OS issues this way ("CPSIE I", "CPSID I")
+ */
+void sim_asm(const char *instruction);
+#define __ASM(x) sim_asm(x)
+
+
+/**
+ *  Simulated exception frame: holds the return address of the interrupted
+ *  thread while an ISR runs. The kernel may overwrite it, exactly as it
+ *  overwrites the stacked PC on the target.
+ */
+extern intptr_t sim_exception_pc;
+
+#endif
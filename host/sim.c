@@ -0,0 +1,800 @@
+/*****************************************************
+
+
+ FATE_OS_SIM v1.0
+ The "Fake Time Environment Operating System"
+
+ Developed by
+ Paulo Garcia
+ Dpt. of Systems and Computer Engineering
+ Carleton University
+ Ottawa, Ontario, Canada
+
+ This code if for educational purposes only (SYSC3310 - Introduction to Real Time Systems)
+ We do not guarantee this code will work on any given situation.
+ Do not use this code in production software.
+
+
+ Host simulation of the MSP432 peripherals FATE-OS depends on.
+
+ The kernel ("fate.c") and an application ("main.c") are compiled
+ unmodified against the stand-in "msp.h" in this directory, and run
+ against a virtual clock:
+ - Timer_A0-A3 count ACLK/SMCLK edges of virtual time, set their flags
+   and request their interrupts like the real peripheral.
+ - Thread code only consumes virtual time when it touches a timer
+   (busy-waiting on a timer flag is detected and skipped over), or
+   when the idle task executes WFI (jumps straight to the next event).
+ - Interrupt handlers execute in zero virtual time.
+ - When an ISR overwrites the simulated return address (the kernel's
+   context switch, up to v1.1), the simulator starts the new task function.
+ - Kernels that switch context through PendSV get a host thread context
+   (ucontext) per process stack pointer instead: a task preempted inside
+   a simulator call resumes right there.
+
+ Usage: fate_sim [-t ms] [-v] [-e ms:port.pin]... [-i file]
+   -t  virtual run time in milliseconds (default 60000)
+   -v  print every context switch
+   -e  inject an active edge on a port pin at the given time
+   -i  enable the ITM and write its stream (SWO framing) to a file
+
+ ******************************************************/
+
+#include <msp.h>
+#include "fate.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+
+/** Virtual time charged to thread code for one timer register access */
+#define SIM_ACCESS_NS 1000u
+/** Number of identical timer polls after which thread code is considered to be busy-waiting */
+#define SIM_BUSY_POLLS 4
+/** Maximum number of injected port events */
+#define SIM_MAX_EVENTS 256
+/** Host stack size of a simulated thread context */
+#define SIM_THREAD_STACK (256u * 1024u)
+/** Maximum number of simulated thread contexts (process stacks) */
+#define SIM_MAX_THREADS 64
+
+#define SIM_NEVER UINT64_MAX
+
+// Kernel state we observe (defined in "fate.c")
+extern task_ctrl_blk *current_task;
+extern task_ctrl_blk Task_list[NUM_TASKS];
+
+// Application entry point ("main" in the application, renamed by the Makefile)
+int app_main(void);
+
+
+/**
+ *  Default interrupt handlers: the kernel overrides the ones it uses
+ */
+static void unhandled_irq(void)
+{
+    fprintf(stderr, "fate_sim: unhandled interrupt\n");
+    exit(2);
+}
+
+void TA0_0_IRQHandler(void) __attribute__((weak, alias("unhandled_irq")));
+void TA0_N_IRQHandler(void) __attribute__((weak, alias("unhandled_irq")));
+void TA1_0_IRQHandler(void) __attribute__((weak, alias("unhandled_irq")));
+void TA1_N_IRQHandler(void) __attribute__((weak, alias("unhandled_irq")));
+void TA2_0_IRQHandler(void) __attribute__((weak, alias("unhandled_irq")));
+void TA2_N_IRQHandler(void) __attribute__((weak, alias("unhandled_irq")));
+void TA3_0_IRQHandler(void) __attribute__((weak, alias("unhandled_irq")));
+void TA3_N_IRQHandler(void) __attribute__((weak, alias("unhandled_irq")));
+void PORT1_IRQHandler(void) __attribute__((weak, alias("unhandled_irq")));
+void PORT2_IRQHandler(void) __attribute__((weak, alias("unhandled_irq")));
+void PORT3_IRQHandler(void) __attribute__((weak, alias("unhandled_irq")));
+void PORT4_IRQHandler(void) __attribute__((weak, alias("unhandled_irq")));
+void PORT5_IRQHandler(void) __attribute__((weak, alias("unhandled_irq")));
+void PORT6_IRQHandler(void) __attribute__((weak, alias("unhandled_irq")));
+void PendSV_Handler(void) __attribute__((weak, alias("unhandled_irq")));
+void SysTick_Handler(void) __attribute__((weak, alias("unhandled_irq")));
+
+/** Vector table, indexed by IRQn + 16 */
+static void (*const vector_table[SIM_NUM_IRQS])(void) = {
+    [PendSV_IRQn + 16] = PendSV_Handler,
+    [SysTick_IRQn + 16] = SysTick_Handler,
+    [TA0_0_IRQn + 16] = TA0_0_IRQHandler,
+    [TA0_N_IRQn + 16] = TA0_N_IRQHandler,
+    [TA1_0_IRQn + 16] = TA1_0_IRQHandler,
+    [TA1_N_IRQn + 16] = TA1_N_IRQHandler,
+    [TA2_0_IRQn + 16] = TA2_0_IRQHandler,
+    [TA2_N_IRQn + 16] = TA2_N_IRQHandler,
+    [TA3_0_IRQn + 16] = TA3_0_IRQHandler,
+    [TA3_N_IRQn + 16] = TA3_N_IRQHandler,
+    [PORT1_IRQn + 16] = PORT1_IRQHandler,
+    [PORT2_IRQn + 16] = PORT2_IRQHandler,
+    [PORT3_IRQn + 16] = PORT3_IRQHandler,
+    [PORT4_IRQn + 16] = PORT4_IRQHandler,
+    [PORT5_IRQn + 16] = PORT5_IRQHandler,
+    [PORT6_IRQn + 16] = PORT6_IRQHandler,
+};
+
+
+// Peripheral state
+static Timer_A_Type timer_a[4];
+static uint32_t timer_prescale[4];
+DIO_PORT_Type sim_port[7];
+SCB_Type sim_scb;
+CoreDebug_Type sim_core_debug;
+static DWT_Type dwt;
+static uint64_t dwt_ns;
+ITM_Type sim_itm;
+static FILE *itm_file;
+intptr_t sim_exception_pc;
+
+// NVIC state
+static uint8_t nvic_enabled[SIM_NUM_IRQS];
+static uint8_t nvic_pending[SIM_NUM_IRQS];
+static uint8_t nvic_priority[SIM_NUM_IRQS];
+static int primask;
+static int in_isr;
+
+// Virtual time
+static uint64_t now_ns;
+static uint64_t end_ns = 60000ull * 1000000ull;
+
+// Injected port events, sorted by time
+static struct {
+    uint64_t time_ns;
+    uint8_t port;
+    uint8_t pin;
+} events[SIM_MAX_EVENTS];
+static int num_events;
+static int next_event;
+
+// Busy-wait detection
+static int poll_timer = -1;
+static uint16_t poll_ctl;
+static int poll_count;
+
+// Context switching
+static jmp_buf dispatch_env;
+static intptr_t dispatch_entry;
+
+// Thread contexts, known by the process stack pointer the kernel gives them
+static struct sim_thread {
+    uintptr_t psp;
+    ucontext_t context;
+    //Two host stacks, so a job can restart while its predecessor's stack is in use
+    char *stack[2];
+    int stack_in_use;
+    int fresh;
+    void (*entry)(void);
+    void (*exit)(void);
+} threads[SIM_MAX_THREADS];
+static int num_threads;
+static struct sim_thread *thread;   // context executing thread code (none until the kernel sets PSP)
+static uintptr_t psp;               // process stack pointer handlers see and set
+static ucontext_t discarded;        // where the context of a finished job is saved
+
+// Statistics
+static int verbose;
+static uint64_t task_time_ns[NUM_TASKS];
+static uint32_t task_dispatches[NUM_TASKS];
+static uint32_t isr_count[SIM_NUM_IRQS];
+static uint64_t isr_host_ns[SIM_NUM_IRQS];
+static uint64_t wall_start;
+
+static void finish(void);
+
+
+static uint64_t host_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+uint32_t sim_host_clock(void)
+{
+    return (uint32_t)host_ns();
+}
+
+/**
+ *  Number of edges of a "hz" clock from time 0 to "t_ns"
+ *  and (inversely) time at which the given edge occurs
+ */
+static uint64_t clock_edges(uint32_t hz, uint64_t t_ns)
+{
+    return (uint64_t)(((unsigned __int128)t_ns * hz) / 1000000000u);
+}
+
+static uint64_t edge_time(uint32_t hz, uint64_t edge)
+{
+    return (uint64_t)(((unsigned __int128)edge * 1000000000u + hz - 1) / hz);
+}
+
+
+/**
+ *  Timer_A model
+ */
+static uint32_t timer_clock_hz(const Timer_A_Type *t)
+{
+    switch(t->CTL & TIMER_A_CTL_SSEL_MASK)
+    {
+        case TIMER_A_CTL_TASSEL_1: return SIM_ACLK_HZ;
+        case TIMER_A_CTL_TASSEL_2: return SIM_SMCLK_HZ;
+        default: return 0; // external clocks are not simulated
+    }
+}
+
+static uint32_t timer_divider(const Timer_A_Type *t)
+{
+    return (1u << ((t->CTL & TIMER_A_CTL_ID_MASK) >> 6)) * ((t->EX0 & 7u) + 1u);
+}
+
+static int timer_running(const Timer_A_Type *t)
+{
+    return ((t->CTL & TIMER_A_CTL_MC_MASK) != TIMER_A_CTL_MC_0) && timer_clock_hz(t);
+}
+
+/** Last count value before the counter rolls over to zero */
+static uint32_t timer_top(const Timer_A_Type *t)
+{
+    if((t->CTL & TIMER_A_CTL_MC_MASK) == TIMER_A_CTL_MC_2)
+        return 0xFFFF;
+    return t->CCR[0];
+}
+
+/** Counts until the counter rolls over to zero */
+static uint64_t timer_to_wrap(const Timer_A_Type *t)
+{
+    uint32_t top = timer_top(t);
+    // A period shorter than the current count rolls over on the next count
+    return (t->R > top) ? 1 : (uint64_t)(top - t->R) + 1;
+}
+
+/** Applies TACLR, which the hardware clears as soon as it has acted on it */
+static void timer_sync(int n)
+{
+    if(timer_a[n].CTL & TIMER_A_CTL_CLR)
+    {
+        timer_a[n].R = 0;
+        timer_prescale[n] = 0;
+        timer_a[n].CTL &= (uint16_t)~TIMER_A_CTL_CLR;
+    }
+}
+
+/** Sets the capture/compare flags of every channel whose value lies in (lo, hi] */
+static void timer_compare(Timer_A_Type *t, uint32_t lo, uint32_t hi)
+{
+    int i;
+    for(i=0;i<7;i++)
+    {
+        if((t->CCR[i] > lo) && (t->CCR[i] <= hi))
+            t->CCTL[i] |= TIMER_A_CCTLN_CCIFG;
+    }
+}
+
+static void timer_count(Timer_A_Type *t, uint64_t counts)
+{
+    uint32_t top = timer_top(t);
+    uint64_t to_wrap = timer_to_wrap(t);
+    int i;
+
+    if(counts >= to_wrap)
+    {
+        timer_compare(t, t->R, top);
+        counts -= to_wrap;
+        //Whole periods pass every compare value
+        if(counts > top)
+        {
+            timer_compare(t, 0, top);
+            counts %= (uint64_t)top + 1;
+        }
+        for(i=0;i<7;i++)
+        {
+            if(t->CCR[i] == 0)
+                t->CCTL[i] |= TIMER_A_CCTLN_CCIFG;
+        }
+        t->CTL |= TIMER_A_CTL_IFG;
+        t->R = 0;
+    }
+    timer_compare(t, t->R, t->R + (uint32_t)counts);
+    t->R = (uint16_t)(t->R + counts);
+}
+
+static void timer_run(int n, uint64_t from_ns, uint64_t to_ns)
+{
+    Timer_A_Type *t = &timer_a[n];
+    uint32_t hz;
+    uint64_t edges;
+
+    timer_sync(n);
+    if(!timer_running(t))
+        return;
+    hz = timer_clock_hz(t);
+    edges = clock_edges(hz, to_ns) - clock_edges(hz, from_ns) + timer_prescale[n];
+    timer_prescale[n] = (uint32_t)(edges % timer_divider(t));
+    timer_count(t, edges / timer_divider(t));
+}
+
+/** Virtual time at which the timer next sets a flag */
+static uint64_t timer_next_event(int n)
+{
+    Timer_A_Type *t = &timer_a[n];
+    uint32_t top, hz;
+    uint64_t counts, k, edge;
+    int i;
+
+    timer_sync(n);
+    if(!timer_running(t))
+        return SIM_NEVER;
+    top = timer_top(t);
+    counts = timer_to_wrap(t);
+    for(i=1;i<7;i++)
+    {
+        if(!(t->CCTL[i] & TIMER_A_CCTLN_CCIE) || (t->CCR[i] > top))
+            continue;
+        k = (t->CCR[i] > t->R) ? (uint64_t)(t->CCR[i] - t->R) : timer_to_wrap(t) + t->CCR[i];
+        if(k < counts)
+            counts = k;
+    }
+    hz = timer_clock_hz(t);
+    edge = clock_edges(hz, now_ns) + counts * timer_divider(t) - timer_prescale[n];
+    return edge_time(hz, edge);
+}
+
+
+/**
+ *  Interrupt model
+ */
+
+/** Is the peripheral behind this interrupt line requesting service? */
+static int irq_asserted(int irq)
+{
+    const Timer_A_Type *t;
+    int i;
+
+    if((irq >= TA0_0_IRQn) && (irq <= TA3_N_IRQn))
+    {
+        t = &timer_a[(irq - TA0_0_IRQn) / 2];
+        if(!((irq - TA0_0_IRQn) & 1))
+            return (t->CCTL[0] & TIMER_A_CCTLN_CCIE) && (t->CCTL[0] & TIMER_A_CCTLN_CCIFG);
+        if((t->CTL & TIMER_A_CTL_IE) && (t->CTL & TIMER_A_CTL_IFG))
+            return 1;
+        for(i=1;i<7;i++)
+        {
+            if((t->CCTL[i] & TIMER_A_CCTLN_CCIE) && (t->CCTL[i] & TIMER_A_CCTLN_CCIFG))
+                return 1;
+        }
+        return 0;
+    }
+    if((irq >= PORT1_IRQn) && (irq <= PORT6_IRQn))
+    {
+        i = irq - PORT1_IRQn + 1;
+        return (sim_port[i].IE & sim_port[i].IFG) != 0;
+    }
+    return 0;
+}
+
+/** Highest priority pending interrupt (vector table index), or -1 */
+static int highest_pending(void)
+{
+    int i, best = -1;
+
+    if(sim_scb.ICSR & SCB_ICSR_PENDSVSET_Msk)
+    {
+        sim_scb.ICSR &= ~SCB_ICSR_PENDSVSET_Msk;
+        nvic_pending[PendSV_IRQn + 16] = 1;
+    }
+    for(i=0;i<SIM_NUM_IRQS;i++)
+    {
+        if(!vector_table[i] || !nvic_enabled[i])
+            continue;
+        if(!nvic_pending[i] && !((i >= 16) && irq_asserted(i - 16)))
+            continue;
+        if((best < 0) || (nvic_priority[i] < nvic_priority[best]))
+            best = i;
+    }
+    return best;
+}
+
+/**
+ *  Thread contexts
+ */
+static struct sim_thread *find_thread(uintptr_t stack_pointer)
+{
+    int i;
+
+    for(i=0;i<num_threads;i++)
+    {
+        if(threads[i].psp == stack_pointer)
+            return &threads[i];
+    }
+    if(num_threads == SIM_MAX_THREADS)
+    {
+        fprintf(stderr, "fate_sim: too many process stacks\n");
+        exit(2);
+    }
+    threads[num_threads].psp = stack_pointer;
+    return &threads[num_threads++];
+}
+
+static void thread_start(void)
+{
+    thread->entry();
+    thread->exit();
+    fprintf(stderr, "fate_sim: thread returned at %.6f s\n", (double)now_ns / 1e9);
+    exit(1);
+}
+
+uintptr_t sim_init_stack(uintptr_t top, void (*entry)(void), void (*exit_fn)(void))
+{
+    struct sim_thread *t = find_thread(top);
+
+    //A task restarting itself is still running on its host stack
+    if(t == thread)
+        t->stack_in_use ^= 1;
+    if(!t->stack[t->stack_in_use] && !(t->stack[t->stack_in_use] = malloc(SIM_THREAD_STACK)))
+    {
+        fprintf(stderr, "fate_sim: out of memory\n");
+        exit(2);
+    }
+    getcontext(&t->context);
+    t->context.uc_stack.ss_sp = t->stack[t->stack_in_use];
+    t->context.uc_stack.ss_size = SIM_THREAD_STACK;
+    t->context.uc_link = NULL;
+    makecontext(&t->context, thread_start, 0);
+    t->entry = entry;
+    t->exit = exit_fn;
+    t->fresh = 1;
+    return top;
+}
+
+uintptr_t __get_PSP(void)
+{
+    if(in_isr)
+        return psp;
+    return thread ? thread->psp : 0;
+}
+
+void __set_PSP(uintptr_t top)
+{
+    if(in_isr)
+        psp = top;
+    else
+    {
+        //Thread code names the context it runs in (saved when it is first switched out)
+        thread = find_thread(top);
+        thread->fresh = 0;
+    }
+}
+
+/** Resumes (or starts) the thread context the handlers left in the process stack pointer */
+static void switch_thread(void)
+{
+    struct sim_thread *from = thread, *to = find_thread(psp);
+    int i = (int)(current_task - Task_list);
+
+    if((to == from) && !to->fresh)
+        return;
+    if((i >= 0) && (i < NUM_TASKS))
+        task_dispatches[i]++;
+    if(verbose)
+        printf("%12.6f s  switch to task %d\n", (double)now_ns / 1e9, i);
+    thread = to;
+    to->fresh = 0;
+    swapcontext((to == from) ? &discarded : &from->context, &to->context);
+}
+
+
+/**
+ *  Executes every pending interrupt (tail-chaining), then either returns
+ *  to the interrupted thread or, if an ISR rewrote the return address,
+ *  starts executing the new one (or, if PendSV changed the process stack
+ *  pointer, resumes that thread context).
+ */
+static void take_interrupts(void)
+{
+    int i;
+    uint64_t start;
+
+    if(in_isr || primask)
+        return;
+
+    sim_exception_pc = 0;
+    psp = thread ? thread->psp : 0;
+    while((i = highest_pending()) >= 0)
+    {
+        nvic_pending[i] = 0;
+        in_isr = 1;
+        start = host_ns();
+        vector_table[i]();
+        isr_host_ns[i] += host_ns() - start;
+        isr_count[i]++;
+        in_isr = 0;
+        // What thread code polls for may have changed: only polls with no
+        // interrupt in between are busy-waiting
+        poll_timer = -1;
+    }
+
+    if(sim_exception_pc)
+    {
+        i = (int)(current_task - Task_list);
+        if((i >= 0) && (i < NUM_TASKS))
+            task_dispatches[i]++;
+        if(verbose)
+            printf("%12.6f s  switch to task %d (0x%lx)\n",
+                   (double)now_ns / 1e9, i, (unsigned long)sim_exception_pc);
+        dispatch_entry = sim_exception_pc;
+        longjmp(dispatch_env, 1);
+    }
+    if(thread)
+        switch_thread();
+}
+
+
+/**
+ *  Virtual time
+ */
+static uint64_t next_event_time(void)
+{
+    uint64_t t = end_ns, e;
+    int n;
+
+    for(n=0;n<4;n++)
+    {
+        e = timer_next_event(n);
+        if(e < t)
+            t = e;
+    }
+    if((next_event < num_events) && (events[next_event].time_ns < t))
+        t = events[next_event].time_ns;
+    return t;
+}
+
+static void advance_to(uint64_t t)
+{
+    int n;
+
+    if(t > end_ns)
+        t = end_ns;
+    if(t <= now_ns)
+        return;
+
+    for(n=0;n<4;n++)
+        timer_run(n, now_ns, t);
+
+    n = (int)(current_task - Task_list);
+    if((n >= 0) && (n < NUM_TASKS))
+        task_time_ns[n] += t - now_ns;
+    now_ns = t;
+
+    while((next_event < num_events) && (events[next_event].time_ns <= now_ns))
+    {
+        sim_port[events[next_event].port].IFG |= (uint8_t)(1u << events[next_event].pin);
+        next_event++;
+    }
+
+    if(now_ns >= end_ns)
+        finish();
+}
+
+
+/**
+ *  Peripheral access from the device header
+ */
+Timer_A_Type *sim_timer_a(int n)
+{
+    timer_sync(n);
+    if(!in_isr)
+    {
+        if((n == poll_timer) && (timer_a[n].CTL == poll_ctl))
+            poll_count++;
+        else
+        {
+            poll_timer = n;
+            poll_ctl = timer_a[n].CTL;
+            poll_count = 0;
+        }
+        // Busy-waiting: nothing changes until the next event
+        // (a stopped timer is being set up instead)
+        if((poll_count >= SIM_BUSY_POLLS) && timer_running(&timer_a[n]))
+            advance_to(next_event_time());
+        else
+            advance_to(now_ns + SIM_ACCESS_NS);
+        take_interrupts();
+    }
+    return &timer_a[n];
+}
+
+void NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    nvic_enabled[IRQn + 16] = 1;
+}
+
+void NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    nvic_enabled[IRQn + 16] = 0;
+}
+
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+    nvic_priority[IRQn + 16] = (uint8_t)priority;
+}
+
+void NVIC_SetPendingIRQ(IRQn_Type IRQn)
+{
+    nvic_pending[IRQn + 16] = 1;
+    take_interrupts();
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn)
+{
+    nvic_pending[IRQn + 16] = 0;
+}
+
+void sim_itm_write(int port, uint32_t word)
+{
+    //Software source packet: header (port, 4 byte payload), then the word, little endian
+    if(itm_file && (sim_itm.TCR & ITM_TCR_ITMENA_Msk) && (sim_itm.TER & (1UL << port)))
+    {
+        fputc((port << 3) | 0x03, itm_file);
+        fputc((int)(word & 0xFF), itm_file);
+        fputc((int)((word >> 8) & 0xFF), itm_file);
+        fputc((int)((word >> 16) & 0xFF), itm_file);
+        fputc((int)(word >> 24), itm_file);
+    }
+}
+
+DWT_Type *sim_dwt(void)
+{
+    //The counter only runs while trace is enabled
+    if((dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk) && (sim_core_debug.DEMCR & CoreDebug_DEMCR_TRCENA_Msk))
+        dwt.CYCCNT += (uint32_t)(clock_edges(SIM_MCLK_HZ, now_ns) - clock_edges(SIM_MCLK_HZ, dwt_ns));
+    dwt_ns = now_ns;
+    return &dwt;
+}
+
+uint16_t sim_port_iv(int n)
+{
+    uint8_t pending = sim_port[n].IFG & sim_port[n].IE;
+    int pin;
+
+    if(!pending)
+        return 0;
+    pin = __builtin_ctz(pending);
+    sim_port[n].IFG &= (uint8_t)~(1u << pin);
+    return (uint16_t)(2 * (pin + 1));
+}
+
+void __WFI(void)
+{
+    advance_to(next_event_time());
+    take_interrupts();
+}
+
+void __enable_irq(void)
+{
+    primask = 0;
+    take_interrupts();
+}
+
+void __disable_irq(void)
+{
+    primask = 1;
+}
+
+uint32_t __get_PRIMASK(void)
+{
+    return (uint32_t)primask;
+}
+
+void __set_PRIMASK(uint32_t priMask)
+{
+    primask = priMask & 1;
+    take_interrupts();
+}
+
+void sim_asm(const char *instruction)
+{
+    if(!strcmp(instruction, "CPSIE I"))
+        __enable_irq();
+    else if(!strcmp(instruction, "CPSID I"))
+        __disable_irq();
+    else
+    {
+        fprintf(stderr, "fate_sim: cannot execute \"%s\"\n", instruction);
+        exit(2);
+    }
+}
+
+
+/**
+ *  Command line and report
+ */
+static void usage(void)
+{
+    fprintf(stderr, "usage: fate_sim [-t ms] [-v] [-e ms:port.pin]... [-i file]\n");
+    exit(2);
+}
+
+static void add_event(const char *arg)
+{
+    double ms;
+    unsigned port, pin;
+    int i;
+
+    if((sscanf(arg, "%lf:%u.%u", &ms, &port, &pin) != 3) || (ms < 0) ||
+       (port < 1) || (port > 6) || (pin > 7) || (num_events == SIM_MAX_EVENTS))
+        usage();
+    //Keep events sorted by time
+    for(i=num_events; (i>0) && (events[i-1].time_ns > (uint64_t)(ms * 1e6)); i--)
+        events[i] = events[i-1];
+    events[i].time_ns = (uint64_t)(ms * 1e6);
+    events[i].port = (uint8_t)port;
+    events[i].pin = (uint8_t)pin;
+    num_events++;
+}
+
+static void finish(void)
+{
+    double wall_s = (double)(host_ns() - wall_start) / 1e9;
+    int i;
+
+    printf("virtual time %.3f s, host time %.3f s\n", (double)now_ns / 1e9, wall_s);
+    for(i=0;i<SIM_NUM_IRQS;i++)
+    {
+        if(isr_count[i])
+            printf("irq %3d: %10u calls, %8.1f ns/call (host)\n", i - 16, isr_count[i],
+                   (double)isr_host_ns[i] / isr_count[i]);
+    }
+    printf("task  dispatches  cpu time\n");
+    for(i=0;i<NUM_TASKS;i++)
+    {
+        if(Task_list[i].state != TASK_UNDEFINED)
+            printf("%4d  %10u  %7.3f %%\n", i, task_dispatches[i],
+                   now_ns ? 100.0 * (double)task_time_ns[i] / (double)now_ns : 0.0);
+    }
+    exit(0);
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+
+    for(i=1;i<argc;i++)
+    {
+        if(!strcmp(argv[i], "-v"))
+            verbose = 1;
+        else if(!strcmp(argv[i], "-t") && (i + 1 < argc))
+            end_ns = (uint64_t)(atof(argv[++i]) * 1e6);
+        else if(!strcmp(argv[i], "-e") && (i + 1 < argc))
+            add_event(argv[++i]);
+        else if(!strcmp(argv[i], "-i") && (i + 1 < argc))
+        {
+            if(!(itm_file = fopen(argv[++i], "wb")))
+            {
+                perror(argv[i]);
+                return 2;
+            }
+            //As a debugger would: enable the ITM and every stimulus port
+            sim_itm.TCR = ITM_TCR_ITMENA_Msk;
+            sim_itm.TER = 0xFFFFFFFF;
+        }
+        else
+            usage();
+    }
+
+    //Exceptions cannot be disabled
+    nvic_enabled[PendSV_IRQn + 16] = 1;
+    nvic_enabled[SysTick_IRQn + 16] = 1;
+
+    wall_start = host_ns();
+    if(!setjmp(dispatch_env))
+        app_main();
+    else
+        ((void (*)(void))dispatch_entry)();
+
+    fprintf(stderr, "fate_sim: thread returned at %.6f s\n", (double)now_ns / 1e9);
+    return 1;
+}
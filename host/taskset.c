@@ -0,0 +1,95 @@
+#include <msp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+//Must always include our OS header file
+#include "fate.h"
+
+/*
+ Task set check: an application to build instead of "main.c" (v1.2 and v2.0),
+ that adds the periodic tasks given in the TASKSET environment variable, one
+ "period,start_offset,deadline,work" group per task, separated by spaces
+ (period, start offset and deadline in ticks, work in microseconds):
+
+   make APP_DIR=. APP=taskset
+   TASKSET="50,0,40,3000 120,10,120,25000" ./fate_sim -t 10000 -v
+
+ Each job works for its "work" by reading Timer A1, stopped, which the
+ simulator charges 1 us per access: it can be preempted part way through,
+ and resumes where it was. "host/check.sh" runs random task sets on several
+ kernels and compares their context switches.
+ */
+
+// Microseconds of work of each task's jobs
+static uint32_t work[NUM_TASKS];
+
+static void do_work(uint32_t us)
+{
+    while(us--)
+        (void)TIMER_A1->R;
+}
+
+// One function per task ("Task_stop" finds tasks by function)
+#define WORKER(n) void worker##n(void); \
+    void worker##n(void) { do_work(work[n]); Task_stop((intptr_t)worker##n); }
+WORKER(1)  WORKER(2)  WORKER(3)  WORKER(4)  WORKER(5)  WORKER(6)  WORKER(7)
+
+static void (*const workers[])(void) = {
+    worker1, worker2, worker3, worker4, worker5, worker6, worker7
+};
+
+#define NUM_WORKERS ((int)(sizeof(workers) / sizeof(workers[0])))
+
+// Reads the next number of "*text", and skips the separator after it
+static uint32_t field(const char **text)
+{
+    char *end;
+    uint32_t value = (uint32_t)strtoul(*text, &end, 10);
+
+    if(end == *text)
+    {
+        fprintf(stderr, "TASKSET: number expected at \"%s\"\n", *text);
+        exit(1);
+    }
+    *text = (*end) ? end + 1 : end;
+    return value;
+}
+
+int main(void)
+{
+    const char *text = getenv("TASKSET");
+    uint32_t period, start_offset, deadline;
+    uint8_t status;
+    int n;
+
+    //Initialize Task list, includes setting up idle task
+    Task_list_init();
+
+    for(n = 1; text && *text; n++)
+    {
+        if((n > NUM_WORKERS) || (n >= NUM_TASKS))
+        {
+            fprintf(stderr, "TASKSET: more than %d tasks\n",
+                    (NUM_WORKERS < NUM_TASKS - 1) ? NUM_WORKERS : NUM_TASKS - 1);
+            exit(1);
+        }
+        period = field(&text);
+        start_offset = field(&text);
+        deadline = field(&text);
+        work[n] = field(&text);
+#ifdef FATE_POLICY
+        status = Task_add((intptr_t)workers[n - 1], period, start_offset, deadline, 0);
+#else
+        status = Task_add((intptr_t)workers[n - 1], period, start_offset, deadline);
+#endif
+        if(status)
+        {
+            fprintf(stderr, "TASKSET: task %d not added (%u)\n", n, status);
+            exit(1);
+        }
+    }
+
+    //Start the scheduler, never returns
+    Task_schedule();
+    return 0;
+}
@@ -50,6 +50,19 @@ Used in Timer ISR to determine if we are running highest priority task or not
 */
 task_ctrl_blk *current_task = &(Task_list[0]);
 
+/*
+Ready bitmaps, used by "get_priority_task" to find the highest priority
+active task without scanning "Task_list" (a Task is active, i.e. ready,
+if it is in Running or Suspended states; the idle task is never in them)
+
+Ready_groups: bit g is set if any task with priority 32g to 32g+31 is ready
+Ready_priorities[g]: bit b is set if any task with priority 32g+b is ready
+Ready_tasks[p]: bit (7-i) is set if Task_list[i], of priority p, is ready
+*/
+uint32_t Ready_groups;
+uint32_t Ready_priorities[8];
+uint8_t Ready_tasks[256];
+
 
 /*
 Must always be called in "main" prior to adding other tasks.
@@ -67,7 +80,7 @@ void Task_list_init(void)
 	Task_list[0].function = (uint32_t)idle_thread;
 	Task_list[0].period = 1;
 	Task_list[0].count = 0;
-	Task_list[0].priority = -1;
+	Task_list[0].priority = 0;
 	
 	for(i=1;i<8;i++)
 	{
@@ -75,32 +88,72 @@ void Task_list_init(void)
 		Task_list[i].function = (uint32_t)idle_thread;
 		Task_list[i].period = 1;
 		Task_list[i].count = 0;
-		Task_list[i].priority = -1;
+		Task_list[i].priority = 0;
+	}
+	
+	//No task is ready yet
+	Ready_groups = 0;
+	for(i=0;i<8;i++)
+	{
+		Ready_priorities[i] = 0;
+	}
+	for(i=0;i<256;i++)
+	{
+		Ready_tasks[i] = 0;
+	}
+}
+
+/*
+Marks a task as ready (active) in the ready bitmaps
+Called whenever a task becomes Suspended from Stopped
+*/
+__inline void set_task_ready(task_ctrl_blk *task)
+{
+	uint8_t p = task->priority;
+	
+	Ready_tasks[p] |= (uint8_t)(0x80 >> (task - Task_list));
+	Ready_priorities[p >> 5] |= (uint32_t)1 << (p & 31);
+	Ready_groups |= (uint32_t)1 << (p >> 5);
+}
+
+/*
+Removes a task from the ready bitmaps
+Called when a task has stopped
+*/
+__inline void clear_task_ready(task_ctrl_blk *task)
+{
+	uint8_t p = task->priority;
+	
+	Ready_tasks[p] &= (uint8_t)(~(0x80 >> (task - Task_list)));
+	//Last ready task of this priority?
+	if(Ready_tasks[p] == 0)
+	{
+		Ready_priorities[p >> 5] &= ~((uint32_t)1 << (p & 31));
+		//Last ready priority of this group?
+		if(Ready_priorities[p >> 5] == 0)
+			Ready_groups &= ~((uint32_t)1 << (p >> 5));
 	}
 }
 
 /*
 Returns a pointer to the "Task_list" entry of the highest priority active task
 (a Task is active if it is in Running or Suspended states)
+
+Constant time: count leading zeros finds the highest ready group, then the highest
+ready priority in it, then the first ready task of that priority in "Task_list".
+Returns the idle task if no task is ready.
 */
 __inline task_ctrl_blk *get_priority_task(void)
 {
-	int i;
-	int highest = 0;
-	int8_t highest_priority = -1;
+	uint32_t group;
+	uint32_t priority;
 	
-	for(i=0; i<8; i++)
-	{
-		if((Task_list[i].state == TASK_RUNNING) || (Task_list[i].state == TASK_SUSPENDED))
-		{
-			if(Task_list[i].priority > highest_priority)
-			{
-				highest_priority = Task_list[i].priority;
-				highest = i;
-			}
-		}
-	}
-	return &(Task_list[highest]);
+	if(Ready_groups == 0)
+		return &(Task_list[0]);
+	
+	group = 31 - __CLZ(Ready_groups);
+	priority = (group << 5) + 31 - __CLZ(Ready_priorities[group]);
+	return &(Task_list[__CLZ((uint32_t)Ready_tasks[priority] << 24)]);
 }
 
 /*
@@ -167,6 +220,10 @@ void TA0_N_IRQHandler()
 	//so we are pointing at Return Address
 	sp_p += 0x1C;
 	
+	//Has the current task stopped itself since the last tick?
+	if(current_task->state == TASK_STOPPED)
+		clear_task_ready(current_task);
+	
 	//Increment "count" on all tasks, modulo task period
 	//Set task as SUSPENDED (active) if it was STOPPED 
 	//and count is back to 0 (matched period)
@@ -177,7 +234,10 @@ void TA0_N_IRQHandler()
 		if(Task_list[i].count == 0)
 		{
 			if(Task_list[i].state == TASK_STOPPED)
+			{
 				Task_list[i].state = TASK_SUSPENDED;
+				set_task_ready(&(Task_list[i]));
+			}
 		}
 	}
 	//Get pointer to highest priority active (running or suspended) task
@@ -58,7 +58,7 @@ typedef struct
 	uint32_t function; //address of function that implements thread
 	uint32_t period; //thread's periodicity in number of system ticks
 	uint32_t count; //number of system ticks that elapsed while task is stopped
-	int8_t priority; //task's priority 0 lowest, 255 highest
+	uint8_t priority; //task's priority 0 lowest, 255 highest
 } 
 task_ctrl_blk;
 
@@ -68,6 +68,8 @@ Various function definitions: see "fate.c"
 void idle_thread(void);
 void Task_list_init(void);
 task_ctrl_blk *get_priority_task(void);
+void set_task_ready(task_ctrl_blk *task);
+void clear_task_ready(task_ctrl_blk *task);
 void Task_add(uint32_t function, uint32_t period, uint32_t priority);
 __inline uint32_t get_current_SP(void);
 void Task_schedule(void);
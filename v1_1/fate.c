@@ -22,6 +22,10 @@ Tasks cannot call other functions nor should they have local variables.
 
 V1.1:
 Added support for aperiodic tasks (port interrupt events only)
+Events run the scheduler immediately, instead of at the next tick
+Aperiodic task activations are counted (and time stamped), so bursts are not lost
+Runs in the host simulator (FATE_SIM); optional scheduler cost measurement (FATE_BENCH)
+Optional admission control: tasks that would make the task set unschedulable are rejected (FATE_ADMISSION)
 
 ******************************************************/
 
@@ -35,20 +39,32 @@ Later, can be optimized using WFI (wait for interrupt) instruction
 */
 void idle_thread(void)
 {
-	while(1);
+	while(1)
+	{
+#ifdef FATE_SIM
+		//Simulated time only passes on timer accesses and WFI
+		__WFI();
+#endif
+	}
 }
 
 /*
 List that holds the information structure for each task (task_ctrl_blk).
 Size of this list limits the number of tasks FATE-OS supports.
 */
-task_ctrl_blk Task_list[8];
+task_ctrl_blk Task_list[NUM_TASKS];
 
 /*
-List that matches events to a corresponding task
+List that matches events to a corresponding task, and queues
+the activations the task has not served yet
 (just 2 events for now)
 */
-task_ctrl_blk *Event_task_list[2];
+event_ctrl_blk Event_task_list[2];
+
+/*
+Number of system ticks since the scheduler started
+*/
+uint32_t tick_count;
 
 /*
 Pointer to element in "Task_list" that is currently executing
@@ -57,6 +73,83 @@ Used in Timer ISR to determine if we are running highest priority task or not
 */
 task_ctrl_blk *current_task = &(Task_list[0]);
 
+/*
+Ready bitmaps, used by "get_priority_task" to find the highest priority
+active task without scanning "Task_list" (a Task is active, i.e. ready,
+if it is in Running or Suspended states; the idle task is never in them)
+
+Ready_groups: bit g is set if any task with priority 32g to 32g+31 is ready
+Ready_priorities[g]: bit b is set if any task with priority 32g+b is ready
+Ready_tasks[p]: bit (7-i) is set if Task_list[i], of priority p, is ready
+*/
+uint32_t Ready_groups;
+uint32_t Ready_priorities[8];
+uint8_t Ready_tasks[256];
+
+#ifdef FATE_BENCH
+/*
+Scheduler measurements (see "fate.h"), and the time it takes
+to read "BENCH_CLOCK" (taken out of every measurement)
+*/
+bench_stat Bench_stats[NUM_BENCH_PATHS][NUM_TASKS];
+static uint32_t bench_overhead;
+
+/*
+Clears every measurement
+Called by "Task_schedule", and by the application to start a new measurement
+*/
+void Bench_reset(void)
+{
+	int path, i;
+	uint32_t start;
+	
+	for(path=0;path<NUM_BENCH_PATHS;path++)
+	{
+		for(i=0;i<NUM_TASKS;i++)
+		{
+			Bench_stats[path][i].count = 0;
+			Bench_stats[path][i].min = 0xFFFFFFFF;
+			Bench_stats[path][i].max = 0;
+			Bench_stats[path][i].total = 0;
+		}
+	}
+	
+	//Shortest of a few back to back reads
+	bench_overhead = 0xFFFFFFFF;
+	for(i=0;i<8;i++)
+	{
+		start = BENCH_CLOCK();
+		start = BENCH_CLOCK() - start;
+		if(start < bench_overhead)
+			bench_overhead = start;
+	}
+}
+
+/*
+Adds a measurement of a scheduler path, grouped by the number of active tasks
+*/
+void bench_record(enum bench_paths path, uint32_t elapsed)
+{
+	bench_stat *stat;
+	int i, active = 0;
+	
+	for(i=1;i<NUM_TASKS;i++)
+	{
+		if((Task_list[i].state == TASK_RUNNING) || (Task_list[i].state == TASK_SUSPENDED))
+			active++;
+	}
+	elapsed = (elapsed > bench_overhead) ? (elapsed - bench_overhead) : 0;
+	
+	stat = &(Bench_stats[path][active]);
+	stat->count++;
+	stat->total += elapsed;
+	if(elapsed < stat->min)
+		stat->min = elapsed;
+	if(elapsed > stat->max)
+		stat->max = elapsed;
+}
+#endif
+
 
 /*
 Must always be called in "main" prior to adding other tasks.
@@ -71,70 +164,245 @@ void Task_list_init(void)
 	int i;
 	
 	Task_list[0].state = TASK_RUNNING;
-	Task_list[0].function = (uint32_t)idle_thread;
+	Task_list[0].function = (intptr_t)idle_thread;
 	Task_list[0].period = 1;
 	Task_list[0].count = 0;
-	Task_list[0].priority = -1;
+	Task_list[0].priority = 0;
+	Task_list[0].event = -1;
 	
-	for(i=1;i<8;i++)
+	for(i=1;i<NUM_TASKS;i++)
 	{
 		Task_list[i].state = TASK_UNDEFINED;
-		Task_list[i].function = (uint32_t)idle_thread;
+		Task_list[i].function = (intptr_t)idle_thread;
 		Task_list[i].period = 1;
 		Task_list[i].count = 0;
-		Task_list[i].priority = -1;
+		Task_list[i].priority = 0;
+		Task_list[i].event = -1;
+	}
+	
+	tick_count = 0;
+	
+	//No task is ready yet
+	Ready_groups = 0;
+	for(i=0;i<8;i++)
+	{
+		Ready_priorities[i] = 0;
+	}
+	for(i=0;i<256;i++)
+	{
+		Ready_tasks[i] = 0;
 	}
 	
 	//Clear all aperiodic events
 	for(i=0;i<2;i++)
 	{
-		Event_task_list[i] = (task_ctrl_blk *)0;
+		Event_task_list[i].task = (task_ctrl_blk *)0;
+		Event_task_list[i].pending = 0;
+		Event_task_list[i].head = 0;
+		Event_task_list[i].lost = 0;
+	}
+}
+
+/*
+Marks a task as ready (active) in the ready bitmaps
+Called whenever a task becomes Suspended from Stopped
+*/
+__inline void set_task_ready(task_ctrl_blk *task)
+{
+	uint8_t p = task->priority;
+	
+	Ready_tasks[p] |= (uint8_t)(0x80 >> (task - Task_list));
+	Ready_priorities[p >> 5] |= (uint32_t)1 << (p & 31);
+	Ready_groups |= (uint32_t)1 << (p >> 5);
+}
+
+/*
+Removes a task from the ready bitmaps
+Called when a task has stopped
+*/
+__inline void clear_task_ready(task_ctrl_blk *task)
+{
+	uint8_t p = task->priority;
+	
+	Ready_tasks[p] &= (uint8_t)(~(0x80 >> (task - Task_list)));
+	//Last ready task of this priority?
+	if(Ready_tasks[p] == 0)
+	{
+		Ready_priorities[p >> 5] &= ~((uint32_t)1 << (p & 31));
+		//Last ready priority of this group?
+		if(Ready_priorities[p >> 5] == 0)
+			Ready_groups &= ~((uint32_t)1 << (p >> 5));
 	}
 }
 
 /*
 Returns a pointer to the "Task_list" entry of the highest priority active task
 (a Task is active if it is in Running or Suspended states)
+
+Constant time: count leading zeros finds the highest ready group, then the highest
+ready priority in it, then the first ready task of that priority in "Task_list".
+Returns the idle task if no task is ready.
 */
 __inline task_ctrl_blk *get_priority_task(void)
 {
-	int i;
-	int highest = 0;
-	int8_t highest_priority = -1;
+	uint32_t group;
+	uint32_t priority;
 	
-	for(i=0; i<8; i++)
+	if(Ready_groups == 0)
+		return &(Task_list[0]);
+	
+	group = 31 - __CLZ(Ready_groups);
+	priority = (group << 5) + 31 - __CLZ(Ready_priorities[group]);
+	return &(Task_list[__CLZ((uint32_t)Ready_tasks[priority] << 24)]);
+}
+
+#ifdef FATE_ADMISSION
+/*
+Liu & Layland bound, n(2^(1/n) - 1), for 1 to 8 tasks (in units of 1/10000, rounded down)
+*/
+static const uint16_t ll_bound[8] = {10000, 8284, 7797, 7568, 7434, 7347, 7286, 7240};
+
+/*
+Period of a task for the analysis, in microseconds
+(aperiodic tasks: the minimum time between events)
+*/
+static uint64_t analysis_period(task_ctrl_blk *task)
+{
+	return (uint64_t)(task->period ? task->period : task->interarrival) * TICK_US;
+}
+
+/*
+Returns 1 if Task_list[j] can preempt Task_list[i]: it has a higher priority,
+or the same priority and comes first in "Task_list" (see "get_priority_task")
+*/
+static uint8_t preempts(int j, int i)
+{
+	return (Task_list[j].priority > Task_list[i].priority) ||
+	       ((Task_list[j].priority == Task_list[i].priority) && (j < i));
+}
+
+/*
+Admission test: returns 1 if every task meets its deadline (the end of its period)
+
+A preempted task starts its job over when it runs again (see "TA0_N_IRQHandler"),
+so every job of a task that can preempt it may cost it up to its own execution
+time again; the analysis charges that on top of the usual interference.
+
+Rate monotonic priorities: the Liu & Layland bound, then the hyperbolic bound,
+are tried first. Otherwise (or if both fail) exact response time analysis:
+R = C + sum over tasks j that can preempt it of ceil(R / T_j) * (C_j + C), iterated
+until it stops changing (schedulable) or exceeds the period (not schedulable).
+*/
+static uint8_t task_set_schedulable(void)
+{
+	int i, j, n = 0;
+	uint8_t rate_monotonic = 1;
+	uint64_t period, jobs, wcet, response, next;
+	uint32_t utilization = 0, hyperbolic = 10000, u;
+	
+	for(i=1;i<NUM_TASKS;i++)
 	{
-		if((Task_list[i].state == TASK_RUNNING) || (Task_list[i].state == TASK_SUSPENDED))
+		if(Task_list[i].state == TASK_UNDEFINED)
+			continue;
+		period = analysis_period(&(Task_list[i]));
+		if(Task_list[i].wcet > period)
+			return 0;
+		
+		//Execution time, including the restarts caused by every job that can preempt it
+		jobs = 1;
+		for(j=1;j<NUM_TASKS;j++)
 		{
-			if(Task_list[i].priority > highest_priority)
+			if((j == i) || (Task_list[j].state == TASK_UNDEFINED))
+				continue;
+			if(preempts(j, i))
+				jobs += (period + analysis_period(&(Task_list[j])) - 1) / analysis_period(&(Task_list[j]));
+			//Shorter period, lower priority: not rate monotonic
+			else if(analysis_period(&(Task_list[j])) < period)
+				rate_monotonic = 0;
+		}
+		wcet = jobs * Task_list[i].wcet;
+		if(wcet > period)
+			break;
+		
+		//Utilization (rounded up), and its contribution to the hyperbolic bound
+		u = (uint32_t)((wcet * 10000 + period - 1) / period);
+		utilization += u;
+		hyperbolic = (uint32_t)(((uint64_t)hyperbolic * (10000 + u) + 9999) / 10000);
+		n++;
+	}
+	if(n == 0)
+		return 1;
+	if(rate_monotonic && (i == NUM_TASKS) &&
+	   ((utilization <= ll_bound[n - 1]) || (hyperbolic <= 20000)))
+		return 1;
+	
+	//Exact response time analysis
+	for(i=1;i<NUM_TASKS;i++)
+	{
+		if(Task_list[i].state == TASK_UNDEFINED)
+			continue;
+		period = analysis_period(&(Task_list[i]));
+		response = Task_list[i].wcet;
+		while(1)
+		{
+			next = Task_list[i].wcet;
+			for(j=1;j<NUM_TASKS;j++)
 			{
-				highest_priority = Task_list[i].priority;
-				highest = i;
+				if((j != i) && (Task_list[j].state != TASK_UNDEFINED) && preempts(j, i))
+					next += ((response + analysis_period(&(Task_list[j])) - 1) / analysis_period(&(Task_list[j]))) *
+					        (Task_list[j].wcet + Task_list[i].wcet);
 			}
+			if(next > period)
+				return 0;
+			if(next == response)
+				break;
+			response = next;
 		}
 	}
-	return &(Task_list[highest]);
+	return 1;
 }
+#endif
 
 /*
 Called by application code (main) to setup periodic tasks
 Requires pointer to the function that implements the task, as 
 well as its period (in system ticks = 10ms) and priority (1 to 255, 1 is lowest)
+With FATE_ADMISSION, also its worst case execution time (in microseconds)
+
+Returns 0 if the task was added, 1 if there is no free slot in "Task_list",
+2 if the task set would not be schedulable with it (FATE_ADMISSION)
 */
-void Task_add(uint32_t function, uint32_t period, uint32_t priority)
+#ifdef FATE_ADMISSION
+uint8_t Task_add(intptr_t function, uint32_t period, uint32_t priority, uint32_t wcet)
+#else
+uint8_t Task_add(intptr_t function, uint32_t period, uint32_t priority)
+#endif
 {
 	int i;
-	for(i=1;i<8;i++)
+	for(i=1;i<NUM_TASKS;i++)
 	{
 		//Find first unused task slot
 		if(Task_list[i].state == TASK_UNDEFINED)
 			break;
 	}
+	if(i == NUM_TASKS)
+		return 1;
 	Task_list[i].state = TASK_STOPPED;
 	Task_list[i].function = function;
 	Task_list[i].period = period;
 	Task_list[i].count = 0;
 	Task_list[i].priority = priority;
+	
+#ifdef FATE_ADMISSION
+	Task_list[i].wcet = wcet;
+	Task_list[i].interarrival = 0;
+	if((period == 0) || !task_set_schedulable())
+	{
+		Task_list[i].state = TASK_UNDEFINED;
+		return 2;
+	}
+#endif
+	return 0;
 }
 
 
@@ -144,16 +412,27 @@ Requires pointer to the function that implements the task, as
 well as its triggering event and priority (1 to 255, 1 is lowest)
 
 Supported events are in "fate.h", defined in "enum events"
+With FATE_ADMISSION, also its worst case execution time (in microseconds), and the
+minimum number of system ticks between two events (the deadline of each job)
+
+Returns as "Task_add"
 */
-void Task_event_add(uint32_t function, enum events event, uint32_t priority)
+#ifdef FATE_ADMISSION
+uint8_t Task_event_add(intptr_t function, enum events event, uint32_t priority,
+                       uint32_t wcet, uint32_t interarrival)
+#else
+uint8_t Task_event_add(intptr_t function, enum events event, uint32_t priority)
+#endif
 {
 	int i;
-	for(i=1;i<8;i++)
+	for(i=1;i<NUM_TASKS;i++)
 	{
 		//Find first unused task slot
 		if(Task_list[i].state == TASK_UNDEFINED)
 			break;
 	}
+	if(i == NUM_TASKS)
+		return 1;
 	Task_list[i].state = TASK_STOPPED;
 	Task_list[i].function = function;
 	//For aperiodic tasks: period set as 0
@@ -162,11 +441,73 @@ void Task_event_add(uint32_t function, enum events event, uint32_t priority)
 	Task_list[i].count = 1;
 	Task_list[i].priority = priority;
 	
+#ifdef FATE_ADMISSION
+	Task_list[i].wcet = wcet;
+	Task_list[i].interarrival = interarrival;
+	if((interarrival == 0) || !task_set_schedulable())
+	{
+		Task_list[i].state = TASK_UNDEFINED;
+		return 2;
+	}
+#endif
+	
 	//Configure Device and Interrupt for corresponding event
 	Enable_event(event);
 	
 	//Set pointer to newly configured task in event-task list
-	Event_task_list[event] = &(Task_list[i]);
+	Event_task_list[event].task = &(Task_list[i]);
+	Task_list[i].event = (int8_t)event;
+	return 0;
+}
+
+/*
+Records an activation of an event's task: activates the task if it is not active,
+otherwise queues the activation until the jobs before it are served
+*/
+__inline void event_activate(enum events event)
+{
+	event_ctrl_blk *e = &(Event_task_list[event]);
+	
+	if(e->pending == EVENT_QUEUE_SIZE)
+	{
+		e->lost++;
+		return;
+	}
+	//Time stamp (the tick ISR may not have counted a roll over yet)
+	e->timestamp[(e->head + e->pending) % EVENT_QUEUE_SIZE] = tick_count + ((TA0CTL & BIT0) ? 1 : 0);
+	if(!e->pending++)
+	{
+		e->task->state = TASK_SUSPENDED;
+		set_task_ready(e->task);
+	}
+}
+
+/*
+Called when a job of an aperiodic task stops: the next pending activation,
+if any, activates the task again right away
+Returns 1 if it did
+*/
+__inline uint8_t event_served(enum events event)
+{
+	event_ctrl_blk *e = &(Event_task_list[event]);
+	
+	e->head = (uint8_t)((e->head + 1) % EVENT_QUEUE_SIZE);
+	if(--e->pending)
+	{
+		e->task->state = TASK_SUSPENDED;
+		set_task_ready(e->task);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+Called by an aperiodic task to get the time (in system ticks)
+of the activation it is serving
+*/
+uint32_t Task_event_time(enum events event)
+{
+	return Event_task_list[event].timestamp[Event_task_list[event].head];
 }
 
 
@@ -240,6 +581,7 @@ Encapsulates inline assembly to get current value of Stack Pointer
 Used in Timer ISR (system tick) to access the stack and manipulate the return address,
 so we return to the task we want
 */
+#ifndef FATE_SIM
 __inline uint32_t get_current_SP()
 {
     uint32_t spReg; 
@@ -249,11 +591,12 @@ __inline uint32_t get_current_SP()
     }
 	return spReg;
 }
+#endif
 
 /*
 Main scheduler implementation
 
-Occurs every 10ms
+Occurs every 10ms, whenever a task stops, and whenever an event activates a task
 
 Updates "count" in every task so we keep track of time
 Based on highest priority currently active task, manipulates stack to change return address
@@ -263,39 +606,77 @@ pointer to current task and Task_list.
 */
 void TA0_N_IRQHandler()
 {
-	uint32_t sp_p;
+	intptr_t sp_p;
 	int i;
 	task_ctrl_blk *new_task;
+	uint8_t restart = 0;
+#ifdef FATE_BENCH
+	uint32_t bench_start = BENCH_CLOCK();
+	uint32_t bench_priority;
+	enum bench_paths bench_path = (TA0CTL & BIT0) ? BENCH_TICK : BENCH_RESCHEDULE;
+#endif
 	
 	
+#ifdef FATE_SIM
+	//Host simulation: the simulator keeps the return address for us
+	sp_p = (intptr_t)&sim_exception_pc;
+#else
 	//Value of current stack pointer
-	sp_p = get_current_SP();
+	sp_p = (intptr_t)get_current_SP();
 	//Find Exception code: basically makes sp_p point to base of current stack frame - 4
 	while((*((uint32_t *)sp_p)) != 0xFFFFFFE9)
-		sp_p += (uint32_t)4;
+		sp_p += (intptr_t)4;
 	//Now that we are pointing to base of current stack frame, increment by 0x1C
 	//so we are pointing at Return Address
 	sp_p += 0x1C;
+#endif
 	
-	//Increment "count" on all tasks, modulo task period
-	//Set task as SUSPENDED (active) if it was STOPPED 
-	//and count is back to 0 (matched period)
-	for(i=1;i<8;i++)
+	//Has the current task stopped itself since the last tick?
+	if(current_task->state == TASK_STOPPED)
 	{
-		//Don't upgrade count if task is aperiodic (period == 0)
-		if(Task_list[i].period)
-		{
-			Task_list[i].count++;
-			Task_list[i].count %= Task_list[i].period;
-		}
-		if(Task_list[i].count == 0)
+		clear_task_ready(current_task);
+		//Aperiodic task: serve the next pending activation
+		if(current_task->event >= 0)
+			restart = event_served((enum events)current_task->event);
+	}
+	
+	//Only a timer roll over is a tick: tasks stopping and events also run the scheduler
+	if(TA0CTL & BIT0)
+	{
+		//Increment "count" on all tasks, modulo task period
+		//Set task as SUSPENDED (active) if it was STOPPED 
+		//and count is back to 0 (matched period)
+		for(i=1;i<NUM_TASKS;i++)
 		{
-			if(Task_list[i].state == TASK_STOPPED)
-				Task_list[i].state = TASK_SUSPENDED;
+			//Don't upgrade count if task is aperiodic (period == 0)
+			if(Task_list[i].period)
+			{
+				Task_list[i].count++;
+				Task_list[i].count %= Task_list[i].period;
+			}
+			if(Task_list[i].count == 0)
+			{
+				if(Task_list[i].state == TASK_STOPPED)
+				{
+					Task_list[i].state = TASK_SUSPENDED;
+					set_task_ready(&(Task_list[i]));
+				}
+			}
 		}
+		
+		tick_count++;
+		
+		//clear Timer interrupt flag
+		TA0CTL &= (uint16_t)(~(BIT0));
 	}
 	//Get pointer to highest priority active (running or suspended) task
+#ifdef FATE_BENCH
+	bench_priority = BENCH_CLOCK();
+	new_task = get_priority_task();
+	bench_priority = BENCH_CLOCK() - bench_priority;
+#else
 	new_task = get_priority_task();
+#endif
 	
 	//Is the current highest priority active task not the currently running task?
 	if(new_task != current_task)
@@ -309,7 +690,7 @@ void TA0_N_IRQHandler()
 		//Update current task pointer
 		current_task = new_task;
 		//Return to new task by changing return address
-		*((uint32_t *)sp_p) = current_task->function;
+		*((intptr_t *)sp_p) = current_task->function;
 	}
 	else
 	{
@@ -320,14 +701,24 @@ void TA0_N_IRQHandler()
 			//Yes: go back to idle task
 			current_task = &(Task_list[0]);
 			current_task->state = TASK_RUNNING;
-			*((uint32_t *)sp_p) = current_task->function;
+			*((intptr_t *)sp_p) = current_task->function;
+		}
+		//Has it just been activated again (pending activation)?
+		else if(restart)
+		{
+			//Yes: start the new job from the beginning
+			current_task->state = TASK_RUNNING;
+			*((intptr_t *)sp_p) = current_task->function;
 		}
 		//No, current task is not finished
 		//Return to same task (do nothing)
 	}
-		
-	//clear Timer interrupt flag
-	TA0CTL &= (uint16_t)(~(BIT0));
+	
+#ifdef FATE_BENCH
+	//Not counting the time taken to measure "get_priority_task"
+	bench_record(bench_path, BENCH_CLOCK() - bench_start - bench_overhead);
+	bench_record(BENCH_PRIORITY, bench_priority);
+#endif
 }
 
 /*
@@ -340,20 +731,24 @@ void PORT1_IRQHandler(void)
 	{
 		P1IFG &= (uint8_t)(~BIT1);
 		//If corresponding event-task is initialized
-		if(Event_task_list[SWITCH_P1_1])
+		if(Event_task_list[SWITCH_P1_1].task)
 		{
-			//Activate task (schedule will eventually run it)
-			Event_task_list[SWITCH_P1_1]->state = TASK_SUSPENDED;
+			//Activate task (or queue the activation, if it is active)
+			event_activate(SWITCH_P1_1);
+			//Run the scheduler right away (tail-chained to this ISR)
+			NVIC_SetPendingIRQ(TA0_N_IRQn);
 		}
 	}
 	if(P1IFG & BIT4)
 	{
 		P1IFG &= (uint8_t)(~BIT4);
 		//If corresponding event-task is initialized
-		if(Event_task_list[SWITCH_P1_4])
+		if(Event_task_list[SWITCH_P1_4].task)
 		{
-			//Activate task (schedule will eventually run it)
-			Event_task_list[SWITCH_P1_4]->state = TASK_SUSPENDED;
+			//Activate task (or queue the activation, if it is active)
+			event_activate(SWITCH_P1_4);
+			//Run the scheduler right away (tail-chained to this ISR)
+			NVIC_SetPendingIRQ(TA0_N_IRQn);
 		}
 	}
 }
@@ -374,6 +769,14 @@ void Task_schedule(void)
 	NVIC_EnableIRQ(TA0_N_IRQn);
 	NVIC_SetPriority(TA0_N_IRQn, 2);
 	
+#ifdef FATE_BENCH
+	//Start the DWT cycle counter
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	Bench_reset();
+#endif
+	
 	//enable CPU interrupts
 	__ASM("CPSIE I");
 	
@@ -22,6 +22,10 @@ Tasks cannot call other functions nor should they have local variables.
 
 V1.1:
 Added support for aperiodic tasks (port interrupt events only)
+Events run the scheduler immediately, instead of at the next tick
+Aperiodic task activations are counted (and time stamped), so bursts are not lost
+Runs in the host simulator (FATE_SIM); optional scheduler cost measurement (FATE_BENCH)
+Optional admission control: tasks that would make the task set unschedulable are rejected (FATE_ADMISSION)
 
 ******************************************************/
 
@@ -31,6 +35,38 @@ Added support for aperiodic tasks (port interrupt events only)
 #include <msp.h>
 #include <stdint.h>
 
+/*
+Size of "Task_list", idle task included
+(at most 8: "Ready_tasks" holds one bit per task)
+*/
+#ifndef NUM_TASKS
+#define NUM_TASKS 8
+#endif
+#if NUM_TASKS > 8
+#error "NUM_TASKS is at most 8 in v1.1: Ready_tasks holds one bit per task"
+#endif
+
+/*
+Define to measure the cost of the scheduler: the tick handler, "get_priority_task"
+and "Task_stop" are timed with the DWT cycle counter (host nanoseconds in the
+simulator), per number of active tasks. See "bench.c".
+*/
+//#define FATE_BENCH
+
+/*
+Define to check, whenever a task is added, that every task still meets its
+deadline (the end of its period, or the next event for aperiodic tasks).
+"Task_add" and "Task_event_add" then also take the task's worst case execution
+time in microseconds (and, for aperiodic tasks, the minimum number of system
+ticks between events), and reject the task if the task set fails the test.
+*/
+//#define FATE_ADMISSION
+
+/*
+System tick length in microseconds (Timer A0 counts 329 ACLK periods), rounded down
+*/
+#define TICK_US 10040
+
 
 /*
 Definitions for different Task states.
@@ -53,6 +89,12 @@ For now, only switches (p1.1 and p1.4)
 */
 enum events {SWITCH_P1_1 = 0, SWITCH_P1_4};
 
+/*
+Number of activations of an aperiodic task that can be pending
+(further ones are counted as lost)
+*/
+#define EVENT_QUEUE_SIZE 4
+
 /*
 Structure that hold information for each task
 
@@ -63,43 +105,129 @@ and counter for system ticks
 typedef struct 
 {
 	int8_t state; //-1 not initialized, 0 stopped, 1 suspended, 2 running
-	uint32_t function; //address of function that implements thread
+	intptr_t function; //address of function that implements thread
 	uint32_t period; //thread's periodicity in number of system ticks
 	uint32_t count; //number of system ticks that elapsed while task is stopped
-	int8_t priority; //task's priority 0 lowest, 255 highest
+	uint8_t priority; //task's priority 0 lowest, 255 highest
+	int8_t event; //event that activates the task, -1 if periodic
+#ifdef FATE_ADMISSION
+	uint32_t wcet; //worst case execution time, in microseconds
+	uint32_t interarrival; //aperiodic tasks: minimum number of system ticks between events
+#endif
 } 
 task_ctrl_blk;
 
+/*
+Structure that holds information for each event
+
+Task the event activates, and a queue of the activations the task has not
+served yet (the active job's included), with the system tick each one happened on
+*/
+typedef struct
+{
+	task_ctrl_blk *task; //task activated by the event (0 if none)
+	uint8_t pending; //activations received and not yet served
+	uint8_t head; //position of the oldest pending activation in "timestamp"
+	uint16_t lost; //activations dropped because EVENT_QUEUE_SIZE were already pending
+	uint32_t timestamp[EVENT_QUEUE_SIZE]; //system tick of each pending activation
+}
+event_ctrl_blk;
+
 /*
 Various function definitions: see "fate.c"
 */
 void idle_thread(void);
 void Task_list_init(void);
 task_ctrl_blk *get_priority_task(void);
-void Task_add(uint32_t function, uint32_t period, uint32_t priority);
-void Task_event_add(uint32_t function, enum events event, uint32_t priority);
+void set_task_ready(task_ctrl_blk *task);
+void clear_task_ready(task_ctrl_blk *task);
+#ifdef FATE_ADMISSION
+uint8_t Task_add(intptr_t function, uint32_t period, uint32_t priority, uint32_t wcet);
+uint8_t Task_event_add(intptr_t function, enum events event, uint32_t priority,
+                       uint32_t wcet, uint32_t interarrival);
+#else
+uint8_t Task_add(intptr_t function, uint32_t period, uint32_t priority);
+uint8_t Task_event_add(intptr_t function, enum events event, uint32_t priority);
+#endif
+void event_activate(enum events event);
+uint8_t event_served(enum events event);
+uint32_t Task_event_time(enum events event);
+#ifndef FATE_SIM
 __inline uint32_t get_current_SP(void);
+#endif
 void Task_schedule(void);
 void Enable_event(enum events event);
 
+#ifdef FATE_BENCH
+/*
+Scheduler paths timed by FATE_BENCH
+*/
+enum bench_paths {
+	BENCH_TICK = 0, //TA0_N_IRQHandler, on a timer roll over
+	BENCH_RESCHEDULE, //TA0_N_IRQHandler, run by a task stopping or an event
+	BENCH_PRIORITY, //get_priority_task
+	BENCH_STOP, //Task_stop, up to running the scheduler
+	NUM_BENCH_PATHS
+};
+
+/*
+Structure that holds the measurements of one scheduler path
+
+Calls are grouped by the number of tasks active (Running or Suspended,
+idle task excluded) when the path finishes
+*/
+typedef struct
+{
+	uint32_t count; //calls measured
+	uint32_t min; //shortest call
+	uint32_t max; //longest call
+	uint64_t total; //sum of all calls
+}
+bench_stat;
+
+extern bench_stat Bench_stats[NUM_BENCH_PATHS][NUM_TASKS];
+void Bench_reset(void);
+void bench_record(enum bench_paths path, uint32_t elapsed);
+
+/*
+Clock the scheduler is timed with
+*/
+#ifdef FATE_SIM
+#define BENCH_CLOCK() sim_host_clock()
+#define BENCH_UNIT "host_ns"
+#else
+#define BENCH_CLOCK() (DWT->CYCCNT)
+#define BENCH_UNIT "cycles"
+#endif
+
+#define BENCH_START(X) uint32_t X = BENCH_CLOCK()
+#define BENCH_END(P, X) bench_record((P), BENCH_CLOCK() - (X))
+#else
+#define BENCH_START(X)
+#define BENCH_END(P, X)
+#endif
+
 /*
 Macro called by each task when it finishes execution
 
 Since we do not want Task functions to call other function (no proper stack handling yet)
 this is implemented as a Macro rather than a function.
 
-"Task_stop" finds the calling task by function address in the task list
-and changes its state to Stopped.
+"Task_stop" finds the calling task by function address in the task list,
+changes its state to Stopped and runs the scheduler right away.
 */
 //Stops a task
 #define Task_stop(X) { \
-	extern task_ctrl_blk Task_list[8]; \
+	extern task_ctrl_blk Task_list[NUM_TASKS]; \
 	int i; \
-	for(i=1;i<8;i++) \
+	BENCH_START(bench_start); \
+	for(i=1;i<NUM_TASKS;i++) \
 	{ \
 		if(Task_list[i].function == X) \
 		{ \
 			Task_list[i].state = TASK_STOPPED; \
+			BENCH_END(BENCH_STOP, bench_start); \
+			NVIC_SetPendingIRQ(TA0_N_IRQn); \
 		while(1); \
 		} \
 	}\
@@ -13,12 +13,12 @@
 void LED_toggle(void)
 {
 	P1OUT ^= (uint8_t)BIT0;
-	Task_stop((uint32_t)LED_toggle);
+	Task_stop((intptr_t)LED_toggle);
 }
 void LED_RGB_toggle(void)
 {
 	P2OUT = (uint8_t)((P2OUT & (uint8_t)0xF8) | ((P2OUT + (uint8_t)1) & ((uint8_t)7)));
-	Task_stop((uint32_t)LED_RGB_toggle);
+	Task_stop((intptr_t)LED_RGB_toggle);
 }
 
 
@@ -44,9 +44,16 @@ int main()
 	Task_list_init();
 	
 	//Initialize our periodic tasks, with periods 100 and 200 ticks (1 and 2s), respectively
-	Task_add((uint32_t)LED_toggle,(uint32_t) 100, (uint32_t) 1);
+#ifdef FATE_ADMISSION
+	//Both take well under 1ms; the switch is not pressed more than 10 times a second
+	Task_add((intptr_t)LED_toggle,(uint32_t) 100, (uint32_t) 1, (uint32_t) 1000);
 	
-	Task_event_add((uint32_t)LED_RGB_toggle, SWITCH_P1_4, (uint32_t) 1);
+	Task_event_add((intptr_t)LED_RGB_toggle, SWITCH_P1_4, (uint32_t) 1, (uint32_t) 1000, (uint32_t) 10);
+#else
+	Task_add((intptr_t)LED_toggle,(uint32_t) 100, (uint32_t) 1);
+	
+	Task_event_add((intptr_t)LED_RGB_toggle, SWITCH_P1_4, (uint32_t) 1);
+#endif
 	
 	//This will begin scheduling our tasks 
 	Task_schedule();
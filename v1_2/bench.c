@@ -0,0 +1,99 @@
+#include <msp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+//Must always include our OS header file
+#include "fate.h"
+
+/*
+ Scheduler overhead benchmark: an application to build instead of "main.c",
+ with the kernel's FATE_BENCH option
+
+ NUM_TASKS - 2 tasks that do no work are released with periods of 1 to
+ NUM_TASKS - 2 ticks, so every tick releases a different number of them at
+ once and the scheduler runs with every number of active tasks. After
+ BENCH_TICKS ticks, a reporting task prints what the kernel measured, as CSV:
+
+   kernel,policy,num_tasks,path,active,unit,count,min,avg,max
+
+ one row per scheduler path and number of tasks active when it finished
+ ("unit" is "cycles" on the Launchpad, "host_ns" in the simulator).
+ "host/bench.sh" runs it in the simulator for both kernels and several NUM_TASKS.
+ */
+
+#ifndef FATE_BENCH
+#error "bench.c needs the kernel's FATE_BENCH option"
+#endif
+
+// Ticks measured before reporting
+#define BENCH_TICKS 1000
+
+// Names of "enum bench_path", in the CSV
+static const char *const path_names[NUM_BENCH_PATHS] = {
+    "tick", "reschedule", "get_priority_task", "task_stop", "switch"
+};
+
+// Tasks that do no work (one function each: "Task_stop" finds tasks by function)
+#define WORKER(n) void worker##n(void); void worker##n(void) { Task_stop((intptr_t)worker##n); }
+WORKER(1)  WORKER(2)  WORKER(3)  WORKER(4)  WORKER(5)  WORKER(6)
+WORKER(7)  WORKER(8)  WORKER(9)  WORKER(10) WORKER(11) WORKER(12)
+WORKER(13) WORKER(14) WORKER(15) WORKER(16) WORKER(17) WORKER(18)
+WORKER(19) WORKER(20) WORKER(21) WORKER(22) WORKER(23) WORKER(24)
+WORKER(25) WORKER(26) WORKER(27) WORKER(28) WORKER(29) WORKER(30)
+
+static void (*const workers[])(void) = {
+    worker1,  worker2,  worker3,  worker4,  worker5,  worker6,
+    worker7,  worker8,  worker9,  worker10, worker11, worker12,
+    worker13, worker14, worker15, worker16, worker17, worker18,
+    worker19, worker20, worker21, worker22, worker23, worker24,
+    worker25, worker26, worker27, worker28, worker29, worker30
+};
+
+void Report(void);
+
+// Prints the measurements once, with the earliest deadline so nothing preempts it
+void Report(void)
+{
+    static uint8_t reported = 0;
+    bench_stat stat;
+    int path, active;
+
+    if(!reported)
+    {
+        reported = 1;
+        printf("kernel,policy,num_tasks,path,active,unit,count,min,avg,max\n");
+        for(path=0;path<NUM_BENCH_PATHS;path++)
+        {
+            for(active=0;active<NUM_TASKS;active++)
+            {
+                if(Bench_get((enum bench_path)path, (uint32_t)active, &stat) || !stat.count)
+                    continue;
+                printf("v1_2,edf,%d,%s,%d,%s,%lu,%lu,%lu,%lu\n", NUM_TASKS, path_names[path],
+                       active, BENCH_UNIT, (unsigned long)stat.count, (unsigned long)stat.min,
+                       (unsigned long)(stat.total / stat.count), (unsigned long)stat.max);
+            }
+        }
+#ifdef FATE_SIM
+        //Nothing else to measure: end the simulation
+        exit(0);
+#endif
+    }
+    Task_stop((intptr_t)Report);
+}
+
+int main(void)
+{
+    int i;
+
+    //Initialize Task list, includes setting up idle task
+    //Always the first function that must be called
+    Task_list_init();
+
+    Task_add((intptr_t)Report, BENCH_TICKS, BENCH_TICKS - 1, 1);
+    for(i=0;(i<NUM_TASKS-2) && (i<(int)(sizeof(workers)/sizeof(workers[0])));i++)
+        Task_add((intptr_t)workers[i], (uint32_t)(i + 1), 0, (uint32_t)(i + 1));
+
+    //This will begin scheduling our tasks
+    Task_schedule();
+    return 0;
+}
@@ -1,7 +1,7 @@
 /*****************************************************
  
  
- FATE_OS_C v1.1
+ FATE_OS_C v1.2
  The "Fake Time Environment Operating System"
  
  Developed by
@@ -23,6 +23,24 @@
  V1.1:
  Added support for aperiodic tasks (port interrupt events only)
  
+ V1.2:
+ EDF scheduling, with start offsets and deadlines
+ Optional tickless operation (FATE_TICKLESS)
+ Releases and deadlines kept in delta queues (per-tick work only for due events)
+ Context switching through PendSV, with a stack per task: preempted tasks resume
+ where they left off, and may use local variables, call functions and return
+ Events run the scheduler immediately, instead of at the next tick
+ Aperiodic task activations are counted (and time stamped), so bursts are not lost
+ Table-driven events: any pin of ports P1-P6, or software events (Event_signal)
+ Optional execution time profiling with the DWT cycle counter (FATE_PROFILE)
+ Optional scheduler trace, drained to ITM (FATE_TRACE)
+ Optional scheduler cost measurement (FATE_BENCH)
+ Optional admission control with the EDF processor demand test (FATE_ADMISSION)
+ Deadline misses detected and counted per task, with an optional handler and
+ an overrun policy per task (continue, abort the job, or skip the next release)
+ Absolute deadlines, with active jobs in a binary heap in EDF order
+ Aperiodic jobs get a deadline relative to their activation, instead of being most urgent
+ 
  ******************************************************/
 
 #include <msp.h>
@@ -34,6 +52,19 @@ void Enable_event(enum events event);
 
 void TA0_N_IRQHandler(void);
 void PORT1_IRQHandler(void);
+void PORT2_IRQHandler(void);
+void PORT3_IRQHandler(void);
+void PORT4_IRQHandler(void);
+void PORT5_IRQHandler(void);
+void PORT6_IRQHandler(void);
+void PendSV_Handler(void);
+uint32_t *switch_context(uint32_t *sp);
+static void deadline_missed(task_ctrl_blk *task);
+static void event_served(event_ctrl_blk *event);
+static uint32_t current_tick(void);
+#ifdef FATE_TRACE
+static void trace_drain(void);
+#endif
 
 
 /**
@@ -43,7 +74,13 @@ void PORT1_IRQHandler(void);
  */
 void idle_thread(void)
 {
-    while(1) __WFI();
+    while(1)
+    {
+#ifdef FATE_TRACE
+        trace_drain();
+#endif
+        __WFI();
+    }
 }
 
 /**
@@ -53,10 +90,38 @@ void idle_thread(void)
 task_ctrl_blk Task_list[NUM_TASKS];
 
 /**
- *  List that matches events to a corresponding task
- *  (just 2 events for now)
+ *  List that matches events to a corresponding task, and queues
+ *  the activations the task has not served yet
+ */
+event_ctrl_blk Event_task_list[NUM_EVENTS];
+
+/**
+ *  Event source to "Event_task_list" lookup table: entry + 1, or 0 if no task is attached
+ *  ISRs find the task an event activates with this single lookup.
  */
-task_ctrl_blk *Event_task_list[NUM_EVENTS];
+static uint8_t event_slot[EVENT_SOURCES];
+
+/** Configuration registers of an interrupt capable port */
+typedef struct
+{
+    volatile uint8_t *sel0;
+    volatile uint8_t *sel1;
+    volatile uint8_t *dir;
+    volatile uint8_t *ren;
+    volatile uint8_t *out;
+    volatile uint8_t *ies;
+    volatile uint8_t *ifg;
+    volatile uint8_t *ie;
+}
+port_regs;
+
+#define PORT_REGS(n) { &(P##n##SEL0), &(P##n##SEL1), &(P##n##DIR), &(P##n##REN), \
+                       &(P##n##OUT), &(P##n##IES), &(P##n##IFG), &(P##n##IE) }
+
+/** Ports P1-P6, to configure event pins */
+static const port_regs ports[6] = {
+    PORT_REGS(1), PORT_REGS(2), PORT_REGS(3), PORT_REGS(4), PORT_REGS(5), PORT_REGS(6)
+};
 
 /**
  *  Pointer to element in "Task_list" that is currently executing
@@ -65,6 +130,143 @@ task_ctrl_blk *Event_task_list[NUM_EVENTS];
  */
 task_ctrl_blk *current_task = &(Task_list[0]);
 
+/**
+ *  Pointer to element in "Task_list" whose context is on the CPU
+ *  Differs from "current_task" only until PendSV switches context.
+ */
+static task_ctrl_blk *running_task = &(Task_list[0]);
+
+/**
+ *  Task stacks, one per element of "Task_list"
+ *  (64 bit elements keep them 8 byte aligned, as the ARM procedure call standard requires)
+ */
+static uint64_t task_stacks[NUM_TASKS][STACK_SIZE / 8];
+
+#ifdef FATE_PROFILE
+/**
+ *  DWT cycle count when "running_task" was switched in
+ */
+static uint32_t switched_in;
+#endif
+
+#ifdef FATE_TRACE
+/**
+ *  Trace ring buffer
+ *  Records are claimed by incrementing "trace_head" with LDREX/STREX, so any
+ *  interrupt (or task) can trace without locking; each record is complete once
+ *  its type is written, and the reader empties it after reading.
+ */
+static volatile trace_record trace_buffer[TRACE_SIZE];
+static volatile uint32_t trace_head;
+static volatile uint32_t trace_tail;
+static volatile uint32_t trace_dropped;
+/** Dropped records already reported in the ITM stream (see "trace_drain") */
+static uint32_t trace_reported;
+/** Ticks elapsed since the last TRACE_TICK record (tick handler only) */
+static uint32_t trace_ticks;
+
+/**
+ *  Appends a record to the trace ring buffer (dropped if it is full)
+ */
+static void trace(uint8_t type, task_ctrl_blk *task, uint16_t arg)
+{
+    volatile trace_record *record;
+    uint32_t head;
+    //Stamped before the slot is claimed: an interrupt traced in between is at most
+    //as far out of order as it is long (not a slot claimed, then stamped much later)
+    uint32_t timestamp = DWT->CYCCNT;
+    
+    do {
+        head = __LDREXW(&trace_head);
+        if(head - trace_tail >= TRACE_SIZE)
+        {
+            __CLREX();
+            trace_dropped++;
+            return;
+        }
+    } while(__STREXW(head + 1, &trace_head));
+    
+    record = &(trace_buffer[head % TRACE_SIZE]);
+    record->timestamp = timestamp;
+    record->task = (uint8_t)(task - Task_list);
+    record->arg = arg;
+    record->type = type;
+}
+
+#define TRACE(type, task, arg) trace((type), (task), (uint16_t)(arg))
+#else
+#define TRACE(type, task, arg)
+#endif
+
+#ifdef FATE_BENCH
+/**
+ *  Scheduler measurements (see "Bench_get"), and the time it takes
+ *  to read "BENCH_CLOCK" (taken out of every measurement)
+ */
+static bench_stat bench_stats[NUM_BENCH_PATHS][NUM_TASKS];
+static uint32_t bench_overhead;
+
+/**
+ *  Adds a measurement of a scheduler path, by the number of tasks active at its end
+ */
+static void bench_record(enum bench_path path, uint32_t elapsed)
+{
+    bench_stat *stat;
+    int i, active = 0;
+    
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        if((Task_list[i].state == TASK_RUNNING) || (Task_list[i].state == TASK_SUSPENDED))
+            active++;
+    }
+    elapsed = (elapsed > bench_overhead) ? (elapsed - bench_overhead) : 0;
+    
+    stat = &(bench_stats[path][active]);
+    stat->count++;
+    stat->total += elapsed;
+    if(elapsed < stat->min)
+        stat->min = elapsed;
+    if(elapsed > stat->max)
+        stat->max = elapsed;
+}
+#endif
+
+/**
+ *  Number of system ticks covered by the current Timer A0 period
+ *  (always 1, unless running tickless)
+ */
+static uint32_t sleep_ticks = 1;
+
+/**
+ *  System ticks elapsed up to the start of the current Timer A0 period
+ */
+static uint32_t tick_count;
+
+/**
+ *  Delta queue of periodic task releases, in time order
+ */
+static timer_node *release_queue;
+
+/**
+ *  Binary min-heap of the active tasks, in EDF order
+ *  (earliest absolute deadline first, ties broken by position in "Task_list")
+ *  A task leaves it when it misses its deadline, or when it stops.
+ */
+static task_ctrl_blk *ready_heap[NUM_TASKS];
+static uint32_t ready_count;
+
+/**
+ *  Active tasks whose deadline has passed: bit (31-i) is set for Task_list[i]
+ *  (jobs that missed their deadline and carry on)
+ *  They all rank ahead of the tasks in "ready_heap".
+ */
+static uint32_t expired_tasks;
+
+/**
+ *  Called on every deadline miss (see "Task_set_miss_handler")
+ */
+static void (*miss_handler)(intptr_t function);
+
 /**
  *  Must always be called in "main" prior to adding other tasks.
  
@@ -79,56 +281,351 @@ void Task_list_init(void)
     Task_list[0].state = TASK_RUNNING;
     Task_list[0].function = (intptr_t)idle_thread;
     Task_list[0].period = 1;
-    Task_list[0].count = 0;
+    
+    //Stacks grow down, from the end of each task's array
+    for(i=0;i<NUM_TASKS;i++)
+    {
+        Task_list[i].stack = (uint32_t *)(task_stacks[i] + STACK_SIZE / 8);
+        Task_list[i].sp = (uint32_t *)0;
+        Task_list[i].exec_timers = 0;
+        Task_list[i].event = (event_ctrl_blk *)0;
+        Task_list[i].misses = 0;
+        Task_list[i].overrun = OVERRUN_CONTINUE;
+        Task_list[i].skip_release = 0;
+    }
+    miss_handler = 0;
+#ifdef FATE_PROFILE
+    Task_reset_profiles();
+#endif
     
     for(i=1;i<NUM_TASKS;i++)
     {
         Task_list[i].state = TASK_UNDEFINED;
         Task_list[i].function = (intptr_t)idle_thread;
         Task_list[i].period = 1;
-        Task_list[i].count = 0;
+        Task_list[i].release_timer.task = &(Task_list[i]);
     }
     
+    release_queue = (timer_node *)0;
+    ready_count = 0;
+    expired_tasks = 0;
+    tick_count = 0;
+    
     //Clear all aperiodic events
+    for(i=0;i<EVENT_SOURCES;i++)
+    {
+        event_slot[i] = 0;
+    }
     for(i=0;i<NUM_EVENTS;i++)
     {
-        Event_task_list[i] = (task_ctrl_blk *)0;
+        Event_task_list[i].task = (task_ctrl_blk *)0;
+        Event_task_list[i].pending = 0;
+        Event_task_list[i].head = 0;
+        Event_task_list[i].lost = 0;
+    }
+}
+
+/**
+ *  Inserts "node" in a delta queue, to expire "ticks" system ticks from now
+ *  Entries expiring at the same time are kept in "Task_list" order.
+ */
+static void timer_insert(timer_node **queue, timer_node *node, uint32_t ticks)
+{
+    while(*queue && ((ticks > (*queue)->delta) ||
+                     ((ticks == (*queue)->delta) && ((*queue)->task < node->task))))
+    {
+        ticks -= (*queue)->delta;
+        queue = &((*queue)->next);
+    }
+    node->delta = ticks;
+    node->next = *queue;
+    //The entry after the new one now expires relative to it
+    if(node->next)
+        node->next->delta -= ticks;
+    *queue = node;
+}
+
+/**
+ *  Removes the entries that expire within "ticks" system ticks from a delta queue,
+ *  and returns them as a list (in expiration order).
+ *  The "delta" of each returned entry holds how many ticks ago it expired.
+ */
+static timer_node *timer_expire(timer_node **queue, uint32_t ticks)
+{
+    timer_node *expired = *queue;
+    timer_node *last = (timer_node *)0;
+    
+    while(*queue && ((*queue)->delta <= ticks))
+    {
+        last = *queue;
+        ticks -= last->delta;
+        //From now on, "delta" holds how many ticks ago the entry expired
+        last->delta = ticks;
+        *queue = last->next;
     }
+    if(*queue)
+        (*queue)->delta -= ticks;
+    if(!last)
+        return (timer_node *)0;
+    last->next = (timer_node *)0;
+    return expired;
+}
+
+/**
+ *  Has the system tick "deadline" been reached at tick "now"?
+ *  (tick counts wrap around: deadlines must be less than 2^31 ticks away)
+ */
+static inline uint8_t deadline_reached(uint32_t deadline, uint32_t now)
+{
+    return (int32_t)(deadline - now) <= 0;
+}
+
+/**
+ *  Does the job of "a" go before the job of "b" in EDF order?
+ */
+static inline uint8_t ready_before(const task_ctrl_blk *a, const task_ctrl_blk *b)
+{
+    int32_t difference = (int32_t)(a->absolute_deadline - b->absolute_deadline);
+    
+    return (difference < 0) || ((difference == 0) && (a < b));
+}
+
+/**
+ *  Places "task" in the hole at position "i" of "ready_heap", or further up,
+ *  moving down the tasks it goes before
+ */
+static void ready_sift_up(task_ctrl_blk *task, uint32_t i)
+{
+    uint32_t parent;
+    
+    while(i && ready_before(task, ready_heap[parent = (i - 1) / 2]))
+    {
+        ready_heap[i] = ready_heap[parent];
+        ready_heap[i]->ready_index = (uint8_t)i;
+        i = parent;
+    }
+    ready_heap[i] = task;
+    task->ready_index = (uint8_t)i;
+}
+
+/**
+ *  Places "task" in the hole at position "i" of "ready_heap", or further down,
+ *  moving up the tasks that go before it
+ */
+static void ready_sift_down(task_ctrl_blk *task, uint32_t i)
+{
+    uint32_t child;
+    
+    while((child = 2 * i + 1) < ready_count)
+    {
+        //Earliest of the two children
+        if((child + 1 < ready_count) && ready_before(ready_heap[child + 1], ready_heap[child]))
+            child++;
+        if(!ready_before(ready_heap[child], task))
+            break;
+        ready_heap[i] = ready_heap[child];
+        ready_heap[i]->ready_index = (uint8_t)i;
+        i = child;
+    }
+    ready_heap[i] = task;
+    task->ready_index = (uint8_t)i;
+}
+
+/**
+ *  Adds an active task to "ready_heap", by its "absolute_deadline"
+ */
+static void ready_insert(task_ctrl_blk *task)
+{
+    ready_sift_up(task, ready_count++);
+}
+
+/**
+ *  Removes a task from "ready_heap"
+ */
+static void ready_remove(task_ctrl_blk *task)
+{
+    task_ctrl_blk *last = ready_heap[--ready_count];
+    uint32_t i = task->ready_index;
+    
+    if(last == task)
+        return;
+    //The last entry fills the hole, and moves up or down to its place
+    if(i && ready_before(last, ready_heap[(i - 1) / 2]))
+        ready_sift_up(last, i);
+    else
+        ready_sift_down(last, i);
 }
 
 /**
  *  Returns a pointer to the "Task_list" entry of the highest priority active task
  *  (a Task is active if it is in Running or Suspended states)
+ *
+ *  Active tasks are all either in "expired_tasks" (deadline already passed)
+ *  or in "ready_heap" (in EDF order), so this does not scan "Task_list".
  */
 static inline task_ctrl_blk *get_priority_task(void)
 {
+    if(expired_tasks)
+        return Task_list + __CLZ(expired_tasks);
+    if(ready_count)
+        return ready_heap[0];
+    return Task_list;
+}
+
+#ifdef FATE_ADMISSION
+/** Utilization of 100%, in the fixed point format of "task_set_schedulable" */
+#define FULL_UTILIZATION ((uint64_t)1 << 20)
+
+/**
+ *  Period and relative deadline of a task for the analysis, in microseconds
+ *  (for aperiodic tasks, the period is the minimum time between events)
+ */
+static uint64_t analysis_period(const task_ctrl_blk *task)
+{
+    return (uint64_t)(task->period ? task->period : task->interarrival) * TICK_US;
+}
+
+static uint64_t analysis_deadline(const task_ctrl_blk *task)
+{
+    return (uint64_t)task->deadline * TICK_US;
+}
+
+/**
+ *  Processor demand in [0, t], in microseconds: the execution time of every job
+ *  released and due in it, with every task released at time 0
+ */
+static uint64_t processor_demand(uint64_t t)
+{
+    uint64_t demand = 0, deadline;
     int i;
-    int earliest = 0;
-    uint32_t earliest_deadline = UINT32_MAX;
     
-    // Skip the idle task, it's always going to show up as having a deadline
-    // of 0, but skipping it effectivly makes it's deadline UINT32_MAX
     for(i=1;i<NUM_TASKS;i++)
     {
-        if((Task_list[i].state == TASK_RUNNING) || (Task_list[i].state == TASK_SUSPENDED))
+        if(Task_list[i].state == TASK_UNDEFINED)
+            continue;
+        deadline = analysis_deadline(&(Task_list[i]));
+        if(t >= deadline)
+            demand += ((t - deadline) / analysis_period(&(Task_list[i])) + 1) * Task_list[i].wcet;
+    }
+    return demand;
+}
+
+/**
+ *  Latest absolute deadline of any job before t (0 if there is none),
+ *  with every task released at time 0
+ */
+static uint64_t deadline_before(uint64_t t)
+{
+    uint64_t latest = 0, deadline, period;
+    int i;
+    
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        if(Task_list[i].state == TASK_UNDEFINED)
+            continue;
+        deadline = analysis_deadline(&(Task_list[i]));
+        period = analysis_period(&(Task_list[i]));
+        if(t > deadline)
         {
-            if(!Task_list[i].start_offset && (Task_list[i].deadline_remaining < earliest_deadline))
-            {
-                earliest_deadline = Task_list[i].deadline_remaining;
-                earliest = i;
-            }
+            deadline += (t - deadline - 1) / period * period;
+            if(deadline > latest)
+                latest = deadline;
         }
     }
-    return Task_list + earliest;
+    return latest;
 }
 
+/**
+ *  Admission test: returns 1 if no job misses its deadline under EDF
+ *
+ *  Start offsets are ignored: releasing every task at once is the worst case.
+ *  The task set is schedulable if the processor demand in [0, t] never exceeds t,
+ *  for every absolute deadline t up to the end of the first busy period (or up to
+ *  the bound derived from the utilization, if shorter). QPA (Zhang & Burns) checks
+ *  them from the last one down, jumping straight to t = demand(t) whenever the
+ *  demand is below t, so only a few deadlines are ever looked at.
+ */
+static uint8_t task_set_schedulable(void)
+{
+    uint64_t period, deadline, utilization = 0, excess = 0, limit = UINT64_MAX;
+    uint64_t busy = 0, next, t, demand, shortest = UINT64_MAX, longest = 0;
+    int i;
+    
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        if(Task_list[i].state == TASK_UNDEFINED)
+            continue;
+        period = analysis_period(&(Task_list[i]));
+        deadline = analysis_deadline(&(Task_list[i]));
+        if(period == 0)
+            return 0;
+        //Rounded up, so a task set reported under 100% really is
+        utilization += ((uint64_t)Task_list[i].wcet * FULL_UTILIZATION + period - 1) / period;
+        if(period > deadline)
+            excess += ((period - deadline) * Task_list[i].wcet + period - 1) / period;
+        busy += Task_list[i].wcet;
+        if(deadline < shortest)
+            shortest = deadline;
+        if(deadline > longest)
+            longest = deadline;
+    }
+    if(utilization > FULL_UTILIZATION)
+        return 0;
+    if(busy == 0)
+        return 1;
+    
+    //Below 100%, demand cannot exceed t past max(longest deadline, excess / (1 - utilization))
+    if(utilization < FULL_UTILIZATION)
+    {
+        limit = excess * FULL_UTILIZATION / (FULL_UTILIZATION - utilization);
+        if(limit < longest)
+            limit = longest;
+    }
+    //First busy period: w = sum of ceil(w / period) * wcet, until it stops growing
+    while(busy < limit)
+    {
+        next = 0;
+        for(i=1;i<NUM_TASKS;i++)
+        {
+            if(Task_list[i].state == TASK_UNDEFINED)
+                continue;
+            period = analysis_period(&(Task_list[i]));
+            next += (busy + period - 1) / period * Task_list[i].wcet;
+        }
+        if(next == busy)
+            break;
+        busy = next;
+    }
+    if(busy > limit)
+        busy = limit;
+    
+    //QPA
+    t = deadline_before(busy + 1);
+    demand = processor_demand(t);
+    while((demand <= t) && (demand > shortest))
+    {
+        if(demand < t)
+            t = demand;
+        else
+            t = deadline_before(t);
+        demand = processor_demand(t);
+    }
+    return demand <= shortest;
+}
+#endif
+
 /**
  *  Called by application code (main) to setup periodic tasks
  *  Requires pointer to the function that implements the task, as
  *  well as its period (in system ticks = 10ms) and priority (1 to 255, 1 is lowest)
  */
+#ifdef FATE_ADMISSION
+uint8_t Task_add(intptr_t function, uint32_t period, uint32_t start_offset,
+                 uint32_t deadline, uint32_t wcet)
+#else
 uint8_t Task_add(intptr_t function, uint32_t period, uint32_t start_offset,
                  uint32_t deadline)
+#endif
 {
     int i;
     for(i = 1; (i<NUM_TASKS) && (Task_list[i].state != TASK_UNDEFINED); i++);
@@ -138,8 +635,18 @@ uint8_t Task_add(intptr_t function, uint32_t period, uint32_t start_offset,
         Task_list[i].function = function;
         Task_list[i].period = period;
         Task_list[i].start_offset = start_offset;
-        Task_list[i].count = (uint32_t)-1;
         Task_list[i].deadline = deadline;
+#ifdef FATE_ADMISSION
+        Task_list[i].wcet = wcet;
+        Task_list[i].interarrival = 0;
+        if((period == 0) || !task_set_schedulable())
+        {
+            Task_list[i].state = TASK_UNDEFINED;
+            return 2;
+        }
+#endif
+        //First released on the tick after the start offset expires
+        timer_insert(&release_queue, &(Task_list[i].release_timer), start_offset + 1);
         return 0;
     }
     return 1;
@@ -153,25 +660,46 @@ uint8_t Task_add(intptr_t function, uint32_t period, uint32_t start_offset,
  *
  *  Supported events are in "fate.h", defined in "enum events"
  */
+#ifdef FATE_ADMISSION
+uint8_t Task_event_add(intptr_t function, enum events event, uint32_t deadline,
+                       uint32_t wcet, uint32_t interarrival)
+#else
 uint8_t Task_event_add(intptr_t function, enum events event, uint32_t deadline)
+#endif
 {
-    int i;
+    int i, e;
+    
+    //Each event activates one task
+    if(((uint32_t)event >= EVENT_SOURCES) || event_slot[event])
+        return 1;
+    for(e = 0; (e<NUM_EVENTS) && Event_task_list[e].task; e++);
     for(i = 1; (i<NUM_TASKS) && (Task_list[i].state != TASK_UNDEFINED); i++);
-    if (i < NUM_TASKS)
+    if ((i < NUM_TASKS) && (e < NUM_EVENTS))
     {
         Task_list[i].state = TASK_STOPPED;
         Task_list[i].function = function;
-        //For aperiodic tasks: period set as 0
+        //For aperiodic tasks: period set as 0 (never in the release queue)
         Task_list[i].period = 0;
-        //For aperiodic tasks, set count as 1 (so the periodic scheduler never schedules it)
-        Task_list[i].count = 1;
+        Task_list[i].start_offset = 0;
         Task_list[i].deadline = deadline;
+#ifdef FATE_ADMISSION
+        Task_list[i].wcet = wcet;
+        Task_list[i].interarrival = interarrival;
+        if((interarrival == 0) || !task_set_schedulable())
+        {
+            Task_list[i].state = TASK_UNDEFINED;
+            return 2;
+        }
+#endif
         
         //Configure Device and Interrupt for corresponding event
         Enable_event(event);
         
         //Set pointer to newly configured task in event-task list
-        Event_task_list[event] = &(Task_list[i]);
+        Event_task_list[e].task = &(Task_list[i]);
+        Event_task_list[e].source = (uint8_t)event;
+        Task_list[i].event = &(Event_task_list[e]);
+        event_slot[event] = (uint8_t)(e + 1);
         
         return 0;
     }
@@ -185,177 +713,788 @@ uint8_t Task_event_add(intptr_t function, enum events event, uint32_t deadline)
  */
 void Enable_event(enum events event)
 {
-    switch(event)
+    const port_regs *port;
+    uint8_t bit;
+    
+    //Software events need no configuration
+    if(event >= EVENT_SOFTWARE(0))
+        return;
+    
+    port = &(ports[event / 8]);
+    bit = (uint8_t)(1 << (event % 8));
+    
+    //Configure Pin as GPIO
+    *port->sel0 &= (uint8_t)(~bit);
+    *port->sel1 &= (uint8_t)(~bit);
+    //Configure Pin as input
+    *port->dir &= (uint8_t)(~bit);
+    //Enable internal resistors
+    *port->ren |= bit;
+    //Configure pull-up resistors
+    *port->out |= bit;
+    //Configure negative edge (active low switches)
+    *port->ies |= bit;
+    //Changing the edge may set the flag: clear it, then enable pin interrupt
+    *port->ifg &= (uint8_t)(~bit);
+    *port->ie |= bit;
+    
+    //Enable Port interrupt in NVIC
+    //Equal priority as timer interrupt
+    //We don't want anything interrupting our scheduler
+    //since we are manipulating the task lists, bad things could happen
+    //also, scheduler has to be precise, or we drift out of time
+    NVIC_EnableIRQ((IRQn_Type)(PORT1_IRQn + event / 8));
+    NVIC_SetPriority((IRQn_Type)(PORT1_IRQn + event / 8), 2);
+}
+
+
+/**
+ *  Marks an active task's deadline as passed (the job carries on, ahead of the others)
+ */
+static inline void expire_deadline(task_ctrl_blk *task)
+{
+    expired_tasks |= (uint32_t)0x80000000 >> (task - Task_list);
+}
+
+/**
+ *  Releases a task: sets it as SUSPENDED (active) if it was STOPPED,
+ *  with a deadline relative to the tick the release was due on.
+ *  "late" is the number of system ticks since the release was due.
+ *  The release is skipped if the task is still active, or if its last job
+ *  overran with OVERRUN_SKIP.
+ */
+static void release_task(task_ctrl_blk *task, uint32_t now, uint32_t late)
+{
+    uint8_t skip = task->skip_release;
+    
+    task->skip_release = 0;
+    if((task->state != TASK_STOPPED) || skip)
     {
-        case SWITCH_P1_1:
-        {
-            //Configure Pin as GPIO
-            P1SEL0 &= (uint8_t)(~BIT1);
-            P1SEL1 &= (uint8_t)(~BIT1);
-            //Configure Pin as input
-            P1DIR &= (uint8_t)(~BIT1);
-            //Enable internal resistors
-            P1REN |= (uint8_t)BIT1;
-            //Configure pull-up resistors
-            P1OUT |= (uint8_t)BIT1;
-            //Enable pin interrupt
-            P1IE |= (uint8_t)BIT1;
-            //Configure negative edge (active low switches)
-            P1IES |= (uint8_t)BIT1;
-            
-            //Enable Port interrupt in NVIC
-            //Equal priority as timer interrupt
-            //We don't want anything interrupting our scheduler
-            //since we are manipulating stack, bad things could happen
-            //also, scheduler has to be precise, or we drift out of time
-            NVIC_EnableIRQ(PORT1_IRQn);
-            NVIC_SetPriority(PORT1_IRQn, 2);
-            
+        TRACE(TRACE_RELEASE, task, 1);
+        return;
+    }
+    TRACE(TRACE_RELEASE, task, 0);
+    task->state = TASK_SUSPENDED;
+    //A new job starts from the beginning of the task function
+    task->sp = (uint32_t *)0;
+    task->absolute_deadline = now - late + task->deadline;
+    if(task->deadline > late)
+        ready_insert(task);
+    else
+        deadline_missed(task);
+}
+
+/**
+ *  Starts a new job of an aperiodic task (the scheduler runs right after the event ISR),
+ *  with a deadline relative to "activated", the tick the event happened on
+ */
+static void activate_task(task_ctrl_blk *task, uint32_t activated)
+{
+    task->state = TASK_SUSPENDED;
+    //A new job starts from the beginning of the task function
+    task->sp = (uint32_t *)0;
+    task->absolute_deadline = activated + task->deadline;
+    if(deadline_reached(task->absolute_deadline, current_tick()))
+        deadline_missed(task);
+    else
+        ready_insert(task);
+}
+
+/**
+ *  Handles an active job that has reached its deadline (and has left "ready_heap"):
+ *  counts the miss, calls the miss handler, and applies the task's overrun policy
+ */
+static void deadline_missed(task_ctrl_blk *task)
+{
+    TRACE(TRACE_DEADLINE_MISS, task, task->overrun);
+    task->misses++;
+    if(miss_handler)
+        miss_handler(task->function);
+    
+    switch(task->overrun)
+    {
+        case OVERRUN_ABORT:
+            //Dropped as if it had stopped itself (if it is on the CPU, the scheduler
+            //switches away and "switch_context" discards its context)
+            task->state = TASK_STOPPED;
+            if(task->event)
+                event_served(task->event);
             break;
+        case OVERRUN_SKIP:
+            task->skip_release = 1;
+            expire_deadline(task);
+            break;
+        default:
+            //Carries on, ahead of every job that can still meet its deadline
+            expire_deadline(task);
+            break;
+    }
+}
+
+/**
+ *  Removes a task that stopped itself from the EDF ordering
+ */
+static void retire_task(task_ctrl_blk *task)
+{
+    uint32_t bit = (uint32_t)0x80000000 >> (task - Task_list);
+    
+    if(expired_tasks & bit)
+        expired_tasks &= ~bit;
+    else
+        ready_remove(task);
+}
+
+#ifdef FATE_TRACE
+/**
+ *  Traces "ticks" elapsed system ticks, added to those since the last
+ *  TRACE_TICK record, as one record, but only if a release or a deadline falls
+ *  due in them: a record of every tick would crowd the rest out of the ring buffer
+ */
+static void trace_tick(uint32_t ticks)
+{
+    uint8_t due = (release_queue && (release_queue->delta <= ticks)) ||
+                  (ready_count && deadline_reached(ready_heap[0]->absolute_deadline, tick_count + ticks));
+    
+    trace_ticks += ticks;
+    if(!due)
+        return;
+    TRACE(TRACE_TICK, Task_list, (trace_ticks > 0xFFFF) ? 0xFFFF : trace_ticks);
+    trace_ticks = 0;
+}
+#endif
+
+/**
+ *  Brings every task up to date after "ticks" system ticks have elapsed
+ *
+ *  Only the release and deadline events that fall due are touched: jobs still active
+ *  at their deadline leave the top of "ready_heap" as misses, and due tasks are
+ *  released and queued again one period later.
+ */
+static void advance_ticks(uint32_t ticks)
+{
+    timer_node *node, *next;
+    task_ctrl_blk *task;
+    uint32_t now = tick_count + ticks;
+    
+    while(ready_count && deadline_reached(ready_heap[0]->absolute_deadline, now))
+    {
+        task = ready_heap[0];
+        ready_remove(task);
+        deadline_missed(task);
+    }
+    
+    for(node = timer_expire(&release_queue, ticks); node; node = next)
+    {
+        next = node->next;
+        task = node->task;
+        release_task(task, now, node->delta);
+        //Queue the next release, one period after this one was due
+        timer_insert(&release_queue, node, task->period - (node->delta % task->period));
+    }
+    
+    tick_count = now;
+}
+
+/**
+ *  Current time in system ticks
+ *  (running tickless, the current Timer A0 period may span several ticks)
+ */
+static uint32_t current_tick(void)
+{
+    uint16_t count;
+    
+    //Timer is clocked asynchronously: read until two consecutive reads agree
+    do {
+        count = TA0R;
+    } while(count != TA0R);
+    
+    //Rolled over already, but the tick ISR has not run yet
+    if(TA0CTL & BIT0)
+        return tick_count + sleep_ticks;
+    return tick_count + count / (TICK_COUNTS + 1);
+}
+
+/**
+ *  Records an activation of an event's task: starts a job if the task is not active,
+ *  otherwise queues the activation until the jobs before it are served
+ */
+static void event_activate(event_ctrl_blk *event)
+{
+    if(event->pending == EVENT_QUEUE_SIZE)
+    {
+        TRACE(TRACE_EVENT_LOST, event->task, event->source);
+        event->lost++;
+        return;
+    }
+    TRACE(TRACE_EVENT, event->task, event->source);
+    event->timestamp[(event->head + event->pending) % EVENT_QUEUE_SIZE] = current_tick();
+    if(!event->pending++)
+        activate_task(event->task, event->timestamp[event->head]);
+}
+
+/**
+ *  Called when a job of an aperiodic task stops: the next pending activation,
+ *  if any, starts a new job right away
+ */
+static void event_served(event_ctrl_blk *event)
+{
+    event->head = (uint8_t)((event->head + 1) % EVENT_QUEUE_SIZE);
+    if(--event->pending)
+        activate_task(event->task, event->timestamp[event->head]);
+}
+
+/**
+ *  Activates the task attached to an event, if any, and runs the scheduler
+ *  right away (tail-chained to the calling ISR)
+ *  Must be called with the scheduler's interrupt priority.
+ */
+static void event_raise(uint32_t event)
+{
+    uint8_t slot = event_slot[event];
+    
+    if(slot)
+    {
+        event_activate(&(Event_task_list[slot - 1]));
+        NVIC_SetPendingIRQ(TA0_N_IRQn);
+    }
+}
+
+/**
+ *  Raises an event from any context (see "fate.h")
+ */
+void Event_signal(enum events event)
+{
+    uint32_t primask;
+    
+    if((uint32_t)event >= EVENT_SOURCES)
+        return;
+    //Keep the scheduler out while the event is recorded
+    primask = __get_PRIMASK();
+    __disable_irq();
+    event_raise(event);
+    __set_PRIMASK(primask);
+}
+
+/**
+ *  Called by an aperiodic task to get the time of the activation it is serving
+ */
+uint32_t Task_event_time(enum events event)
+{
+    event_ctrl_blk *entry;
+    
+    if(((uint32_t)event >= EVENT_SOURCES) || !event_slot[event])
+        return 0;
+    entry = &(Event_task_list[event_slot[event] - 1]);
+    return entry->timestamp[entry->head];
+}
+
+/**
+ *  Sets a task's overrun policy (see "fate.h")
+ */
+uint8_t Task_set_overrun(intptr_t function, enum overrun_policy policy)
+{
+    int i;
+    
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        if((Task_list[i].state != TASK_UNDEFINED) && (Task_list[i].function == function))
+        {
+            Task_list[i].overrun = policy;
+            return 0;
         }
-        case SWITCH_P1_4:
+    }
+    return 1;
+}
+
+/**
+ *  Gets a task's deadline miss count (see "fate.h")
+ */
+uint32_t Task_get_misses(intptr_t function)
+{
+    int i;
+    
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        if((Task_list[i].state != TASK_UNDEFINED) && (Task_list[i].function == function))
+            return Task_list[i].misses;
+    }
+    return 0;
+}
+
+/**
+ *  Sets the deadline miss handler (see "fate.h")
+ */
+void Task_set_miss_handler(void (*handler)(intptr_t function))
+{
+    miss_handler = handler;
+}
+
+#ifdef FATE_TICKLESS
+/**
+ *  Number of system ticks until the next event that may change scheduling decisions:
+ *  a release (including the first one, after "start_offset"), or the earliest deadline
+ *  of an active task passing.
+ *  Never more than one Timer A0 period can hold.
+ *  (An aperiodic job activated during a long sleep may have an earlier deadline:
+ *  a miss is then noticed when the timer next rolls over.)
+ */
+static uint32_t next_event_ticks(void)
+{
+    uint32_t next = MAX_SLEEP_TICKS;
+    
+    if(release_queue && (release_queue->delta < next))
+        next = release_queue->delta;
+    //Deadlines still ahead (the ones that passed have left "ready_heap")
+    if(ready_count && (ready_heap[0]->absolute_deadline - tick_count < next))
+        next = ready_heap[0]->absolute_deadline - tick_count;
+    return next;
+}
+
+/**
+ *  Programs Timer A0 to interrupt at the next event, instead of the next tick
+ *  Called right after the timer rolls over, so the new period starts now.
+ */
+static void program_next_event(void)
+{
+    sleep_ticks = next_event_ticks();
+    TA0CCR0 = (uint16_t)(sleep_ticks * (TICK_COUNTS + 1) - 1);
+}
+#endif
+
+/**
+ *  Returning from a task function stops the task
+ */
+static void task_return(void)
+{
+    Task_stop(running_task->function);
+}
+
+/**
+ *  Builds the initial context of a new job at the top of the task's stack,
+ *  and returns the stack pointer PendSV restores it from
+ */
+static uint32_t *init_stack(task_ctrl_blk *task)
+{
+#if defined(FATE_SIM)
+    //Host simulation: the simulator builds a thread context instead
+    return (uint32_t *)sim_init_stack((uintptr_t)task->stack,
+                                      (void (*)(void))task->function, task_return);
+#else
+    uint32_t *sp = task->stack;
+    
+    //Exception frame, as if the task had been interrupted right at its entry point
+    *(--sp) = 0x01000000;                       //xPSR (Thumb state)
+    *(--sp) = (uint32_t)task->function & ~1u;   //PC
+    *(--sp) = (uint32_t)task_return;            //LR: returning stops the task
+    sp -= 5;                                    //R12, R3-R0
+    //Registers saved by PendSV: EXC_RETURN (thread mode, PSP, no FPU state), R11-R4
+    *(--sp) = 0xFFFFFFFD;
+    sp -= 8;
+    return sp;
+#endif
+}
+
+/**
+ *  Fixed execution time tasks (see "main.c") measure their execution time with
+ *  Timer A1-A3: the timers a task leaves counting must not count while it is switched out.
+ *  Stops them, and returns their modes (Timer An in bits 2n-1:2n-2).
+ */
+static uint8_t pause_exec_timers(void)
+{
+    uint8_t modes = (uint8_t)(((TA1CTL & TIMER_A_CTL_MC_MASK) >> 4) |
+                              ((TA2CTL & TIMER_A_CTL_MC_MASK) >> 2) |
+                              (TA3CTL & TIMER_A_CTL_MC_MASK));
+    
+    if(modes)
+    {
+        TA1CTL &= (uint16_t)~(TIMER_A_CTL_MC_MASK);
+        TA2CTL &= (uint16_t)~(TIMER_A_CTL_MC_MASK);
+        TA3CTL &= (uint16_t)~(TIMER_A_CTL_MC_MASK);
+    }
+    return modes;
+}
+
+/**
+ *  Restarts the timers "pause_exec_timers" stopped
+ */
+static void resume_exec_timers(uint8_t modes)
+{
+    if(modes & 0x03)
+        TA1CTL |= (uint16_t)((modes << 4) & TIMER_A_CTL_MC_MASK);
+    if(modes & 0x0C)
+        TA2CTL |= (uint16_t)((modes << 2) & TIMER_A_CTL_MC_MASK);
+    if(modes & 0x30)
+        TA3CTL |= (uint16_t)(modes & TIMER_A_CTL_MC_MASK);
+}
+
+#ifdef FATE_PROFILE
+/**
+ *  Charges the cycles since the last context switch to the job of "running_task",
+ *  and adds the job to the task's statistics if it is over
+ *  (any switch out of the idle task ends a stretch of idle time)
+ */
+static void profile_switch_out(uint8_t job_over)
+{
+    task_profile *profile = &(running_task->profile);
+    uint32_t now = DWT->CYCCNT;
+    
+    profile->current += now - switched_in;
+    switched_in = now;
+    
+    if(job_over || (running_task == Task_list))
+    {
+        profile->jobs++;
+        if(profile->current > profile->wcet)
+            profile->wcet = profile->current;
+        if(profile->current < profile->bcet)
+            profile->bcet = profile->current;
+        profile->total += profile->current;
+        profile->current = 0;
+    }
+}
+
+/**
+ *  Copies the statistics of a task (see "fate.h")
+ */
+uint8_t Task_get_profile(intptr_t function, task_profile *profile)
+{
+    uint32_t primask;
+    int i;
+    
+    for(i=0;i<NUM_TASKS;i++)
+    {
+        if((Task_list[i].state != TASK_UNDEFINED) && (Task_list[i].function == function))
         {
-            //Configure Pin as GPIO
-            P1SEL0 &= (uint8_t)(~BIT4);
-            P1SEL1 &= (uint8_t)(~BIT4);
-            //Configure Pin as input
-            P1DIR &= (uint8_t)(~BIT4);
-            //Enable internal resistors
-            P1REN |= (uint8_t)BIT4;
-            //Configure pull-up resistors
-            P1OUT |= (uint8_t)BIT4;
-            //Enable pin interrupt
-            P1IE |= (uint8_t)BIT4;
-            //Configure negative edge (active low switches)
-            P1IES |= (uint8_t)BIT4;
-            
-            //Enable Port interrupt in NVIC
-            //Equal priority as timer interrupt
-            //We don't want anything interrupting our scheduler
-            //since we are manipulating stack, bad things could happen
-            //also, scheduler has to be precise, or we drift out of time
-            NVIC_EnableIRQ(PORT1_IRQn);
-            NVIC_SetPriority(PORT1_IRQn, 2);
-            
-            break;
+            //Consistent copy: context switches update the statistics
+            primask = __get_PRIMASK();
+            __disable_irq();
+            *profile = Task_list[i].profile;
+            __set_PRIMASK(primask);
+            profile->avg = profile->jobs ? (uint32_t)(profile->total / profile->jobs) : 0;
+            return 0;
         }
-        default: break;//do nothing, wrong event
     }
+    return 1;
 }
 
+/**
+ *  Clears the statistics of every task (see "fate.h")
+ */
+void Task_reset_profiles(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    int i;
+    
+    __disable_irq();
+    for(i=0;i<NUM_TASKS;i++)
+    {
+        Task_list[i].profile.jobs = 0;
+        Task_list[i].profile.wcet = 0;
+        Task_list[i].profile.bcet = UINT32_MAX;
+        Task_list[i].profile.avg = 0;
+        Task_list[i].profile.total = 0;
+        Task_list[i].profile.current = 0;
+    }
+    __set_PRIMASK(primask);
+}
+#endif
 
 /**
- *  Encapsulates inline assembly to get current value of Stack Pointer
- *  Used in Timer ISR (system tick) to access the stack and manipulate the return address,
- *  so we return to the task we want
+ *  Called by PendSV with the stack pointer of the task that was running,
+ *  after its registers are saved on its stack.
+ *  Returns the stack pointer of "current_task", whose registers PendSV restores.
  */
-__inline intptr_t get_current_SP(void)
+uint32_t *switch_context(uint32_t *sp)
 {
-#ifdef __ARMCC_VERSION
-    // Keil uVision
-    intptr_t spReg;
-    __asm {
-        MOV spReg, __current_sp()
+#ifdef FATE_BENCH
+    uint32_t bench_start = BENCH_CLOCK();
+#endif
+    uint8_t modes = pause_exec_timers();
+    //Is the job of the task that was running over?
+    //(it stopped, or was released again and starts afresh)
+    uint8_t job_over = (running_task->state == TASK_STOPPED) || !running_task->sp;
+    
+#ifdef FATE_PROFILE
+    profile_switch_out(job_over);
+#endif
+    
+    //Keep the context of the task that was running, unless its job is over
+    if(!job_over)
+    {
+        running_task->sp = sp;
+        running_task->exec_timers = modes;
+    }
+    
+    TRACE(TRACE_SWITCH, current_task, running_task - Task_list);
+    running_task = current_task;
+    if(!running_task->sp)
+    {
+        running_task->sp = init_stack(running_task);
+        running_task->exec_timers = 0;
     }
+    resume_exec_timers(running_task->exec_timers);
+#ifdef FATE_BENCH
+    bench_record(BENCH_SWITCH, BENCH_CLOCK() - bench_start);
+#endif
+    return running_task->sp;
+}
+
+/**
+ *  PendSV: switches context
+ *  Lowest priority interrupt, so it only runs once the scheduler (and any other
+ *  interrupt) is done: saves the registers of the running task on its stack
+ *  (the process stack), and restores those of "current_task" from its own.
+ */
+#if defined(FATE_SIM)
+void PendSV_Handler(void)
+{
+    //Host simulation: the process stack pointer is a handle to a thread context,
+    //which the simulator saves and restores around this handler
+    __set_PSP((uintptr_t)switch_context((uint32_t *)__get_PSP()));
+}
+#elif defined(__ARMCC_VERSION)
+__asm void PendSV_Handler(void)
+{
+    IMPORT switch_context
+    PRESERVE8
+    
+    CPSID   I
+    MRS     r0, psp
+#if (__FPU_USED == 1)
+    //Lazily stacked FPU context: save the callee-saved FPU registers too
+    TST     lr, #0x10
+    IT      EQ
+    VSTMDBEQ r0!, {s16-s31}
+#endif
+    STMDB   r0!, {r4-r11, lr}
+    BL      switch_context
+    LDMIA   r0!, {r4-r11, lr}
+#if (__FPU_USED == 1)
+    TST     lr, #0x10
+    IT      EQ
+    VLDMIAEQ r0!, {s16-s31}
+#endif
+    MSR     psp, r0
+    CPSIE   I
+    BX      lr
+}
 #elif defined(__GNUC__)
-    // GCC
-    register intptr_t spReg;
+__attribute__((naked)) void PendSV_Handler(void)
+{
+    __ASM volatile (
+        "    CPSID   I                   \n"
+        "    MRS     r0, psp             \n"
+#if (__FPU_USED == 1)
+        //Lazily stacked FPU context: save the callee-saved FPU registers too
+        "    TST     lr, #0x10           \n"
+        "    IT      EQ                  \n"
+        "    VSTMDBEQ r0!, {s16-s31}     \n"
+#endif
+        "    STMDB   r0!, {r4-r11, lr}   \n"
+        "    BL      switch_context      \n"
+        "    LDMIA   r0!, {r4-r11, lr}   \n"
+#if (__FPU_USED == 1)
+        "    TST     lr, #0x10           \n"
+        "    IT      EQ                  \n"
+        "    VLDMIAEQ r0!, {s16-s31}     \n"
+#endif
+        "    MSR     psp, r0             \n"
+        "    CPSIE   I                   \n"
+        "    BX      lr                  \n"
+    );
+}
+#endif
+
+/**
+ *  Called by each task when it finishes execution (see "fate.h")
+ */
+void Task_stop(intptr_t function)
+{
+    int i;
+#ifdef FATE_BENCH
+    uint32_t bench_start = BENCH_CLOCK();
+#endif
+    
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        if(Task_list[i].function == function)
+        {
+            TRACE(TRACE_STOP, &(Task_list[i]), 0);
+            Task_list[i].state = TASK_STOPPED;
+#ifdef FATE_BENCH
+            bench_record(BENCH_STOP, BENCH_CLOCK() - bench_start);
+#endif
+            NVIC_SetPendingIRQ(TA0_N_IRQn);
+            //The scheduler switches away from this job for good
+            while(1);
+        }
+    }
+}
+
+#ifdef FATE_BENCH
+/**
+ *  Copies the measurements of a scheduler path (see "fate.h")
+ */
+uint8_t Bench_get(enum bench_path path, uint32_t active, bench_stat *stat)
+{
+    if((path >= NUM_BENCH_PATHS) || (active >= NUM_TASKS))
+        return 1;
+    *stat = bench_stats[path][active];
+    return 0;
+}
+
+void Bench_reset(void)
+{
+    int path, i;
+    uint32_t start;
+    
+    for(path=0;path<NUM_BENCH_PATHS;path++)
+    {
+        for(i=0;i<NUM_TASKS;i++)
+        {
+            bench_stats[path][i].count = 0;
+            bench_stats[path][i].min = 0xFFFFFFFF;
+            bench_stats[path][i].max = 0;
+            bench_stats[path][i].total = 0;
+        }
+    }
+    
+    //Shortest of a few back to back reads
+    bench_overhead = 0xFFFFFFFF;
+    for(i=0;i<8;i++)
+    {
+        start = BENCH_CLOCK();
+        start = BENCH_CLOCK() - start;
+        if(start < bench_overhead)
+            bench_overhead = start;
+    }
+}
+#endif
+
+#ifdef FATE_TRACE
+/**
+ *  Takes the oldest complete record out of the trace ring buffer (see "fate.h")
+ */
+uint8_t Trace_read(trace_record *record)
+{
+    volatile trace_record *oldest = &(trace_buffer[trace_tail % TRACE_SIZE]);
     
-    __ASM volatile ("MRS %0, msp\n" : "=r" (spReg) );
+    //Empty, or the oldest record is claimed but not written yet
+    if((trace_tail == trace_head) || (oldest->type == TRACE_EMPTY))
+        return 0;
+    record->timestamp = oldest->timestamp;
+    record->type = oldest->type;
+    record->task = oldest->task;
+    record->arg = oldest->arg;
+    oldest->type = TRACE_EMPTY;
+    trace_tail++;
+    return 1;
+}
+
+uint32_t Trace_dropped(void)
+{
+    return trace_dropped;
+}
+
+/**
+ *  Writes a word to the trace ITM stimulus port
+ */
+static void trace_send(uint32_t word)
+{
+#if defined(FATE_SIM)
+    sim_itm_write(TRACE_ITM_PORT, word);
+#else
+    //Wait for the port's FIFO
+    while(ITM->PORT[TRACE_ITM_PORT].u32 == 0);
+    ITM->PORT[TRACE_ITM_PORT].u32 = word;
 #endif
-    return spReg;
 }
 
+/**
+ *  Called by the idle task: sends the trace to ITM, if a debugger enabled the port
+ *  (otherwise the records stay in the ring buffer, for "Trace_read")
+ */
+static void trace_drain(void)
+{
+    trace_record record;
+    uint32_t dropped;
+    
+    if(!(ITM->TCR & ITM_TCR_ITMENA_Msk) || !(ITM->TER & (1UL << TRACE_ITM_PORT)))
+        return;
+    while(Trace_read(&record))
+    {
+        trace_send(record.timestamp);
+        trace_send((uint32_t)record.type | ((uint32_t)record.task << 8) | ((uint32_t)record.arg << 16));
+    }
+    //Records were lost after those sent (the buffer was full): say how many
+    dropped = trace_dropped - trace_reported;
+    if(dropped)
+    {
+        if(dropped > 0xFFFF)
+            dropped = 0xFFFF;
+        trace_reported += dropped;
+        trace_send(DWT->CYCCNT);
+        trace_send((uint32_t)TRACE_DROPPED | (dropped << 16));
+    }
+}
+#endif
+
 /**
  *  Main scheduler implementation
  *
- *  Occurs every 10ms
+ *  Occurs every 10ms (or at the next event, if running tickless),
+ *  whenever a task stops, and whenever an event activates a task
  *
- *  Updates "count" in every task so we keep track of time
- *  Based on highest priority currently active task, manipulates stack to change return address
- *  (so we return from ISR to the task we want to run) and updates information in
- *  pointer to current task and Task_list.
+ *  Updates task releases and deadlines so we keep track of time
+ *  Based on highest priority currently active task, updates information in
+ *  pointer to current task and Task_list, and pends PendSV to switch context to it.
  */
 void TA0_N_IRQHandler()
 {
-    intptr_t sp_p;
-    int i;
     task_ctrl_blk *new_task;
+#ifdef FATE_BENCH
+    uint32_t bench_start = BENCH_CLOCK();
+    uint32_t bench_priority;
+    enum bench_path bench_path = (TA0CTL & BIT0) ? BENCH_TICK : BENCH_RESCHEDULE;
+#endif
     
-    
-#ifdef __ARMCC_VERSION
-    //Value of current stack pointer
-    sp_p = get_current_SP();
-    //Find Exception code: basically makes sp_p point to base of current stack frame - 4
-    while((*((intptr_t *)sp_p)) != (intptr_t)0xFFFFFFE9)
-        sp_p += (intptr_t)4;
-#elif defined(__GNUC__)
-    // Ignore warning for casting result of __builtin_frame_address to an integer type
-#pragma GCC diagnostic ignored "-Wbad-function-cast"
-    //Value of current stack pointer
-    sp_p = (intptr_t)__builtin_frame_address(0);
-    // Stop ignoring warnings about casting results of functions to the wrong type
-#pragma GCC diagnostic pop
-    while((*((intptr_t *)sp_p)) != (intptr_t)0xFFFFFFF9)
-        sp_p += 4;
-#endif
-    //Now that we are pointing to base of current stack frame, increment by 0x1C
-    //so we are pointing at Return Address
-    sp_p += 0x1C;
+    //Has the current task stopped itself?
+    if(current_task->state == TASK_STOPPED)
+    {
+        retire_task(current_task);
+        //Aperiodic task: serve the next pending activation
+        if(current_task->event)
+            event_served(current_task->event);
+    }
     
     // If the timer has overflowed we need to update all of our counters
-    if (TA0CTL & (uint16_t)(~(BIT0))) {
-        //Increment "count" on all tasks, modulo task period
-        //Set task as SUSPENDED (active) if it was STOPPED
-        //and count is back to 0 (matched period)
-        for(i=1;i<8;i++)
-        {
-            // If the start offset has not expired, decrement it
-            if (Task_list[i].start_offset > 0)
-            {
-                Task_list[i].start_offset--;
-            }
-            //Don't increment count if task is aperiodic (period == 0)
-            else if(Task_list[i].period)
-            {
-                Task_list[i].count++;
-                Task_list[i].count %= Task_list[i].period;
-            }
-            if(Task_list[i].count == 0)
-            {
-                if(Task_list[i].state == TASK_STOPPED)
-                {
-                    Task_list[i].state = TASK_SUSPENDED;
-                    // As task becomes ready it's deadline begins to near
-                    Task_list[i].deadline_remaining = Task_list[i].deadline;
-                }
-            }
-            // If task is running or suspended, it's deadline is gettting closer
-            if ((Task_list[i].state == TASK_SUSPENDED) || (Task_list[i].state == TASK_RUNNING))
-            {
-                // Cap deadline remaining at 0 so that it doesn't wrap
-                if (Task_list[i].deadline_remaining > 0)
-                {
-                    Task_list[i].deadline_remaining--;
-                }
-            }
-        }
+    if (TA0CTL & BIT0) {
+#ifdef FATE_TRACE
+        trace_tick(sleep_ticks);
+#endif
+        advance_ticks(sleep_ticks);
         
         //clear Timer interrupt flag
         TA0CTL &= (uint16_t)(~(BIT0));
+        
+#ifdef FATE_TICKLESS
+        //Sleep until the next event
+        program_next_event();
+#endif
     }
     
     //Get pointer to highest priority active (running or suspended) task
+#ifdef FATE_BENCH
+    bench_priority = BENCH_CLOCK();
+    new_task = get_priority_task();
+    bench_priority = BENCH_CLOCK() - bench_priority;
+#else
     new_task = get_priority_task();
+#endif
     
     //Is the current highest priority active task not the currently running task?
     if(new_task != current_task)
     {
-        // Stop all of the task timers for fixed execution time tasks
-        TA1CTL &= ~(TIMER_A_CTL_MC_MASK);
-        TA2CTL &= ~(TIMER_A_CTL_MC_MASK);
-        TA3CTL &= ~(TIMER_A_CTL_MC_MASK);
-        
         //Yes, it is
         //Set current task to "suspended", if it is "running"; it might have stopped itself
         if(current_task->state == TASK_RUNNING)
@@ -364,8 +1503,6 @@ void TA0_N_IRQHandler()
         new_task->state = TASK_RUNNING;
         //Update current task pointer
         current_task = new_task;
-        //Return to new task by changing return address
-        *((intptr_t *)sp_p) = current_task->function;
     }
     else
     {
@@ -376,41 +1513,47 @@ void TA0_N_IRQHandler()
             //Yes: go back to idle task
             current_task = &(Task_list[0]);
             current_task->state = TASK_RUNNING;
-            *((intptr_t *)sp_p) = current_task->function;
         }
         //No, current task is not finished
         //Return to same task (do nothing)
     }
+    
+    //Switch context, unless we return to the job that is already on the CPU
+    //(a new job starts afresh, even if the task that just stopped is released again)
+    if((current_task != running_task) || !current_task->sp)
+        SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+    
+#ifdef FATE_BENCH
+    //Not counting the time taken to measure "get_priority_task"
+    bench_record(bench_path, BENCH_CLOCK() - bench_start - bench_overhead);
+    bench_record(BENCH_PRIORITY, bench_priority);
+#endif
 }
 
-/*
- Port 1 Interrupt handler
- Processes events for aperiodic tasks
+/**
+ *  Port interrupt handlers
+ *  Process events for aperiodic tasks
+ *
+ *  Each read of PxIV returns the lowest pending pin as 2 * (pin + 1), 0 if none,
+ *  and clears its flag: an event costs one register read and one table lookup,
+ *  however many pins are configured.
  */
-void PORT1_IRQHandler(void)
-{
-    if(P1IFG & BIT1)
-    {
-        P1IFG &= (uint8_t)(~BIT1);
-        //If corresponding event-task is initialized
-        if(Event_task_list[SWITCH_P1_1])
-        {
-            //Activate task (schedule will eventually run it)
-            Event_task_list[SWITCH_P1_1]->state = TASK_SUSPENDED;
-        }
-    }
-    if(P1IFG & BIT4)
-    {
-        P1IFG &= (uint8_t)(~BIT4);
-        //If corresponding event-task is initialized
-        if(Event_task_list[SWITCH_P1_4])
-        {
-            //Activate task (schedule will eventually run it)
-            Event_task_list[SWITCH_P1_4]->state = TASK_SUSPENDED;
-        }
-    }
+#define PORT_IRQ_HANDLER(n)                                             \
+void PORT##n##_IRQHandler(void)                                         \
+{                                                                       \
+    uint16_t iv;                                                        \
+                                                                        \
+    while((iv = P##n##IV) != 0)                                         \
+        event_raise((uint32_t)EVENT_PORT_PIN(n, 0) + (iv >> 1) - 1);    \
 }
 
+PORT_IRQ_HANDLER(1)
+PORT_IRQ_HANDLER(2)
+PORT_IRQ_HANDLER(3)
+PORT_IRQ_HANDLER(4)
+PORT_IRQ_HANDLER(5)
+PORT_IRQ_HANDLER(6)
+
 /*
  Configures Timer for system tick, NVIC and CPU interrupts,
  and starts the idle task
@@ -419,7 +1562,11 @@ void Task_schedule(void)
 {
     //configure timer
     TA0CTL |= (uint16_t)(BIT8); //ACLK
-    TA0CCR0 = (uint16_t)328; //10ms
+#ifdef FATE_TICKLESS
+    program_next_event();
+#else
+    TA0CCR0 = (uint16_t)TICK_COUNTS; //10ms
+#endif
     TA0CTL |= (uint16_t)BIT1; //interrupt enable
     TA0CTL |= (uint16_t)BIT4; //UP MODE
     
@@ -427,6 +1574,29 @@ void Task_schedule(void)
     NVIC_EnableIRQ(TA0_N_IRQn);
     NVIC_SetPriority(TA0_N_IRQn, 2);
     
+    //PendSV at the lowest priority: context switches wait for every other interrupt
+    NVIC_SetPriority(PendSV_IRQn, (1 << __NVIC_PRIO_BITS) - 1);
+    
+#if defined(FATE_PROFILE) || defined(FATE_TRACE) || defined(FATE_BENCH)
+    //Start the DWT cycle counter
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+#ifdef FATE_PROFILE
+    switched_in = 0;
+#endif
+#ifdef FATE_BENCH
+    Bench_reset();
+#endif
+    
+    //The idle task runs on its own stack too: switch thread mode to the process stack
+    Task_list[0].sp = Task_list[0].stack;
+    running_task = &(Task_list[0]);
+    __set_PSP((uintptr_t)Task_list[0].sp);
+    __set_CONTROL(0x02);
+    __ISB();
+    
     //enable CPU interrupts
     __ASM("CPSIE I");
     
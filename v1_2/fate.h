@@ -1,7 +1,7 @@
 /*****************************************************
 
 
-FATE_OS_H v1.1
+FATE_OS_H v1.2
 The "Fake Time Environment Operating System"
 
 Developed by 
@@ -23,6 +23,24 @@ Tasks cannot call other functions nor should they have local variables.
 V1.1:
 Added support for aperiodic tasks (port interrupt events only)
 
+V1.2:
+EDF scheduling, with start offsets and deadlines
+Optional tickless operation (FATE_TICKLESS)
+Releases and deadlines kept in delta queues (per-tick work only for due events)
+Context switching through PendSV, with a stack per task: preempted tasks resume
+where they left off, and may use local variables, call functions and return
+Events run the scheduler immediately, instead of at the next tick
+Aperiodic task activations are counted (and time stamped), so bursts are not lost
+Table-driven events: any pin of ports P1-P6, or software events (Event_signal)
+Optional execution time profiling with the DWT cycle counter (FATE_PROFILE)
+Optional scheduler trace, drained to ITM (FATE_TRACE)
+Optional scheduler cost measurement (FATE_BENCH)
+Optional admission control with the EDF processor demand test (FATE_ADMISSION)
+Deadline misses detected and counted per task, with an optional handler and
+an overrun policy per task (continue, abort the job, or skip the next release)
+Absolute deadlines, with active jobs in a binary heap in EDF order
+Aperiodic jobs get a deadline relative to their activation, instead of being most urgent
+
 ******************************************************/
 
 #ifndef FATE_OS_H
@@ -32,8 +50,74 @@ Added support for aperiodic tasks (port interrupt events only)
 #include <stdint.h>
 
 
+/** Size of "Task_list", idle task included (at most 32: "expired_tasks" holds one bit per task) */
+#ifndef NUM_TASKS
 #define NUM_TASKS 8
-#define NUM_EVENTS 2
+#endif
+
+/** Number of events that can have a task attached */
+#define NUM_EVENTS 8
+
+/** Number of software events (see "Event_signal") */
+#define NUM_SOFTWARE_EVENTS 8
+
+/** Timer A0 period for one system tick, in ACLK counts minus one (10ms) */
+#define TICK_COUNTS 328
+
+/** System tick length in microseconds, rounded down */
+#define TICK_US (((TICK_COUNTS) + 1) * 1000000UL / 32768)
+
+/**
+ *  Define to run tickless: instead of interrupting every tick, Timer A0 is
+ *  programmed to interrupt at the next release, start offset expiration or
+ *  deadline, and task events are caught up when it does.
+ */
+//#define FATE_TICKLESS
+
+/**
+ *  Define to measure the execution time of every job with the DWT cycle counter
+ *  (see "Task_get_profile").
+ */
+//#define FATE_PROFILE
+
+/**
+ *  Define to record scheduler activity (releases, events, context switches,
+ *  stops, deadline misses) in a ring buffer in RAM, time stamped with the DWT
+ *  cycle counter. The idle task drains it to ITM stimulus port "TRACE_ITM_PORT"
+ *  when a debugger enables the port; "host/fate_trace" decodes the stream.
+ */
+//#define FATE_TRACE
+
+/**
+ *  Define to measure the cost of the scheduler itself: the tick handler,
+ *  "get_priority_task", the context switch and "Task_stop" are timed with the
+ *  DWT cycle counter (host nanoseconds in the simulator), per number of
+ *  active tasks (see "Bench_get" and "bench.c").
+ */
+//#define FATE_BENCH
+
+/**
+ *  Define to check, whenever a task is added, that every job still meets its
+ *  deadline under EDF (processor demand test). "Task_add" and "Task_event_add"
+ *  then also take the task's worst case execution time, and "Task_event_add"
+ *  the minimum time between events, and reject the task if the test fails.
+ */
+//#define FATE_ADMISSION
+
+/** Number of records the trace ring buffer holds (power of 2) */
+#define TRACE_SIZE 256
+
+/** ITM stimulus port the trace is sent to */
+#define TRACE_ITM_PORT 1
+
+/** Longest sleep one Timer A0 period can hold, in system ticks */
+#define MAX_SLEEP_TICKS (65536 / (TICK_COUNTS + 1))
+
+/** Number of activations of an aperiodic task that can be pending (further ones are lost) */
+#define EVENT_QUEUE_SIZE 4
+
+/** Stack size of each task (including the idle task), in bytes (multiple of 8) */
+#define STACK_SIZE 512
 
 
 /** Definitions for different Task states. */
@@ -48,29 +132,220 @@ enum task_state {
     TASK_UNDEFINED
 };
 
-/** List of events that can be used to start aperiodic tasks */
+/** What happens to a job that is still active when its deadline passes */
+enum overrun_policy {
+    /** The job runs to completion, ahead of every job whose deadline has not passed */
+    OVERRUN_CONTINUE,
+    /** The job is dropped: the task stops until its next release (or pending activation) */
+    OVERRUN_ABORT,
+    /** The job runs to completion, and the task's next release is skipped to catch up */
+    OVERRUN_SKIP
+};
+
+/** Event of the active edge on a pin of ports P1-P6 */
+#define EVENT_PORT_PIN(port, pin) (((port) - 1) * 8 + (pin))
+
+/** Software event, raised by calling "Event_signal" (e.g. from a peripheral ISR) */
+#define EVENT_SOFTWARE(n) (EVENT_PORT_PIN(7, 0) + (n))
+
+/** Number of event sources: port pins, then software events */
+#define EVENT_SOURCES EVENT_SOFTWARE(NUM_SOFTWARE_EVENTS)
+
+/**
+ *  List of events that can be used to start aperiodic tasks
+ *  Any "EVENT_PORT_PIN" or "EVENT_SOFTWARE" can be used; these are the switches.
+ */
 enum events {
     /** Switch p1.1 */
-    SWITCH_P1_1,
+    SWITCH_P1_1 = EVENT_PORT_PIN(1, 1),
     /** Switch p1.4 */
-    SWITCH_P1_4
+    SWITCH_P1_4 = EVENT_PORT_PIN(1, 4)
 };
 
+/**
+ *  Entry of a delta queue, which keeps future task events in time order:
+ *  only the first entry has to be updated as time passes.
+ */
+typedef struct timer_node
+{
+    /** Next entry in the queue (expires at the same time or later) */
+    struct timer_node *next;
+    /** Number of system ticks between the previous entry's expiration and this one's */
+    uint32_t delta;
+    /** Task this entry belongs to */
+    struct task_ctrl_blk *task;
+}
+timer_node;
+
+/** Structure that holds information for each event */
+typedef struct event_ctrl_blk
+{
+    /** Task the event activates (0 if none) */
+    struct task_ctrl_blk *task;
+    /** Event source ("enum events") */
+    uint8_t source;
+    /** Activations received and not yet served (the active job's included) */
+    uint8_t pending;
+    /** Position of the oldest pending activation in "timestamp" */
+    uint8_t head;
+    /** Activations dropped because "EVENT_QUEUE_SIZE" were already pending */
+    uint16_t lost;
+    /** System tick on which each pending activation happened */
+    uint32_t timestamp[EVENT_QUEUE_SIZE];
+}
+event_ctrl_blk;
+
+#ifdef FATE_PROFILE
+/**
+ *  Execution time statistics of a task, in CPU (MCLK) cycles
+ *  A job's execution time includes the interrupts taken while it runs.
+ */
+typedef struct task_profile
+{
+    /** Number of completed jobs */
+    uint32_t jobs;
+    /** Longest completed job (worst case execution time observed) */
+    uint32_t wcet;
+    /** Shortest completed job (best case execution time observed) */
+    uint32_t bcet;
+    /** Average of the completed jobs (only filled in by "Task_get_profile") */
+    uint32_t avg;
+    /** Total of the completed jobs */
+    uint64_t total;
+    /** Cycles executed so far by the active job */
+    uint32_t current;
+}
+task_profile;
+#endif
+
+#ifdef FATE_BENCH
+/** Scheduler paths timed by FATE_BENCH */
+enum bench_path {
+    /** TA0_N_IRQHandler, on a timer roll over */
+    BENCH_TICK,
+    /** TA0_N_IRQHandler, run by a task stopping or an event */
+    BENCH_RESCHEDULE,
+    /** get_priority_task, called by TA0_N_IRQHandler */
+    BENCH_PRIORITY,
+    /** Task_stop, up to running the scheduler */
+    BENCH_STOP,
+    /** Context switch: "switch_context", called by PendSV_Handler */
+    BENCH_SWITCH,
+    NUM_BENCH_PATHS
+};
+
+/**
+ *  Measurements of one scheduler path, over the calls that finished
+ *  with a given number of tasks active (Running or Suspended, idle task excluded)
+ */
+typedef struct bench_stat
+{
+    /** Number of calls measured */
+    uint32_t count;
+    /** Shortest call */
+    uint32_t min;
+    /** Longest call */
+    uint32_t max;
+    /** Total of all calls */
+    uint64_t total;
+}
+bench_stat;
+
+/** Clock the scheduler is timed with, and its unit */
+#ifdef FATE_SIM
+#define BENCH_CLOCK() sim_host_clock()
+#define BENCH_UNIT "host_ns"
+#else
+#define BENCH_CLOCK() (DWT->CYCCNT)
+#define BENCH_UNIT "cycles"
+#endif
+#endif
+
+#ifdef FATE_TRACE
+/** Trace record types */
+enum trace_type {
+    /** Slot claimed, record not written yet */
+    TRACE_EMPTY,
+    /** Timer A0 rolled over, and a release or deadline came due: "arg" system ticks
+        elapsed since the last TRACE_TICK record, at most 65535. Ticks that change
+        nothing are not recorded */
+    TRACE_TICK,
+    /** Periodic task released ("arg" is 1 if it was still active, so the release is skipped) */
+    TRACE_RELEASE,
+    /** Event "arg" activated the task (or queued an activation) */
+    TRACE_EVENT,
+    /** Event "arg" was lost: too many activations pending */
+    TRACE_EVENT_LOST,
+    /** Context switch to the task, from task "arg" */
+    TRACE_SWITCH,
+    /** Task stopped (job finished) */
+    TRACE_STOP,
+    /** The task's active job missed its deadline ("arg" is the task's "enum overrun_policy") */
+    TRACE_DEADLINE_MISS,
+    /** Sent by the idle task after the records before it: "arg" records (at most 65535)
+        were dropped since, the ring buffer being full (see "Trace_dropped") */
+    TRACE_DROPPED
+};
+
+/**
+ *  Trace record
+ *  Sent to ITM as two words: "timestamp", then type | task << 8 | arg << 16.
+ */
+typedef struct trace_record
+{
+    /** DWT cycle count */
+    uint32_t timestamp;
+    /** "enum trace_type" */
+    uint8_t type;
+    /** Position of the task in "Task_list" */
+    uint8_t task;
+    /** Depends on the type */
+    uint16_t arg;
+}
+trace_record;
+#endif
+
 /** Structure that holds information for each task */
-typedef struct 
+typedef struct task_ctrl_blk
 {
     /** Address of function that implements thread */
 	intptr_t function;
     /** Thread's periodicity in number of system ticks */
 	uint32_t period;
-    /** Number of system ticks that elapsed while task is stopped */
-	uint32_t count;
     /** Number of system ticks to wait before scheduling task */
     uint32_t start_offset;
     /** The number of ticks from when the task starts to when it must complete */
     uint32_t deadline;
-    /** The number of ticks remaining until the tasks deadline */
-    uint32_t deadline_remaining;
+    /** Release queue entry: ticks until the task is next released (periodic tasks) */
+    timer_node release_timer;
+    /** Deadline of the active job, in system ticks since the scheduler started */
+    uint32_t absolute_deadline;
+    /** Position of the active job in the ready heap */
+    uint8_t ready_index;
+    /** Saved stack pointer while switched out (0: the active job has not started yet) */
+    uint32_t *sp;
+    /** Top of the task's stack */
+    uint32_t *stack;
+    /** Modes of the Timer A1-A3 the task left counting when switched out */
+    uint8_t exec_timers;
+    /** Event that activates the task (0 for periodic tasks) */
+    struct event_ctrl_blk *event;
+#ifdef FATE_PROFILE
+    /** Execution time statistics */
+    task_profile profile;
+#endif
+#ifdef FATE_ADMISSION
+    /** Worst case execution time, in microseconds */
+    uint32_t wcet;
+    /** Aperiodic tasks: minimum number of system ticks between events */
+    uint32_t interarrival;
+#endif
+    /** Number of deadlines missed */
+    uint32_t misses;
+    /** What happens to a job that misses its deadline */
+    enum overrun_policy overrun:8;
+    /** Set by OVERRUN_SKIP: the next release is skipped */
+    uint8_t skip_release;
     /** -1 not initialized, 0 stopped, 1 suspended, 2 running */
     enum task_state state:8;
 }
@@ -91,24 +366,149 @@ void Task_list_init(void);
  *
  *  @param function The function which should be called for this task
  *  @param period Number of system ticks per task
- *  @param period Number of system ticks to wait before scheduling the task for the first time
- *  @param priority The priority of this task, high numbers are prioritized
+ *  @param start_offset Number of system ticks to wait before scheduling the task for the first time
+ *  @param deadline Number of system ticks from each release to when the job must complete
+ *  @param wcet (FATE_ADMISSION) Worst case execution time, in microseconds
  *
  *  @return 0 if the task was successfully added to the task list
+ *          (1 if there is no room, 2 if it failed the admission test)
  */
+#ifdef FATE_ADMISSION
+uint8_t Task_add(intptr_t function, uint32_t period, uint32_t start_offset,
+                uint32_t deadline, uint32_t wcet);
+#else
 uint8_t Task_add(intptr_t function, uint32_t period, uint32_t start_offset,
                 uint32_t deadline);
+#endif
 
 /**
  *  Add a new aperiodic task to the task list.
  *
  *  @param function The function which should be called for this task
  *  @param event The event which should trigger this task
- *  @param priority The priority of this task, high numbers are prioritized
+ *  @param deadline Number of system ticks from each event to when the job must complete
+ *  @param wcet (FATE_ADMISSION) Worst case execution time, in microseconds
+ *  @param interarrival (FATE_ADMISSION) Minimum number of system ticks between events
+ *
+ *  @note Port pins are configured as inputs with pull-up resistors,
+ *        triggering on the falling edge (active low switches).
  *
  *  @return 0 if the task was successfully added to the task list
+ *          (1 if there is no room, or the event already has a task,
+ *          2 if it failed the admission test)
  */
+#ifdef FATE_ADMISSION
+uint8_t Task_event_add(intptr_t function, enum events event, uint32_t deadline,
+                       uint32_t wcet, uint32_t interarrival);
+#else
 uint8_t Task_event_add(intptr_t function, enum events event, uint32_t deadline);
+#endif
+
+/**
+ *  Get the time an aperiodic task's current job was activated.
+ *
+ *  @param event The event which triggers the calling task
+ *
+ *  @return The system tick on which the event happened
+ *          (0 if the event is out of range, or has no task)
+ */
+uint32_t Task_event_time(enum events event);
+
+/**
+ *  Raise an event, like a port interrupt does for its pins:
+ *  activates the event's task (if any), and runs the scheduler.
+ *
+ *  @param event The event to raise, usually an "EVENT_SOFTWARE"
+ *
+ *  @note Can be called from tasks, and from interrupt handlers
+ *        of any priority.
+ */
+void Event_signal(enum events event);
+
+/**
+ *  Set what happens when a task's job misses its deadline.
+ *
+ *  @param function The function of the task
+ *  @param policy OVERRUN_CONTINUE (the default), OVERRUN_ABORT or OVERRUN_SKIP
+ *
+ *  @return 0 if the task was found
+ */
+uint8_t Task_set_overrun(intptr_t function, enum overrun_policy policy);
+
+/**
+ *  Get the number of deadlines a task has missed.
+ *
+ *  @param function The function of the task
+ *
+ *  @return The number of misses (0 if the task was not found)
+ */
+uint32_t Task_get_misses(intptr_t function);
+
+/**
+ *  Set a function to call whenever a job misses its deadline,
+ *  before the task's overrun policy is applied.
+ *
+ *  @param handler Called with the function of the task (0 for none)
+ *
+ *  @note The handler runs in the scheduler's interrupt: it must be short,
+ *        and may only call "Event_signal" and the functions above.
+ */
+void Task_set_miss_handler(void (*handler)(intptr_t function));
+
+#ifdef FATE_PROFILE
+/**
+ *  Get the execution time statistics of a task.
+ *
+ *  @param function The function of the task (idle_thread for the idle task,
+ *                  whose every stretch of idle time counts as a job)
+ *  @param profile Filled in with the task's statistics
+ *
+ *  @return 0 if the task was found
+ */
+uint8_t Task_get_profile(intptr_t function, task_profile *profile);
+
+/**
+ *  Clear the execution time statistics of every task.
+ */
+void Task_reset_profiles(void);
+#endif
+
+#ifdef FATE_BENCH
+/**
+ *  Get the measurements of a scheduler path.
+ *
+ *  @param path The path
+ *  @param active Number of active tasks the calls finished with (0 to NUM_TASKS - 1)
+ *  @param stat Filled in with the measurements
+ *
+ *  @return 0 if the path and number of tasks are valid
+ */
+uint8_t Bench_get(enum bench_path path, uint32_t active, bench_stat *stat);
+
+/**
+ *  Clear every measurement.
+ */
+void Bench_reset(void);
+#endif
+
+#ifdef FATE_TRACE
+/**
+ *  Take the oldest record out of the trace ring buffer, e.g. to send it over a UART.
+ *
+ *  @param record Filled in with the record
+ *
+ *  @return 1 if there was a record, 0 if the buffer is empty
+ *
+ *  @note Only one context may read the trace: the idle task does when the ITM
+ *        port is enabled.
+ */
+uint8_t Trace_read(trace_record *record);
+
+/**
+ *  Get the number of records dropped because the trace ring buffer was full.
+ */
+uint32_t Trace_dropped(void);
+#endif
 
 /**
  *  Start the task scheduler.
@@ -123,28 +523,21 @@ void Task_schedule(void);
  */
 extern task_ctrl_blk Task_list[NUM_TASKS];
 
-/*
-Macro called by each task when it finishes execution
-
-Since we do not want Task functions to call other function (no proper stack handling yet)
-this is implemented as a Macro rather than a function.
-
-"Task_stop" finds the calling task by function address in the task list
-and changes its state to Stopped. It then sets the pending bit for the timer A0
-interrupt so that the scheduler will run.
-*/
-//Stops a task
-#define Task_stop(X) { \
-	int i; \
-	for(i=1;i<NUM_TASKS;i++) \
-	{ \
-		if(Task_list[i].function == X) \
-		{ \
-			Task_list[i].state = TASK_STOPPED; \
-            NVIC_SetPendingIRQ(TA0_N_IRQn); \
-            while(1); \
-		} \
-	}\
-}
+/**
+ *  List of events, and the task each one activates.
+ */
+extern event_ctrl_blk Event_task_list[NUM_EVENTS];
+
+/**
+ *  Called by each task when it finishes execution
+ *  (returning from the task function does the same).
+ *
+ *  Finds the calling task by function address in the task list
+ *  and changes its state to Stopped. It then sets the pending bit for the timer A0
+ *  interrupt so that the scheduler will run.
+ *
+ *  @note This function does not return.
+ */
+void Task_stop(intptr_t function);
 
 #endif
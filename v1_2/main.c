@@ -13,10 +13,9 @@ void Task_3 (void);
 
 //Functions that implement our 2 periodic tasks
 //Return type and arguments must always be void
-//For now, no local variables
-//No calling other functions
-//When execution is finished, must always call "Task_stop" with its name
-//NOT return: that would probably crash our kernel
+//Each task has its own stack ("STACK_SIZE" in "fate.h"), so local variables
+//and calls to other functions are fine
+//When execution is finished, call "Task_stop" with its name (or just return)
 void LED_toggle(void)
 {
 	P1OUT ^= (uint8_t)BIT0;
@@ -137,9 +136,16 @@ int main(void)
     // Aperiodic task pased on P1.4 button
 	//Task_event_add((intptr_t)LED_RGB_toggle, SWITCH_P1_4, 100);
     
-    Task_add((uint32_t)Task_1, 1500, 300, 100);
-    Task_add((uint32_t)Task_2, 1500, 0, 1500);
-    Task_add((uint32_t)Task_3, 1500, 100, 700);
+#ifdef FATE_ADMISSION
+    // Execution times: one period of each task's timer (1s, 10s and 3s)
+    Task_add((intptr_t)Task_1, 1500, 300, 100, 1000000);
+    Task_add((intptr_t)Task_2, 1500, 0, 1500, 10000000);
+    Task_add((intptr_t)Task_3, 1500, 100, 700, 3000000);
+#else
+    Task_add((intptr_t)Task_1, 1500, 300, 100);
+    Task_add((intptr_t)Task_2, 1500, 0, 1500);
+    Task_add((intptr_t)Task_3, 1500, 100, 700);
+#endif
 
 	//This will begin scheduling our tasks 
 	Task_schedule();
@@ -0,0 +1,3152 @@
+/*****************************************************
+ 
+ 
+ FATE_OS_C v2.0
+ The "Fake Time Environment Operating System"
+ 
+ Developed by
+ Paulo Garcia
+ Dpt. of Systems and Computer Engineering
+ Carleton University
+ Ottawa, Ontario, Canada
+ 
+ This code if for educational purposes only (SYSC3310 - Introduction to Real Time Systems)
+ We do not guarantee this code will work on any given situation.
+ Do not use this code in production software.
+ 
+ 
+ V1.0:
+ 
+ Basic support for up to 8 periodic tasks.
+ Tasks cannot call other functions nor should they have local variables.
+ 
+ V1.1:
+ Added support for aperiodic tasks (port interrupt events only)
+ 
+ V1.2:
+ EDF scheduling, with start offsets and deadlines
+ Optional tickless operation (FATE_TICKLESS)
+ Releases and deadlines kept in delta queues (per-tick work only for due events)
+ Context switching through PendSV, with a stack per task: preempted tasks resume
+ where they left off, and may use local variables, call functions and return
+ Events run the scheduler immediately, instead of at the next tick
+ Aperiodic task activations are counted (and time stamped), so bursts are not lost
+ Table-driven events: any pin of ports P1-P6, or software events (Event_signal)
+ Optional execution time profiling with the DWT cycle counter (FATE_PROFILE)
+ Optional scheduler trace, drained to ITM (FATE_TRACE)
+ Optional scheduler cost measurement (FATE_BENCH)
+ Optional admission control with the EDF processor demand test (FATE_ADMISSION)
+ Deadline misses detected and counted per task, with an optional handler and
+ an overrun policy per task (continue, abort the job, or skip the next release)
+ Absolute deadlines, with active jobs in a binary heap in EDF order
+ Aperiodic jobs get a deadline relative to their activation, instead of being most urgent
+ 
+ V2.0:
+ One kernel for every scheduling policy, chosen at compile time (FATE_POLICY):
+ EDF, rate monotonic, deadline monotonic or fixed priorities
+ Fixed priority policies rank tasks when they are added, and find the highest
+ priority active task with a single CLZ
+ Admission control runs response time analysis for fixed priority policies
+ Least laxity first (FATE_POLICY_LLF) and EDF until zero laxity (FATE_POLICY_EDZL),
+ from execution times measured by the kernel
+ Optional preemption thresholds for fixed priority policies (FATE_PREEMPTION_THRESHOLD),
+ assigned offline by "host/fate_threshold", and checked by admission control
+ (response time analysis of Wang and Saksena)
+ Optional shared resources under the Stack Resource Policy (FATE_RESOURCES)
+ Lock-free single producer, single consumer message queues (Queue_put, Queue_get)
+ Fixed block memory pools, O(1) and interrupt safe (Pool_alloc, Pool_free)
+ Time-triggered cyclic executive (FATE_POLICY_CYCLIC): jobs are released and
+ given the CPU by a static dispatch table (Task_set_table)
+ Optional high resolution timing (FATE_HIRES): releases and deadlines in Timer A0
+ counts, on a compare channel of the free running timer
+ Tick rate and Timer A0 clock source set at run time (Task_set_tick), and task times
+ in microseconds or milliseconds (Task_add_us, Task_add_ms), with rounding errors reported
+ 64 bit monotonic time since the scheduler started (Time_ticks, Time_us), read lock-free,
+ counted by the free running Timer A0: ticks missed by a late scheduler are caught up
+ 
+ ******************************************************/
+
+#include <msp.h>
+#include "fate.h"
+
+// Prototypes
+void idle_thread(void);
+void Enable_event(enum events event);
+
+void TA0_N_IRQHandler(void);
+void PORT1_IRQHandler(void);
+void PORT2_IRQHandler(void);
+void PORT3_IRQHandler(void);
+void PORT4_IRQHandler(void);
+void PORT5_IRQHandler(void);
+void PORT6_IRQHandler(void);
+void PendSV_Handler(void);
+uint32_t *switch_context(uint32_t *sp);
+static void deadline_missed(task_ctrl_blk *task);
+static void event_served(event_ctrl_blk *event);
+static uint32_t current_tick(void);
+#ifdef FATE_TRACE
+static void trace_drain(void);
+#endif
+
+
+/**
+ *  Idle thread
+ *  Executes whenever no other thread is scheduled to run, sleep until the interrupt
+ *  occures.
+ */
+void idle_thread(void)
+{
+    while(1)
+    {
+#ifdef FATE_TRACE
+        trace_drain();
+#endif
+        __WFI();
+    }
+}
+
+/**
+ *  List that holds the information structure for each task (task_ctrl_blk).
+ *  Size of this list limits the number of tasks FATE-OS supports.
+ */
+task_ctrl_blk Task_list[NUM_TASKS];
+
+/**
+ *  List that matches events to a corresponding task, and queues
+ *  the activations the task has not served yet
+ */
+event_ctrl_blk Event_task_list[NUM_EVENTS];
+
+/**
+ *  Event source to "Event_task_list" lookup table: entry + 1, or 0 if no task is attached
+ *  ISRs find the task an event activates with this single lookup.
+ */
+static uint8_t event_slot[EVENT_SOURCES];
+
+/** Configuration registers of an interrupt capable port */
+typedef struct
+{
+    volatile uint8_t *sel0;
+    volatile uint8_t *sel1;
+    volatile uint8_t *dir;
+    volatile uint8_t *ren;
+    volatile uint8_t *out;
+    volatile uint8_t *ies;
+    volatile uint8_t *ifg;
+    volatile uint8_t *ie;
+}
+port_regs;
+
+#define PORT_REGS(n) { &(P##n##SEL0), &(P##n##SEL1), &(P##n##DIR), &(P##n##REN), \
+                       &(P##n##OUT), &(P##n##IES), &(P##n##IFG), &(P##n##IE) }
+
+/** Ports P1-P6, to configure event pins */
+static const port_regs ports[6] = {
+    PORT_REGS(1), PORT_REGS(2), PORT_REGS(3), PORT_REGS(4), PORT_REGS(5), PORT_REGS(6)
+};
+
+/**
+ *  Pointer to element in "Task_list" that is currently executing
+ *  (Idle task by default).
+ *  Used in Timer ISR to determine if we are running highest priority task or not
+ */
+task_ctrl_blk *current_task = &(Task_list[0]);
+
+/**
+ *  Pointer to element in "Task_list" whose context is on the CPU
+ *  Differs from "current_task" only until PendSV switches context.
+ */
+static task_ctrl_blk *running_task = &(Task_list[0]);
+
+/**
+ *  Task stacks, one per element of "Task_list"
+ *  (64 bit elements keep them 8 byte aligned, as the ARM procedure call standard requires)
+ */
+static uint64_t task_stacks[NUM_TASKS][STACK_SIZE / 8];
+
+#ifdef FATE_PROFILE
+/**
+ *  DWT cycle count when "running_task" was switched in
+ */
+static uint32_t switched_in;
+#endif
+
+#ifdef FATE_TRACE
+/**
+ *  Trace ring buffer
+ *  Records are claimed by incrementing "trace_head" with LDREX/STREX, so any
+ *  interrupt (or task) can trace without locking; each record is complete once
+ *  its type is written, and the reader empties it after reading.
+ */
+static volatile trace_record trace_buffer[TRACE_SIZE];
+static volatile uint32_t trace_head;
+static volatile uint32_t trace_tail;
+static volatile uint32_t trace_dropped;
+/** Dropped records already reported in the ITM stream (see "trace_drain") */
+static uint32_t trace_reported;
+/** Ticks elapsed since the last TRACE_TICK record (tick handler only) */
+static uint32_t trace_ticks;
+
+/**
+ *  Appends a record to the trace ring buffer (dropped if it is full)
+ */
+static void trace(uint8_t type, task_ctrl_blk *task, uint16_t arg)
+{
+    volatile trace_record *record;
+    uint32_t head;
+    //Stamped before the slot is claimed: an interrupt traced in between is at most
+    //as far out of order as it is long (not a slot claimed, then stamped much later)
+    uint32_t timestamp = DWT->CYCCNT;
+    
+    do {
+        head = __LDREXW(&trace_head);
+        if(head - trace_tail >= TRACE_SIZE)
+        {
+            __CLREX();
+            trace_dropped++;
+            return;
+        }
+    } while(__STREXW(head + 1, &trace_head));
+    
+    record = &(trace_buffer[head % TRACE_SIZE]);
+    record->timestamp = timestamp;
+    record->task = (uint8_t)(task - Task_list);
+    record->arg = arg;
+    record->type = type;
+}
+
+#define TRACE(type, task, arg) trace((type), (task), (uint16_t)(arg))
+#else
+#define TRACE(type, task, arg)
+#endif
+
+#ifdef FATE_BENCH
+/**
+ *  Scheduler measurements (see "Bench_get"), and the time it takes
+ *  to read "BENCH_CLOCK" (taken out of every measurement)
+ */
+static bench_stat bench_stats[NUM_BENCH_PATHS][NUM_TASKS];
+static uint32_t bench_overhead;
+
+/**
+ *  Adds a measurement of a scheduler path, by the number of tasks active at its end
+ */
+static void bench_record(enum bench_path path, uint32_t elapsed)
+{
+    bench_stat *stat;
+    int i, active = 0;
+    
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        if((Task_list[i].state == TASK_RUNNING) || (Task_list[i].state == TASK_SUSPENDED))
+            active++;
+    }
+    elapsed = (elapsed > bench_overhead) ? (elapsed - bench_overhead) : 0;
+    
+    stat = &(bench_stats[path][active]);
+    stat->count++;
+    stat->total += elapsed;
+    if(elapsed < stat->min)
+        stat->min = elapsed;
+    if(elapsed > stat->max)
+        stat->max = elapsed;
+}
+#endif
+
+/**
+ *  Timer A0 clock, in Hz, and one system tick in its counts and in microseconds
+ *  (rounded down), as set by "Task_set_tick"
+ */
+static uint32_t timer_hz = TIMER_HZ;
+static uint32_t tick_counts = TICK_COUNTS + 1;
+static uint32_t tick_us = TICK_US;
+
+/**
+ *  Timer A0 clock source and input divider, for TA0CTL and TA0EX0
+ */
+static uint16_t timer_ctl = TIMER_A_CTL_SSEL__ACLK;
+static uint16_t timer_ex0 = 0;
+
+#ifdef FATE_HIRES
+/**
+ *  Time unit of releases, deadlines and event time stamps: Timer A0 counts
+ *  (system ticks, unless FATE_HIRES). "TICKS" converts system ticks to it,
+ *  "TIME_COUNTS" converts it to Timer A0 counts and "COUNTS_TIME" back (rounded
+ *  down), "TIME_US" to microseconds, and "US_TIME" back (rounded down).
+ */
+#define TICKS(ticks) ((ticks) * tick_counts)
+#define TIME_COUNTS(time) (time)
+#define COUNTS_TIME(counts) (counts)
+#define TIME_US(time) ((uint64_t)(time) * 1000000 / timer_hz)
+#define US_TIME(us) ((uint64_t)(us) * timer_hz / 1000000)
+#else
+#define TICKS(ticks) (ticks)
+#define TIME_COUNTS(time) ((time) * tick_counts)
+#define COUNTS_TIME(counts) ((counts) / tick_counts)
+#define TIME_US(time) ((uint64_t)(time) * tick_us)
+#define US_TIME(us) ((us) / tick_us)
+#endif
+
+/**
+ *  Longest the scheduler sleeps: half the counter's range, so that "current_tick"
+ *  can always tell how far Timer A0 moved since "tick_count", even if the
+ *  scheduler runs late
+ */
+#define MAX_SLEEP COUNTS_TIME(0x8000)
+
+/**
+ *  System ticks elapsed up to the last time the scheduler caught up
+ *  (FATE_HIRES: Timer A0 counts)
+ */
+static uint32_t tick_count;
+
+#ifdef FATE_HIRES
+/** Timer A0 count at "tick_count": its low 16 bits */
+#define tick_base ((uint16_t)tick_count)
+#else
+/**
+ *  Timer A0 count at which tick "tick_count" started
+ */
+static uint16_t tick_base;
+#endif
+
+/**
+ *  Time Timer A0 is programmed to interrupt at (CCR1)
+ */
+static uint32_t timer_event;
+
+/**
+ *  "tick_count" extended to 64 bits, with its "tick_base", for "Time_ticks" and
+ *  "Time_us". The scheduler writes the copy readers are not directed to, then
+ *  counts "time_seq" up to direct them to it: a reader that interrupts it still
+ *  finds the other copy whole, and one it interrupts reads again.
+ */
+static struct {
+    uint64_t time;
+    uint16_t base;
+} time_copies[2];
+static volatile uint32_t time_seq;
+
+/**
+ *  Ticks that passed without their own timer interrupt: the scheduler caught
+ *  them up late, interrupts having been held off for that long
+ */
+static uint32_t missed_ticks;
+
+/**
+ *  Delta queue of periodic task releases, in time order
+ */
+static timer_node *release_queue;
+
+#if FATE_POLICY == FATE_POLICY_CYCLIC
+/**
+ *  Dispatch table (see "Task_set_table"), and the number of entries in it
+ */
+static const cyclic_entry *cyclic_table;
+static uint32_t cyclic_entries;
+
+/**
+ *  Length of the table's cycle, in system ticks
+ */
+static uint32_t cyclic_length;
+
+/**
+ *  Next entry to take effect, and the number of system ticks until it does
+ *  (FATE_HIRES: Timer A0 counts)
+ */
+static uint32_t cyclic_next;
+static uint32_t cyclic_wait;
+
+/**
+ *  Task the last entry gave the CPU to
+ */
+static task_ctrl_blk *slot_task;
+#endif
+
+/** Position of a task that is not in a heap (see "TASK_HEAP") */
+#define HEAP_NONE 0xFF
+
+/**
+ *  Binary min-heap of tasks, "name_heap", ordered by the TCB field "key"
+ *  (a time, which wraps around; ties broken by position in "Task_list"), with
+ *  each task's position in the TCB field "index" (HEAP_NONE while it is not in it)
+ *  Defines "name_insert", and "name_remove", which does nothing if the task is not
+ *  in the heap. The first entry is the smallest: O(1) to find, O(log n) to change.
+ */
+#define TASK_HEAP(name, key, index)                                             \
+static task_ctrl_blk *name##_heap[NUM_TASKS];                                   \
+static uint32_t name##_count;                                                   \
+                                                                                \
+static inline uint8_t name##_first(const task_ctrl_blk *a, const task_ctrl_blk *b) \
+{                                                                               \
+    int32_t difference = (int32_t)(a->key - b->key);                            \
+                                                                                \
+    return (difference < 0) || ((difference == 0) && (a < b));                  \
+}                                                                               \
+                                                                                \
+/* Places "task" in the hole at position "i", or further up */                  \
+static void name##_sift_up(task_ctrl_blk *task, uint32_t i)                     \
+{                                                                               \
+    uint32_t parent;                                                            \
+                                                                                \
+    while(i && name##_first(task, name##_heap[parent = (i - 1) / 2]))          \
+    {                                                                           \
+        name##_heap[i] = name##_heap[parent];                                   \
+        name##_heap[i]->index = (uint8_t)i;                                     \
+        i = parent;                                                             \
+    }                                                                           \
+    name##_heap[i] = task;                                                      \
+    task->index = (uint8_t)i;                                                   \
+}                                                                               \
+                                                                                \
+/* Places "task" in the hole at position "i", or further down */                \
+static void name##_sift_down(task_ctrl_blk *task, uint32_t i)                   \
+{                                                                               \
+    uint32_t child;                                                             \
+                                                                                \
+    while((child = 2 * i + 1) < name##_count)                                   \
+    {                                                                           \
+        if((child + 1 < name##_count) &&                                        \
+           name##_first(name##_heap[child + 1], name##_heap[child]))           \
+            child++;                                                            \
+        if(!name##_first(name##_heap[child], task))                            \
+            break;                                                              \
+        name##_heap[i] = name##_heap[child];                                    \
+        name##_heap[i]->index = (uint8_t)i;                                     \
+        i = child;                                                              \
+    }                                                                           \
+    name##_heap[i] = task;                                                      \
+    task->index = (uint8_t)i;                                                   \
+}                                                                               \
+                                                                                \
+static void name##_insert(task_ctrl_blk *task)                                  \
+{                                                                               \
+    name##_sift_up(task, name##_count++);                                       \
+}                                                                               \
+                                                                                \
+static void name##_remove(task_ctrl_blk *task)                                  \
+{                                                                               \
+    task_ctrl_blk *last;                                                        \
+    uint32_t i = task->index;                                                   \
+                                                                                \
+    if(i == HEAP_NONE)                                                          \
+        return;                                                                 \
+    task->index = HEAP_NONE;                                                    \
+    last = name##_heap[--name##_count];                                         \
+    if(last == task)                                                            \
+        return;                                                                 \
+    /* The last entry fills the hole, and moves up or down to its place */      \
+    if(i && name##_first(last, name##_heap[(i - 1) / 2]))                      \
+        name##_sift_up(last, i);                                                \
+    else                                                                        \
+        name##_sift_down(last, i);                                              \
+}
+
+/**
+ *  Active tasks whose deadline has not passed, earliest absolute deadline first
+ *  A task leaves it when it misses its deadline, or when it stops.
+ *  Under EDF, this is the order tasks run in; every policy detects misses with it.
+ */
+TASK_HEAP(deadline, absolute_deadline, heap_index)
+
+#if FATE_LAXITY
+/**
+ *  Active tasks whose deadline has not passed, least laxity (earliest latest start
+ *  time) first
+ *  Laxity only changes for the job on the CPU (that of waiting jobs drops at the
+ *  same rate for all), which goes back to its place when it is charged.
+ */
+TASK_HEAP(slack, latest_start, slack_index)
+
+/**
+ *  Time (see "current_time") up to which "running_task" has been charged for its execution
+ */
+static uint32_t charged_at;
+#endif
+
+#if FATE_FIXED_PRIORITY
+/**
+ *  Tasks in priority order: "ranked_tasks[r]" is the task of rank r
+ */
+static task_ctrl_blk *ranked_tasks[NUM_TASKS];
+static uint32_t ranked_count;
+
+/**
+ *  Active tasks: bit (31-r) is set for the task of rank r
+ */
+static uint32_t ready_tasks;
+
+#ifdef FATE_PREEMPTION_THRESHOLD
+/**
+ *  Active tasks whose job has started: bit (31-r) is set for the task of rank r
+ *  A started job runs at its threshold; the highest ranked started job is the one
+ *  the others have been preempted by (or the only one).
+ */
+static uint32_t started_tasks;
+#endif
+#else
+/**
+ *  Active tasks whose deadline has passed: bit (31-i) is set for Task_list[i]
+ *  (jobs that missed their deadline and carry on)
+ *  They all rank ahead of the tasks in "deadline_heap".
+ */
+static uint32_t expired_tasks;
+#endif
+
+#ifdef FATE_RESOURCES
+/** Shared resource (see "Resource_lock") */
+typedef struct resource_ctrl_blk
+{
+    /** Tasks that use it: bit (31-i) is set for Task_list[i] */
+    uint32_t users;
+    /** Its ceiling, as a preemption rank (see "preemption_rank") */
+    uint32_t ceiling;
+    /** Task whose job holds it (0 if it is free) */
+    task_ctrl_blk *holder;
+    /** Resource locked before it, and still locked */
+    struct resource_ctrl_blk *below;
+#ifdef FATE_ADMISSION
+    /** Longest critical section of each task on it, in microseconds */
+    uint32_t length[NUM_TASKS];
+#endif
+}
+resource_ctrl_blk;
+
+static resource_ctrl_blk resources[NUM_RESOURCES];
+
+/** Last resource locked (0 if none): locked resources are unlocked in reverse order */
+static resource_ctrl_blk *locked_resources;
+
+/** "system_ceiling" while no resource is locked */
+#define NO_CEILING UINT32_MAX
+
+/**
+ *  Highest ceiling of the locked resources, as a preemption rank: a job only
+ *  starts if its task's preemption rank is below it
+ */
+static uint32_t system_ceiling;
+
+/**
+ *  Jobs that have started and not ended, in the order they started
+ *  A job only starts ahead of every active job, so the last one is the highest
+ *  priority one: it runs while the jobs ahead of it are kept from starting.
+ */
+static task_ctrl_blk *started_jobs[NUM_TASKS];
+static uint32_t started_count;
+#endif
+
+/**
+ *  Called on every deadline miss (see "Task_set_miss_handler")
+ */
+static void (*miss_handler)(intptr_t function);
+
+/**
+ *  Must always be called in "main" prior to adding other tasks.
+ 
+ *  Initialized element 0 of "Task_list" as the Idle task and sets all
+ *  others as empty (state == Undefined) so they can eventually be setup
+ *  through calls to "Task_add"
+ */
+void Task_list_init(void)
+{
+    int i;
+#if defined(FATE_RESOURCES) && defined(FATE_ADMISSION)
+    int j;
+#endif
+    
+    Task_list[0].state = TASK_RUNNING;
+    Task_list[0].function = (intptr_t)idle_thread;
+    Task_list[0].period = 1;
+    
+    //Stacks grow down, from the end of each task's array
+    for(i=0;i<NUM_TASKS;i++)
+    {
+        Task_list[i].stack = (uint32_t *)(task_stacks[i] + STACK_SIZE / 8);
+        Task_list[i].sp = (uint32_t *)0;
+        Task_list[i].exec_timers = 0;
+        Task_list[i].event = (event_ctrl_blk *)0;
+        Task_list[i].misses = 0;
+        Task_list[i].overrun = OVERRUN_CONTINUE;
+        Task_list[i].skip_release = 0;
+        Task_list[i].heap_index = HEAP_NONE;
+#ifdef FATE_PREEMPTION_THRESHOLD
+        Task_list[i].threshold = (task_ctrl_blk *)0;
+#endif
+#if FATE_LAXITY
+        Task_list[i].budget = 0;
+        Task_list[i].executed = 0;
+        Task_list[i].slack_index = HEAP_NONE;
+#endif
+    }
+    miss_handler = 0;
+#ifdef FATE_PROFILE
+    Task_reset_profiles();
+#endif
+    
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        Task_list[i].state = TASK_UNDEFINED;
+        Task_list[i].function = (intptr_t)idle_thread;
+        Task_list[i].period = 1;
+        Task_list[i].release_timer.task = &(Task_list[i]);
+    }
+    
+    release_queue = (timer_node *)0;
+#if FATE_POLICY == FATE_POLICY_CYCLIC
+    cyclic_entries = 0;
+    slot_task = &(Task_list[0]);
+#endif
+    deadline_count = 0;
+#if FATE_LAXITY
+    slack_count = 0;
+    charged_at = 0;
+#endif
+#if FATE_FIXED_PRIORITY
+    ready_tasks = 0;
+    ranked_count = 0;
+#ifdef FATE_PREEMPTION_THRESHOLD
+    started_tasks = 0;
+#endif
+#else
+    expired_tasks = 0;
+#endif
+#ifdef FATE_RESOURCES
+    for(i=0;i<NUM_RESOURCES;i++)
+    {
+        resources[i].users = 0;
+        resources[i].ceiling = NO_CEILING;
+        resources[i].holder = (task_ctrl_blk *)0;
+#ifdef FATE_ADMISSION
+        for(j=0;j<NUM_TASKS;j++)
+            resources[i].length[j] = 0;
+#endif
+    }
+    locked_resources = (resource_ctrl_blk *)0;
+    system_ceiling = NO_CEILING;
+    started_count = 0;
+#endif
+    tick_count = 0;
+#ifndef FATE_HIRES
+    tick_base = 0;
+#endif
+    timer_event = 0;
+    time_copies[time_seq & 1].time = 0;
+    time_copies[time_seq & 1].base = 0;
+    missed_ticks = 0;
+    
+    //Clear all aperiodic events
+    for(i=0;i<EVENT_SOURCES;i++)
+    {
+        event_slot[i] = 0;
+    }
+    for(i=0;i<NUM_EVENTS;i++)
+    {
+        Event_task_list[i].task = (task_ctrl_blk *)0;
+        Event_task_list[i].pending = 0;
+        Event_task_list[i].head = 0;
+        Event_task_list[i].lost = 0;
+    }
+    
+    //Back to the 10ms tick, from ACLK
+    timer_hz = TIMER_HZ;
+    tick_counts = TICK_COUNTS + 1;
+    tick_us = TICK_US;
+    timer_ctl = TIMER_A_CTL_SSEL__ACLK;
+    timer_ex0 = 0;
+}
+
+/**
+ *  Sets the system tick rate, and Timer A0's clock (see "fate.h"): the clock is
+ *  divided by the lowest power of two (up to 64) that fits one tick in half the timer
+ */
+uint8_t Task_set_tick(enum tick_clock clock, uint32_t hz)
+{
+    uint32_t clock_hz, counts = 0, shift;
+    uint64_t error;
+    int i;
+    
+    //Times already converted would change meaning
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        if(Task_list[i].state != TASK_UNDEFINED)
+            return 1;
+    }
+    switch(clock)
+    {
+        case TICK_ACLK:
+            clock_hz = TIMER_HZ;
+            break;
+        case TICK_SMCLK:
+            clock_hz = SMCLK_HZ;
+            break;
+        default:
+            return 1;
+    }
+    if(hz == 0)
+        return 1;
+    
+    //Divided by ID (up to 8), then by TA0EX0 (up to 8 again)
+    for(shift=0;shift<=6;shift++)
+    {
+        counts = (uint32_t)(((uint64_t)clock_hz + ((uint64_t)hz << shift) / 2) / ((uint64_t)hz << shift));
+        if(counts <= 0x8000)
+            break;
+    }
+    if((shift > 6) || (counts < 2))
+        return 1;
+    error = ((uint64_t)counts * hz) << shift;
+    error = (error > clock_hz) ? (error - clock_hz) : (clock_hz - error);
+    if(error * 1000 > (uint64_t)clock_hz * TIME_TOLERANCE)
+        return 3;
+    
+    timer_hz = clock_hz >> shift;
+    tick_counts = counts;
+    tick_us = (uint32_t)((uint64_t)counts * 1000000 / timer_hz);
+    timer_ctl = (uint16_t)(((clock == TICK_ACLK) ? TIMER_A_CTL_SSEL__ACLK : TIMER_A_CTL_SSEL__SMCLK) |
+                           (((shift < 3) ? shift : 3) << 6));
+    timer_ex0 = (uint16_t)((1u << (shift - ((shift < 3) ? shift : 3))) - 1);
+    return 0;
+}
+
+/**
+ *  Inserts "node" in a delta queue, to expire "ticks" system ticks from now
+ *  Entries expiring at the same time are kept in "Task_list" order.
+ */
+static void timer_insert(timer_node **queue, timer_node *node, uint32_t ticks)
+{
+    while(*queue && ((ticks > (*queue)->delta) ||
+                     ((ticks == (*queue)->delta) && ((*queue)->task < node->task))))
+    {
+        ticks -= (*queue)->delta;
+        queue = &((*queue)->next);
+    }
+    node->delta = ticks;
+    node->next = *queue;
+    //The entry after the new one now expires relative to it
+    if(node->next)
+        node->next->delta -= ticks;
+    *queue = node;
+}
+
+/**
+ *  Removes the entries that expire within "ticks" system ticks from a delta queue,
+ *  and returns them as a list (in expiration order).
+ *  The "delta" of each returned entry holds how many ticks ago it expired.
+ */
+static timer_node *timer_expire(timer_node **queue, uint32_t ticks)
+{
+    timer_node *expired = *queue;
+    timer_node *last = (timer_node *)0;
+    
+    while(*queue && ((*queue)->delta <= ticks))
+    {
+        last = *queue;
+        ticks -= last->delta;
+        //From now on, "delta" holds how many ticks ago the entry expired
+        last->delta = ticks;
+        *queue = last->next;
+    }
+    if(*queue)
+        (*queue)->delta -= ticks;
+    if(!last)
+        return (timer_node *)0;
+    last->next = (timer_node *)0;
+    return expired;
+}
+
+/**
+ *  Has the system tick "deadline" been reached at tick "now"?
+ *  (tick counts wrap around: deadlines must be less than 2^31 ticks away)
+ */
+static inline uint8_t deadline_reached(uint32_t deadline, uint32_t now)
+{
+    return (int32_t)(deadline - now) <= 0;
+}
+
+#if FATE_FIXED_PRIORITY
+/**
+ *  Does task "a" have a higher priority than task "b", under the fixed priority policy?
+ *  (ties broken by position in "Task_list")
+ */
+static uint8_t higher_priority(const task_ctrl_blk *a, const task_ctrl_blk *b)
+{
+#if FATE_POLICY == FATE_POLICY_FP
+    if(a->priority != b->priority)
+        return a->priority > b->priority;
+#elif FATE_POLICY == FATE_POLICY_RM
+    //Aperiodic tasks rank by their deadline, the shortest they could be served with
+    uint32_t rate_a = a->period ? a->period : a->deadline;
+    uint32_t rate_b = b->period ? b->period : b->deadline;
+    
+    if(rate_a != rate_b)
+        return rate_a < rate_b;
+#else
+    if(a->deadline != b->deadline)
+        return a->deadline < b->deadline;
+#endif
+    return a < b;
+}
+
+/**
+ *  Sorts the tasks into "ranked_tasks" (insertion sort: only run when tasks are added)
+ */
+static void rank_tasks(void)
+{
+    int i, r, n = 0;
+    
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        if(Task_list[i].state == TASK_UNDEFINED)
+            continue;
+        for(r = n; (r > 0) && higher_priority(&(Task_list[i]), ranked_tasks[r - 1]); r--)
+            ranked_tasks[r] = ranked_tasks[r - 1];
+        ranked_tasks[r] = &(Task_list[i]);
+        n++;
+    }
+    for(r=0;r<n;r++)
+        ranked_tasks[r]->rank = (uint8_t)r;
+    ranked_count = (uint32_t)n;
+#ifdef FATE_PREEMPTION_THRESHOLD
+    //A threshold below the task's own priority is the task's own priority
+    for(r=0;r<n;r++)
+    {
+        task_ctrl_blk *threshold = ranked_tasks[r]->threshold;
+        
+        if(threshold && (threshold->state != TASK_UNDEFINED) && (threshold->rank < r))
+            ranked_tasks[r]->threshold_rank = threshold->rank;
+        else
+            ranked_tasks[r]->threshold_rank = (uint8_t)r;
+    }
+#endif
+}
+#endif
+
+/**
+ *  Timer A0's count. Clocked asynchronously from ACLK: read until two consecutive
+ *  reads agree. From SMCLK, in step with the CPU, one read is exact (and two would
+ *  seldom agree).
+ */
+static inline uint16_t timer_read(void)
+{
+    uint16_t count;
+    
+    if((timer_ctl & TIMER_A_CTL_SSEL_MASK) != TIMER_A_CTL_SSEL__ACLK)
+        return TA0R;
+    do {
+        count = TA0R;
+    } while(count != TA0R);
+    return count;
+}
+
+#if FATE_LAXITY
+#ifdef FATE_HIRES
+/** Current time in Timer A0 counts (wraps around): the kernel's time unit already */
+#define current_time() current_tick()
+#else
+/**
+ *  Current time in Timer A0 counts (wraps around)
+ */
+static uint32_t current_time(void)
+{
+    return tick_count * tick_counts + (uint16_t)(timer_read() - tick_base);
+}
+#endif
+
+/**
+ *  Latest time the active job of a task can start and still meet its deadline,
+ *  if it needs its whole budget
+ */
+static inline void set_latest_start(task_ctrl_blk *task)
+{
+    uint32_t left = (task->budget > task->executed) ? (task->budget - task->executed) : 0;
+    
+    task->latest_start = TIME_COUNTS(task->absolute_deadline) - left;
+}
+
+/**
+ *  Charges the job on the CPU for the time since it was last charged, and moves it
+ *  back to its place in "slack_heap" (its latest start time moves later as it runs)
+ */
+static void charge_running(void)
+{
+    uint32_t now = current_time();
+    task_ctrl_blk *task = running_task;
+    
+    if(task != Task_list)
+    {
+        task->executed += now - charged_at;
+        if(task->slack_index != HEAP_NONE)
+        {
+            slack_remove(task);
+            set_latest_start(task);
+            slack_insert(task);
+        }
+    }
+    charged_at = now;
+}
+
+#if FATE_POLICY == FATE_POLICY_LLF
+/**
+ *  Returns 1 if the job on the CPU ("current_task", just charged) keeps it from
+ *  "waiting", the job with the least laxity besides it: while it has less laxity,
+ *  or, once they are tied or inverted, while it can finish before "waiting" must
+ *  start (no laxity inversion). Jobs of about the same laxity then run one after
+ *  the other, instead of taking turns. Past its budget, how long the job still
+ *  needs is unknown: it keeps the CPU while its laxity is not the higher.
+ */
+static uint8_t keeps_cpu(const task_ctrl_blk *waiting)
+{
+    uint32_t left = TIME_COUNTS(current_task->absolute_deadline) - current_task->latest_start;
+    int32_t ahead = (int32_t)(waiting->latest_start - current_task->latest_start);
+    int32_t wait = (int32_t)(waiting->latest_start - charged_at);
+    
+    if(!left)
+        return ahead >= 0;
+    if(ahead > 0)
+        return 1;
+    return (wait > 0) && ((uint32_t)wait >= left);
+}
+#endif
+
+#if defined(FATE_TICKLESS) || defined(FATE_HIRES)
+/**
+ *  Returns the job with the least laxity, other than "current_task" (0 if none)
+ */
+static task_ctrl_blk *least_laxity_waiting(void)
+{
+    if(!slack_count)
+        return (task_ctrl_blk *)0;
+    if(slack_heap[0] != current_task)
+        return slack_heap[0];
+    if(slack_count < 2)
+        return (task_ctrl_blk *)0;
+    if((slack_count > 2) && ((int32_t)(slack_heap[2]->latest_start - slack_heap[1]->latest_start) < 0))
+        return slack_heap[2];
+    return slack_heap[1];
+}
+
+/**
+ *  Time (see "current_time") by which the scheduler must run again for laxities
+ *  alone, with "current_task" on the CPU: when it has run long enough to lose
+ *  the least laxity (LLF), or else when the job with the least laxity besides it
+ *  must start. Returns 0 if there is no such time ahead.
+ */
+static uint8_t laxity_wakeup(uint32_t *at)
+{
+    task_ctrl_blk *waiting = least_laxity_waiting();
+    
+    if(!waiting)
+        return 0;
+#if FATE_POLICY == FATE_POLICY_LLF
+    if(current_task->slack_index != HEAP_NONE)
+    {
+        //Past its budget, its laxity no longer changes
+        if(current_task->latest_start == TIME_COUNTS(current_task->absolute_deadline))
+            return 0;
+        if((int32_t)(current_task->latest_start - waiting->latest_start) < 0)
+        {
+            *at = charged_at + (waiting->latest_start - current_task->latest_start);
+            return 1;
+        }
+    }
+#endif
+    *at = waiting->latest_start;
+    return (int32_t)(waiting->latest_start - charged_at) > 0;
+}
+#endif
+#endif
+
+#ifdef FATE_RESOURCES
+/**
+ *  Preemption level of a task, as a rank: the lower the rank, the higher the level
+ *  (fixed priorities: the priority rank; EDF: the relative deadline)
+ */
+static inline uint32_t preemption_rank(const task_ctrl_blk *task)
+{
+#if FATE_FIXED_PRIORITY
+    return task->rank;
+#else
+    return task->deadline;
+#endif
+}
+
+/**
+ *  Ceiling of a resource: the lowest preemption rank of the tasks that use it
+ */
+static uint32_t resource_ceiling(const resource_ctrl_blk *resource)
+{
+    uint32_t users = resource->users, ceiling = NO_CEILING, i;
+    
+    while(users)
+    {
+        i = __CLZ(users);
+        users &= ~((uint32_t)0x80000000 >> i);
+        if((Task_list[i].state != TASK_UNDEFINED) && (preemption_rank(&(Task_list[i])) < ceiling))
+            ceiling = preemption_rank(&(Task_list[i]));
+    }
+    return ceiling;
+}
+
+/**
+ *  Unlocks resource "resource", wherever it is in "locked_resources", and lowers
+ *  the system ceiling to the highest ceiling of those still locked
+ */
+static void resource_release(resource_ctrl_blk *resource)
+{
+    resource_ctrl_blk **link = &locked_resources, *locked;
+    
+    while(*link != resource)
+        link = &((*link)->below);
+    *link = resource->below;
+    resource->holder = (task_ctrl_blk *)0;
+    
+    system_ceiling = NO_CEILING;
+    for(locked = locked_resources; locked; locked = locked->below)
+    {
+        if(locked->ceiling < system_ceiling)
+            system_ceiling = locked->ceiling;
+    }
+}
+
+/**
+ *  Removes a job from "started_jobs", if it is in it
+ */
+static void started_remove(task_ctrl_blk *task)
+{
+    uint32_t i;
+    
+    for(i=0;(i<started_count) && (started_jobs[i] != task);i++);
+    if(i == started_count)
+        return;
+    for(i++;i<started_count;i++)
+        started_jobs[i - 1] = started_jobs[i];
+    started_count--;
+}
+#endif
+
+/**
+ *  Adds an active task to the set the scheduler picks from
+ *  (under EDF, that is "deadline_heap", which the caller adds it to)
+ */
+static inline void ready_set(task_ctrl_blk *task)
+{
+#if FATE_FIXED_PRIORITY
+    ready_tasks |= (uint32_t)0x80000000 >> task->rank;
+#elif FATE_LAXITY
+    task->executed = 0;
+    set_latest_start(task);
+    slack_insert(task);
+#else
+    (void)task;
+#endif
+}
+
+/**
+ *  Returns a pointer to the "Task_list" entry of the highest priority active task
+ *  (a Task is active if it is in Running or Suspended states)
+ *
+ *  Fixed priorities: active tasks are in "ready_tasks", by rank.
+ *  EDF, LLF and EDZL: active tasks are all either in "expired_tasks" (deadline
+ *  already passed) or in "deadline_heap" (in EDF order), and in "slack_heap"
+ *  (least laxity first) for LLF and EDZL.
+ *  Cyclic executive: the task of the last table entry, if its job is active;
+ *  otherwise the others, as under EDF.
+ *  In every case, this does not scan "Task_list".
+ */
+#ifdef FATE_RESOURCES
+static inline task_ctrl_blk *highest_priority_task(void)
+#else
+static inline task_ctrl_blk *get_priority_task(void)
+#endif
+{
+#if FATE_FIXED_PRIORITY
+#ifdef FATE_PREEMPTION_THRESHOLD
+    task_ctrl_blk *started;
+    
+    //A started job keeps the CPU from every task not above its threshold
+    if(started_tasks)
+    {
+        started = ranked_tasks[__CLZ(started_tasks)];
+        if(__CLZ(ready_tasks) >= started->threshold_rank)
+            return started;
+    }
+#endif
+    if(ready_tasks)
+        return ranked_tasks[__CLZ(ready_tasks)];
+#else
+#if FATE_POLICY == FATE_POLICY_CYCLIC
+    //The table's task, whenever its job is active: other jobs only get its slack
+    if((slot_task != Task_list) && (slot_task->state != TASK_STOPPED))
+        return slot_task;
+#endif
+    if(expired_tasks)
+        return Task_list + __CLZ(expired_tasks);
+#if FATE_POLICY == FATE_POLICY_LLF
+    if(slack_count)
+    {
+        //The job on the CPU keeps it until there is a laxity inversion
+        if((current_task->slack_index != HEAP_NONE) &&
+           ((current_task == slack_heap[0]) || keeps_cpu(slack_heap[0])))
+            return current_task;
+        return slack_heap[0];
+    }
+#elif FATE_POLICY == FATE_POLICY_EDZL
+    //A job with no laxity left goes ahead of the EDF order
+    if(slack_count && ((int32_t)(slack_heap[0]->latest_start - charged_at) <= 0))
+        return slack_heap[0];
+#endif
+    if(deadline_count)
+        return deadline_heap[0];
+#endif
+    return Task_list;
+}
+
+#ifdef FATE_RESOURCES
+/**
+ *  Returns pointer to the job to run under the Stack Resource Policy: the highest
+ *  priority active task, unless its job has not started and its preemption level
+ *  is not above the system ceiling; then the highest priority started job runs
+ *  (the one holding the resource, or one that preempted it)
+ */
+static inline task_ctrl_blk *get_priority_task(void)
+{
+    task_ctrl_blk *task = highest_priority_task();
+    
+    if(!task->sp && (task != Task_list) && (preemption_rank(task) >= system_ceiling))
+        return started_count ? started_jobs[started_count - 1] : Task_list;
+    return task;
+}
+#endif
+
+#ifdef FATE_ADMISSION
+/** Utilization of 100%, in the fixed point format of "task_set_schedulable" */
+#define FULL_UTILIZATION ((uint64_t)1 << 20)
+
+/**
+ *  Period and relative deadline of a task for the analysis, in microseconds
+ *  (for aperiodic tasks, the period is the minimum time between events)
+ */
+static uint64_t analysis_period(const task_ctrl_blk *task)
+{
+    return TIME_US(task->period ? task->period : task->interarrival);
+}
+
+static uint64_t analysis_deadline(const task_ctrl_blk *task)
+{
+    return TIME_US(task->deadline);
+}
+
+#ifdef FATE_RESOURCES
+/**
+ *  Longest a job of preemption rank "rank" can be blocked, in microseconds: the longest
+ *  critical section of a task of a lower level on a resource with a ceiling at or
+ *  above "rank" (under EDF, ranks are relative deadlines, in ticks or FATE_HIRES counts)
+ */
+static uint64_t resource_blocking(uint32_t rank)
+{
+    uint64_t blocking = 0;
+    uint32_t ceiling;
+    int k, i;
+    
+    for(k=0;k<NUM_RESOURCES;k++)
+    {
+        ceiling = resource_ceiling(&(resources[k]));
+        if(ceiling > rank)
+            continue;
+        for(i=1;i<NUM_TASKS;i++)
+        {
+            if((Task_list[i].state != TASK_UNDEFINED) && (preemption_rank(&(Task_list[i])) > rank) &&
+               (resources[k].length[i] > blocking))
+                blocking = resources[k].length[i];
+        }
+    }
+    return blocking;
+}
+#endif
+
+#if FATE_FIXED_PRIORITY
+#ifdef FATE_PREEMPTION_THRESHOLD
+/**
+ *  Admission test: returns 1 if no job misses its deadline under fixed priorities
+ *  with preemption thresholds
+ *
+ *  Response time analysis of Wang and Saksena, tasks released at once, right after
+ *  the longest job of a lower ranked task with a threshold at or above the task's
+ *  rank has started, or (FATE_RESOURCES) the longest critical section that can
+ *  block it has begun (blocking B). Job q of the busy period starts by
+ *    S = B + q * C + sum over higher ranked tasks j of (floor(S / T_j) + 1) * C_j
+ *  and, once started, is only preempted by tasks ranked above its threshold:
+ *    F = S + C + sum over those tasks j of (ceil(F / T_j) - floor(S / T_j) - 1) * C_j
+ *  F - q * T must not exceed the deadline, nor the period. The busy period ends
+ *  with the first job that finishes before the next release.
+ */
+static uint8_t task_set_schedulable(void)
+{
+    uint64_t limit, blocking, utilization = 0, start, finish, next, period, q;
+    uint32_t r, j;
+    task_ctrl_blk *task;
+    
+    for(r=0;r<ranked_count;r++)
+    {
+        task = ranked_tasks[r];
+        //The busy period would never end
+        utilization += ((uint64_t)task->wcet << 20) / analysis_period(task);
+        if(utilization >= FULL_UTILIZATION)
+            return 0;
+        limit = analysis_deadline(task);
+        if(analysis_period(task) < limit)
+            limit = analysis_period(task);
+        blocking = 0;
+        for(j=r+1;j<ranked_count;j++)
+        {
+            if((ranked_tasks[j]->threshold_rank <= r) && (ranked_tasks[j]->wcet > blocking))
+                blocking = ranked_tasks[j]->wcet;
+        }
+#ifdef FATE_RESOURCES
+        //Or by a critical section: a job is only ever blocked once
+        if(resource_blocking(r) > blocking)
+            blocking = resource_blocking(r);
+#endif
+        for(q=0;;q++)
+        {
+            start = blocking + q * task->wcet;
+            do {
+                next = blocking + q * task->wcet;
+                for(j=0;j<r;j++)
+                {
+                    period = analysis_period(ranked_tasks[j]);
+                    next += (start / period + 1) * ranked_tasks[j]->wcet;
+                }
+                if(next == start)
+                    break;
+                start = next;
+            } while(start - q * analysis_period(task) <= limit);
+            finish = start + task->wcet;
+            while(finish - q * analysis_period(task) <= limit)
+            {
+                next = start + task->wcet;
+                for(j=0;j<task->threshold_rank;j++)
+                {
+                    period = analysis_period(ranked_tasks[j]);
+                    next += ((finish + period - 1) / period - start / period - 1) * ranked_tasks[j]->wcet;
+                }
+                if(next == finish)
+                    break;
+                finish = next;
+            }
+            if(finish - q * analysis_period(task) > limit)
+                return 0;
+            if(finish <= (q + 1) * analysis_period(task))
+                break;
+        }
+    }
+    return 1;
+}
+#else
+/**
+ *  Admission test: returns 1 if no job misses its deadline under fixed priorities
+ *
+ *  Response time analysis, tasks released at once (the worst case):
+ *  R = C + B + sum over higher ranked tasks j of ceil(R / T_j) * C_j, iterated until
+ *  it stops changing, B being the longest critical section that can block the task
+ *  (FATE_RESOURCES, 0 otherwise). It must not exceed the deadline, nor the period (a task still
+ *  active when it is released again skips that release).
+ */
+static uint8_t task_set_schedulable(void)
+{
+    uint64_t limit, response, next, period, blocking;
+    uint32_t r, j;
+    task_ctrl_blk *task;
+    
+    for(r=0;r<ranked_count;r++)
+    {
+        task = ranked_tasks[r];
+        limit = analysis_deadline(task);
+        if(analysis_period(task) < limit)
+            limit = analysis_period(task);
+#ifdef FATE_RESOURCES
+        blocking = resource_blocking(r);
+#else
+        blocking = 0;
+#endif
+        response = task->wcet + blocking;
+        while(response <= limit)
+        {
+            next = task->wcet + blocking;
+            for(j=0;j<r;j++)
+            {
+                period = analysis_period(ranked_tasks[j]);
+                next += (response + period - 1) / period * ranked_tasks[j]->wcet;
+            }
+            if(next == response)
+                break;
+            response = next;
+        }
+        if(response > limit)
+            return 0;
+    }
+    return 1;
+}
+#endif
+#else
+
+#ifdef FATE_RESOURCES
+/**
+ *  Longest critical section of any task, in microseconds
+ */
+static uint64_t longest_critical_section(void)
+{
+    uint64_t longest = 0;
+    int k, i;
+    
+    for(k=0;k<NUM_RESOURCES;k++)
+    {
+        for(i=1;i<NUM_TASKS;i++)
+        {
+            if((Task_list[i].state != TASK_UNDEFINED) && (resources[k].length[i] > longest))
+                longest = resources[k].length[i];
+        }
+    }
+    return longest;
+}
+#endif
+
+/**
+ *  Processor demand in [0, t], in microseconds: the execution time of every job
+ *  released and due in it, with every task released at time 0, plus (FATE_RESOURCES)
+ *  the longest critical section of a job due later that can hold those back
+ */
+static uint64_t processor_demand(uint64_t t)
+{
+    uint64_t demand = 0, deadline;
+    int i;
+    
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        if(Task_list[i].state == TASK_UNDEFINED)
+            continue;
+        deadline = analysis_deadline(&(Task_list[i]));
+        if(t >= deadline)
+            demand += ((t - deadline) / analysis_period(&(Task_list[i])) + 1) * Task_list[i].wcet;
+    }
+#ifdef FATE_RESOURCES
+    demand += resource_blocking((uint32_t)US_TIME(t));
+#endif
+    return demand;
+}
+
+/**
+ *  Latest absolute deadline of any job before t (0 if there is none),
+ *  with every task released at time 0
+ */
+static uint64_t deadline_before(uint64_t t)
+{
+    uint64_t latest = 0, deadline, period;
+    int i;
+    
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        if(Task_list[i].state == TASK_UNDEFINED)
+            continue;
+        deadline = analysis_deadline(&(Task_list[i]));
+        period = analysis_period(&(Task_list[i]));
+        if(t > deadline)
+        {
+            deadline += (t - deadline - 1) / period * period;
+            if(deadline > latest)
+                latest = deadline;
+        }
+    }
+    return latest;
+}
+
+/**
+ *  Admission test: returns 1 if no job misses its deadline under EDF
+ *
+ *  Start offsets are ignored: releasing every task at once is the worst case.
+ *  The task set is schedulable if the processor demand in [0, t] never exceeds t,
+ *  for every absolute deadline t up to the end of the first busy period (or up to
+ *  the bound derived from the utilization, if shorter). QPA (Zhang & Burns) checks
+ *  them from the last one down, jumping straight to t = demand(t) whenever the
+ *  demand is below t, so only a few deadlines are ever looked at.
+ */
+static uint8_t task_set_schedulable(void)
+{
+    uint64_t period, deadline, utilization = 0, excess = 0, limit = UINT64_MAX;
+    uint64_t busy = 0, next, t, demand, shortest = UINT64_MAX, longest = 0, blocking = 0;
+    int i;
+    
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        if(Task_list[i].state == TASK_UNDEFINED)
+            continue;
+        period = analysis_period(&(Task_list[i]));
+        deadline = analysis_deadline(&(Task_list[i]));
+        if(period == 0)
+            return 0;
+        //Rounded up, so a task set reported under 100% really is
+        utilization += ((uint64_t)Task_list[i].wcet * FULL_UTILIZATION + period - 1) / period;
+        if(period > deadline)
+            excess += ((period - deadline) * Task_list[i].wcet + period - 1) / period;
+        busy += Task_list[i].wcet;
+        if(deadline < shortest)
+            shortest = deadline;
+        if(deadline > longest)
+            longest = deadline;
+    }
+    if(utilization > FULL_UTILIZATION)
+        return 0;
+    if(busy == 0)
+        return 1;
+#ifdef FATE_RESOURCES
+    //A critical section can begin right before the synchronous release
+    blocking = longest_critical_section();
+    excess += blocking;
+    busy += blocking;
+#endif
+    
+    //Below 100%, demand cannot exceed t past max(longest deadline, excess / (1 - utilization))
+    if(utilization < FULL_UTILIZATION)
+    {
+        limit = excess * FULL_UTILIZATION / (FULL_UTILIZATION - utilization);
+        if(limit < longest)
+            limit = longest;
+    }
+    //First busy period: w = sum of ceil(w / period) * wcet, until it stops growing
+    while(busy < limit)
+    {
+        next = blocking;
+        for(i=1;i<NUM_TASKS;i++)
+        {
+            if(Task_list[i].state == TASK_UNDEFINED)
+                continue;
+            period = analysis_period(&(Task_list[i]));
+            next += (busy + period - 1) / period * Task_list[i].wcet;
+        }
+        if(next == busy)
+            break;
+        busy = next;
+    }
+    if(busy > limit)
+        busy = limit;
+    
+    //QPA
+    t = deadline_before(busy + 1);
+    demand = processor_demand(t);
+    while((demand <= t) && (demand > shortest))
+    {
+        if(demand < t)
+            t = demand;
+        else
+            t = deadline_before(t);
+        demand = processor_demand(t);
+    }
+    return demand <= shortest;
+}
+#endif
+#endif
+
+/**
+ *  Adds a periodic task, with its times in the kernel's time unit (see "TICKS"),
+ *  first released "release" after the scheduler starts
+ */
+static uint8_t periodic_add(intptr_t function, uint32_t period, uint32_t start_offset,
+                            uint32_t release, uint32_t deadline, uint32_t priority, uint32_t wcet)
+{
+    int i;
+    for(i = 1; (i<NUM_TASKS) && (Task_list[i].state != TASK_UNDEFINED); i++);
+    if (i < NUM_TASKS)
+    {
+        Task_list[i].state = TASK_STOPPED;
+        Task_list[i].function = function;
+        Task_list[i].period = period;
+        Task_list[i].start_offset = start_offset;
+        Task_list[i].deadline = deadline;
+#if FATE_POLICY == FATE_POLICY_FP
+        Task_list[i].priority = priority;
+#else
+        (void)priority;
+#endif
+#if FATE_FIXED_PRIORITY
+        rank_tasks();
+#endif
+#ifndef FATE_ADMISSION
+        (void)wcet;
+#else
+        Task_list[i].wcet = wcet;
+        Task_list[i].interarrival = 0;
+#if FATE_LAXITY
+        //First budget, until longer jobs are measured
+        Task_list[i].budget = (uint32_t)((uint64_t)wcet * timer_hz / 1000000);
+#endif
+        if((period == 0) || !task_set_schedulable())
+        {
+            Task_list[i].state = TASK_UNDEFINED;
+#if FATE_FIXED_PRIORITY
+            rank_tasks();
+#endif
+            return 2;
+        }
+#endif
+#if FATE_POLICY != FATE_POLICY_CYCLIC
+        timer_insert(&release_queue, &(Task_list[i].release_timer), release);
+#else
+        //The cyclic executive's table releases tasks instead
+        (void)release;
+#endif
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ *  Adds an aperiodic task, with its times in the kernel's time unit (see "TICKS")
+ */
+static uint8_t aperiodic_add(intptr_t function, enum events event, uint32_t deadline,
+                             uint32_t priority, uint32_t wcet, uint32_t interarrival)
+{
+    int i, e;
+    
+    //Each event activates one task
+    if(((uint32_t)event >= EVENT_SOURCES) || event_slot[event])
+        return 1;
+    for(e = 0; (e<NUM_EVENTS) && Event_task_list[e].task; e++);
+    for(i = 1; (i<NUM_TASKS) && (Task_list[i].state != TASK_UNDEFINED); i++);
+    if ((i < NUM_TASKS) && (e < NUM_EVENTS))
+    {
+        Task_list[i].state = TASK_STOPPED;
+        Task_list[i].function = function;
+        //For aperiodic tasks: period set as 0 (never in the release queue)
+        Task_list[i].period = 0;
+        Task_list[i].start_offset = 0;
+        Task_list[i].deadline = deadline;
+#if FATE_POLICY == FATE_POLICY_FP
+        Task_list[i].priority = priority;
+#else
+        (void)priority;
+#endif
+#if FATE_FIXED_PRIORITY
+        rank_tasks();
+#endif
+#ifndef FATE_ADMISSION
+        (void)wcet;
+        (void)interarrival;
+#else
+        Task_list[i].wcet = wcet;
+        Task_list[i].interarrival = interarrival;
+#if FATE_LAXITY
+        //First budget, until longer jobs are measured
+        Task_list[i].budget = (uint32_t)((uint64_t)wcet * timer_hz / 1000000);
+#endif
+        if((interarrival == 0) || !task_set_schedulable())
+        {
+            Task_list[i].state = TASK_UNDEFINED;
+#if FATE_FIXED_PRIORITY
+            rank_tasks();
+#endif
+            return 2;
+        }
+#endif
+        
+        //Configure Device and Interrupt for corresponding event
+        Enable_event(event);
+        
+        //Set pointer to newly configured task in event-task list
+        Event_task_list[e].task = &(Task_list[i]);
+        Event_task_list[e].source = (uint8_t)event;
+        Task_list[i].event = &(Event_task_list[e]);
+        event_slot[event] = (uint8_t)(e + 1);
+        
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ *  Called by application code (main) to setup periodic tasks
+ *  Requires pointer to the function that implements the task, as
+ *  well as its period, start offset and deadline (in system ticks, 10ms by default),
+ *  and its priority (FATE_POLICY_FP only)
+ */
+#ifdef FATE_ADMISSION
+uint8_t Task_add(intptr_t function, uint32_t period, uint32_t start_offset,
+                 uint32_t deadline, uint32_t priority, uint32_t wcet)
+#else
+uint8_t Task_add(intptr_t function, uint32_t period, uint32_t start_offset,
+                 uint32_t deadline, uint32_t priority)
+#endif
+{
+#ifndef FATE_ADMISSION
+    uint32_t wcet = 0;
+#endif
+    
+    //First released on the tick after the start offset expires
+    return periodic_add(function, TICKS(period), TICKS(start_offset), TICKS(start_offset + 1),
+                        TICKS(deadline), priority, wcet);
+}
+
+
+/**
+ *  Called by application code (main) to setup aperiodic tasks
+ *  Requires pointer to the function that implements the task, as
+ *  well as its triggering event, deadline and priority (FATE_POLICY_FP only)
+ *
+ *  Supported events are in "fate.h", defined in "enum events"
+ */
+#ifdef FATE_ADMISSION
+uint8_t Task_event_add(intptr_t function, enum events event, uint32_t deadline,
+                       uint32_t priority, uint32_t wcet, uint32_t interarrival)
+#else
+uint8_t Task_event_add(intptr_t function, enum events event, uint32_t deadline,
+                       uint32_t priority)
+#endif
+{
+#ifndef FATE_ADMISSION
+    uint32_t wcet = 0, interarrival = 0;
+#endif
+    
+    return aperiodic_add(function, event, TICKS(deadline), priority, wcet, TICKS(interarrival));
+}
+
+/**
+ *  Converts a time in microseconds to the kernel's time unit (see "TICKS"),
+ *  rounded to the nearest
+ *
+ *  @return 0 if converted (3 if it does not fit, or is off by more than TIME_TOLERANCE)
+ */
+static uint8_t us_time(uint64_t us, uint32_t *time)
+{
+    uint64_t unit = (uint64_t)TIME_COUNTS(1) * 1000000;
+    uint64_t scaled, units, diff;
+    
+    if(us > (UINT64_MAX - unit) / timer_hz)
+        return 3;
+    //In microseconds times counts per second, and in time units of that
+    scaled = us * timer_hz;
+    units = (scaled + unit / 2) / unit;
+    diff = (units * unit > scaled) ? (units * unit - scaled) : (scaled - units * unit);
+    if((units > UINT32_MAX) || (diff > scaled / 1000 * TIME_TOLERANCE))
+        return 3;
+    *time = (uint32_t)units;
+    return 0;
+}
+
+/**
+ *  Adds a periodic task with its times in microseconds
+ */
+static uint8_t periodic_add_us(intptr_t function, uint64_t period, uint64_t start_offset,
+                               uint64_t deadline, uint32_t priority, uint32_t wcet)
+{
+    uint32_t time_period, time_offset, time_deadline;
+    
+    if(us_time(period, &time_period) || us_time(start_offset, &time_offset) ||
+       us_time(deadline, &time_deadline))
+        return 3;
+#ifdef FATE_HIRES
+    return periodic_add(function, time_period, time_offset, time_offset,
+                        time_deadline, priority, wcet);
+#else
+    //First released on the tick after the start offset expires, as by "Task_add"
+    return periodic_add(function, time_period, time_offset, time_offset + 1,
+                        time_deadline, priority, wcet);
+#endif
+}
+
+/**
+ *  Adds an aperiodic task with its times in microseconds
+ */
+static uint8_t aperiodic_add_us(intptr_t function, enum events event, uint64_t deadline,
+                                uint32_t priority, uint32_t wcet, uint64_t interarrival)
+{
+    uint32_t time_deadline, time_interarrival;
+    
+    if(us_time(deadline, &time_deadline) || us_time(interarrival, &time_interarrival))
+        return 3;
+    return aperiodic_add(function, event, time_deadline, priority, wcet, time_interarrival);
+}
+
+/**
+ *  Sets up a periodic task with its times in microseconds (see "fate.h")
+ */
+#ifdef FATE_ADMISSION
+uint8_t Task_add_us(intptr_t function, uint32_t period, uint32_t start_offset,
+                    uint32_t deadline, uint32_t priority, uint32_t wcet)
+#else
+uint8_t Task_add_us(intptr_t function, uint32_t period, uint32_t start_offset,
+                    uint32_t deadline, uint32_t priority)
+#endif
+{
+#ifndef FATE_ADMISSION
+    uint32_t wcet = 0;
+#endif
+    
+    return periodic_add_us(function, period, start_offset, deadline, priority, wcet);
+}
+
+/**
+ *  Sets up a periodic task with its times in milliseconds (see "fate.h")
+ */
+#ifdef FATE_ADMISSION
+uint8_t Task_add_ms(intptr_t function, uint32_t period, uint32_t start_offset,
+                    uint32_t deadline, uint32_t priority, uint32_t wcet)
+#else
+uint8_t Task_add_ms(intptr_t function, uint32_t period, uint32_t start_offset,
+                    uint32_t deadline, uint32_t priority)
+#endif
+{
+#ifndef FATE_ADMISSION
+    uint32_t wcet = 0;
+#endif
+    
+    return periodic_add_us(function, (uint64_t)period * 1000, (uint64_t)start_offset * 1000,
+                           (uint64_t)deadline * 1000, priority, wcet);
+}
+
+/**
+ *  Sets up an aperiodic task with its times in microseconds (see "fate.h")
+ */
+#ifdef FATE_ADMISSION
+uint8_t Task_event_add_us(intptr_t function, enum events event, uint32_t deadline,
+                          uint32_t priority, uint32_t wcet, uint32_t interarrival)
+#else
+uint8_t Task_event_add_us(intptr_t function, enum events event, uint32_t deadline,
+                          uint32_t priority)
+#endif
+{
+#ifndef FATE_ADMISSION
+    uint32_t wcet = 0, interarrival = 0;
+#endif
+    
+    return aperiodic_add_us(function, event, deadline, priority, wcet, interarrival);
+}
+
+/**
+ *  Sets up an aperiodic task with its times in milliseconds (see "fate.h")
+ */
+#ifdef FATE_ADMISSION
+uint8_t Task_event_add_ms(intptr_t function, enum events event, uint32_t deadline,
+                          uint32_t priority, uint32_t wcet, uint32_t interarrival)
+#else
+uint8_t Task_event_add_ms(intptr_t function, enum events event, uint32_t deadline,
+                          uint32_t priority)
+#endif
+{
+#ifndef FATE_ADMISSION
+    uint32_t wcet = 0, interarrival = 0;
+#endif
+    
+    return aperiodic_add_us(function, event, (uint64_t)deadline * 1000, priority, wcet,
+                            (uint64_t)interarrival * 1000);
+}
+
+
+/**
+ *  Configures Device and Interrupt for corresponding event
+ *  Called by "Task_event_add" to setup event for aperiodic tasks
+ */
+void Enable_event(enum events event)
+{
+    const port_regs *port;
+    uint8_t bit;
+    
+    //Software events need no configuration
+    if(event >= EVENT_SOFTWARE(0))
+        return;
+    
+    port = &(ports[event / 8]);
+    bit = (uint8_t)(1 << (event % 8));
+    
+    //Configure Pin as GPIO
+    *port->sel0 &= (uint8_t)(~bit);
+    *port->sel1 &= (uint8_t)(~bit);
+    //Configure Pin as input
+    *port->dir &= (uint8_t)(~bit);
+    //Enable internal resistors
+    *port->ren |= bit;
+    //Configure pull-up resistors
+    *port->out |= bit;
+    //Configure negative edge (active low switches)
+    *port->ies |= bit;
+    //Changing the edge may set the flag: clear it, then enable pin interrupt
+    *port->ifg &= (uint8_t)(~bit);
+    *port->ie |= bit;
+    
+    //Enable Port interrupt in NVIC
+    //Equal priority as timer interrupt
+    //We don't want anything interrupting our scheduler
+    //since we are manipulating the task lists, bad things could happen
+    //also, scheduler has to be precise, or we drift out of time
+    NVIC_EnableIRQ((IRQn_Type)(PORT1_IRQn + event / 8));
+    NVIC_SetPriority((IRQn_Type)(PORT1_IRQn + event / 8), 2);
+}
+
+
+/**
+ *  Lets an active job carry on past its deadline: under EDF, ahead of the others
+ *  (fixed priorities: at its own priority, in "ready_tasks" already)
+ */
+static inline void expire_deadline(task_ctrl_blk *task)
+{
+#if FATE_FIXED_PRIORITY
+    (void)task;
+#else
+#if FATE_LAXITY
+    slack_remove(task);
+#endif
+    expired_tasks |= (uint32_t)0x80000000 >> (task - Task_list);
+#endif
+}
+
+/**
+ *  Starts a new job of a task, due on system tick "deadline" ("now" is the current tick)
+ */
+static void start_job(task_ctrl_blk *task, uint32_t deadline, uint32_t now)
+{
+    task->state = TASK_SUSPENDED;
+    //A new job starts from the beginning of the task function
+    task->sp = (uint32_t *)0;
+    task->absolute_deadline = deadline;
+    ready_set(task);
+    if(deadline_reached(deadline, now))
+        deadline_missed(task);
+    else
+        deadline_insert(task);
+}
+
+/**
+ *  Releases a task: sets it as SUSPENDED (active) if it was STOPPED,
+ *  with a deadline relative to the tick the release was due on.
+ *  "late" is the number of system ticks since the release was due.
+ *  The release is skipped if the task is still active, or if its last job
+ *  overran with OVERRUN_SKIP.
+ */
+static void release_task(task_ctrl_blk *task, uint32_t now, uint32_t late)
+{
+    uint8_t skip = task->skip_release;
+    
+    task->skip_release = 0;
+    if((task->state != TASK_STOPPED) || skip)
+    {
+        TRACE(TRACE_RELEASE, task, 1);
+        return;
+    }
+    TRACE(TRACE_RELEASE, task, 0);
+    start_job(task, now - late + task->deadline, now);
+}
+
+/**
+ *  Starts a new job of an aperiodic task (the scheduler runs right after the event ISR),
+ *  with a deadline relative to "activated", the tick the event happened on
+ */
+static void activate_task(task_ctrl_blk *task, uint32_t activated)
+{
+    start_job(task, activated + task->deadline, current_tick());
+}
+
+/**
+ *  Removes a task whose job is over from the scheduler's ordering
+ */
+static void retire_task(task_ctrl_blk *task)
+{
+#ifdef FATE_RESOURCES
+    int i;
+    
+#endif
+    deadline_remove(task);
+#if FATE_LAXITY
+    slack_remove(task);
+    //The budget is the longest job measured
+    if(task->executed > task->budget)
+        task->budget = task->executed;
+#endif
+#if FATE_FIXED_PRIORITY
+    ready_tasks &= ~((uint32_t)0x80000000 >> task->rank);
+#ifdef FATE_PREEMPTION_THRESHOLD
+    started_tasks &= ~((uint32_t)0x80000000 >> task->rank);
+#endif
+#else
+    expired_tasks &= ~((uint32_t)0x80000000 >> (task - Task_list));
+#endif
+#ifdef FATE_RESOURCES
+    started_remove(task);
+    //Resources the job still holds are unlocked
+    for(i=0;i<NUM_RESOURCES;i++)
+    {
+        if(resources[i].holder == task)
+            resource_release(&(resources[i]));
+    }
+#endif
+}
+
+/**
+ *  Handles an active job that has reached its deadline (and has left "deadline_heap"):
+ *  counts the miss, calls the miss handler, and applies the task's overrun policy
+ */
+static void deadline_missed(task_ctrl_blk *task)
+{
+    TRACE(TRACE_DEADLINE_MISS, task, task->overrun);
+    task->misses++;
+    if(miss_handler)
+        miss_handler(task->function);
+    
+    switch(task->overrun)
+    {
+        case OVERRUN_ABORT:
+            //Dropped as if it had stopped itself (if it is on the CPU, the scheduler
+            //switches away and "switch_context" discards its context)
+            retire_task(task);
+            task->state = TASK_STOPPED;
+            if(task->event)
+                event_served(task->event);
+            break;
+        case OVERRUN_SKIP:
+            task->skip_release = 1;
+            expire_deadline(task);
+            break;
+        default:
+            expire_deadline(task);
+            break;
+    }
+}
+
+#if FATE_POLICY == FATE_POLICY_CYCLIC
+/**
+ *  Steps through the dispatch table entries due in the "ticks" system ticks up to
+ *  tick "now": releases their tasks, and gives the CPU to the last one's
+ */
+static void cyclic_advance(uint32_t ticks, uint32_t now)
+{
+    const cyclic_entry *entry;
+    
+    if(!cyclic_entries)
+        return;
+    while(ticks >= cyclic_wait)
+    {
+        ticks -= cyclic_wait;
+        entry = &(cyclic_table[cyclic_next]);
+        slot_task = &(Task_list[entry->task]);
+        if(entry->action == CYCLIC_RELEASE)
+            release_task(slot_task, now, ticks);
+        //Ticks to the next entry, which may be the first one of the next cycle
+        if(++cyclic_next == cyclic_entries)
+        {
+            cyclic_next = 0;
+            cyclic_wait = TICKS(cyclic_length - entry->tick + cyclic_table[0].tick);
+        }
+        else
+            cyclic_wait = TICKS(cyclic_table[cyclic_next].tick - entry->tick);
+    }
+    cyclic_wait -= ticks;
+}
+#endif
+
+/**
+ *  Moves the 64 bit time on by "ticks" (FATE_HIRES: Timer A0 counts), in the copy
+ *  readers are not directed to, then directs them to it
+ */
+static inline void time_advance(uint32_t ticks)
+{
+    uint32_t seq = time_seq + 1;
+    
+    time_copies[seq & 1].time = time_copies[(seq - 1) & 1].time + ticks;
+    time_copies[seq & 1].base = tick_base;
+    //The copy is whole before readers are directed to it
+    __DMB();
+    time_seq = seq;
+}
+
+#ifdef FATE_TRACE
+/**
+ *  Traces "ticks" elapsed system ticks (FATE_HIRES: Timer A0 counts), added to
+ *  those since the last TRACE_TICK record, as one record, but only if a release
+ *  or a deadline falls due in them: a record of every tick would crowd the rest
+ *  out of the ring buffer
+ */
+static void trace_tick(uint32_t ticks)
+{
+    uint8_t due = (release_queue && (release_queue->delta <= ticks)) ||
+                  (deadline_count && deadline_reached(deadline_heap[0]->absolute_deadline, tick_count + ticks));
+#if FATE_POLICY == FATE_POLICY_CYCLIC
+    due = due || (cyclic_entries && (ticks >= cyclic_wait));
+#endif
+    
+    trace_ticks += ticks;
+    if(!due)
+        return;
+    TRACE(TRACE_TICK, Task_list, (trace_ticks > 0xFFFF) ? 0xFFFF : trace_ticks);
+    trace_ticks = 0;
+}
+#endif
+
+/**
+ *  Brings every task up to date after "ticks" system ticks have elapsed
+ *  (FATE_HIRES: Timer A0 counts)
+ *
+ *  Only the release and deadline events that fall due are touched: jobs still active
+ *  at their deadline leave the top of "deadline_heap" as misses, and due tasks are
+ *  released and queued again one period later.
+ */
+static void advance_ticks(uint32_t ticks)
+{
+    timer_node *node, *next;
+    task_ctrl_blk *task;
+    uint32_t now = tick_count + ticks;
+    
+    while(deadline_count && deadline_reached(deadline_heap[0]->absolute_deadline, now))
+    {
+        task = deadline_heap[0];
+        deadline_remove(task);
+        deadline_missed(task);
+    }
+    
+    for(node = timer_expire(&release_queue, ticks); node; node = next)
+    {
+        next = node->next;
+        task = node->task;
+        release_task(task, now, node->delta);
+        //Queue the next release, one period after this one was due
+        timer_insert(&release_queue, node, task->period - (node->delta % task->period));
+    }
+#if FATE_POLICY == FATE_POLICY_CYCLIC
+    cyclic_advance(ticks, now);
+#endif
+    
+    tick_count = now;
+#ifndef FATE_HIRES
+    tick_base = (uint16_t)(tick_base + ticks * tick_counts);
+#endif
+    time_advance(ticks);
+}
+
+/**
+ *  Current time in system ticks (FATE_HIRES: Timer A0 counts): "tick_count",
+ *  and the 16 bit counter's progress since "tick_base" (less than 2^16 counts ago,
+ *  the scheduler never sleeping longer than "MAX_SLEEP")
+ */
+static uint32_t current_tick(void)
+{
+    return tick_count + COUNTS_TIME((uint16_t)(timer_read() - tick_base));
+}
+
+/**
+ *  Time since "Task_schedule" in Timer A0 counts
+ */
+static uint64_t time_counts(void)
+{
+    uint32_t seq;
+    uint64_t time;
+    uint16_t base, count;
+    
+    do {
+        seq = time_seq;
+        __DMB();
+        time = time_copies[seq & 1].time;
+        base = time_copies[seq & 1].base;
+        count = timer_read();
+        __DMB();
+    } while(seq != time_seq);
+    return TIME_COUNTS(time) + (uint16_t)(count - base);
+}
+
+/**
+ *  Reads the time since "Task_schedule" in system ticks (see "fate.h")
+ */
+uint64_t Time_ticks(void)
+{
+    return time_counts() / tick_counts;
+}
+
+/**
+ *  Reads the time since "Task_schedule" in microseconds (see "fate.h")
+ *  Whole seconds are converted apart from the rest, so that long times do not overflow.
+ */
+uint64_t Time_us(void)
+{
+    uint64_t counts = time_counts();
+    
+    return counts / timer_hz * 1000000 + counts % timer_hz * 1000000 / timer_hz;
+}
+
+/**
+ *  Reads the number of ticks the scheduler caught up late (see "fate.h")
+ */
+uint32_t Time_missed_ticks(void)
+{
+    return missed_ticks;
+}
+
+/**
+ *  Records an activation of an event's task: starts a job if the task is not active,
+ *  otherwise queues the activation until the jobs before it are served
+ */
+static void event_activate(event_ctrl_blk *event)
+{
+    if(event->pending == EVENT_QUEUE_SIZE)
+    {
+        TRACE(TRACE_EVENT_LOST, event->task, event->source);
+        event->lost++;
+        return;
+    }
+    TRACE(TRACE_EVENT, event->task, event->source);
+    event->timestamp[(event->head + event->pending) % EVENT_QUEUE_SIZE] = current_tick();
+    if(!event->pending++)
+        activate_task(event->task, event->timestamp[event->head]);
+}
+
+/**
+ *  Called when a job of an aperiodic task stops: the next pending activation,
+ *  if any, starts a new job right away
+ */
+static void event_served(event_ctrl_blk *event)
+{
+    event->head = (uint8_t)((event->head + 1) % EVENT_QUEUE_SIZE);
+    if(--event->pending)
+        activate_task(event->task, event->timestamp[event->head]);
+}
+
+/**
+ *  Activates the task attached to an event, if any, and runs the scheduler
+ *  right away (tail-chained to the calling ISR)
+ *  Must be called with the scheduler's interrupt priority.
+ */
+static void event_raise(uint32_t event)
+{
+    uint8_t slot = event_slot[event];
+    
+    if(slot)
+    {
+        event_activate(&(Event_task_list[slot - 1]));
+        NVIC_SetPendingIRQ(TA0_N_IRQn);
+    }
+}
+
+/**
+ *  Raises an event from any context (see "fate.h")
+ */
+void Event_signal(enum events event)
+{
+    uint32_t primask;
+    
+    if((uint32_t)event >= EVENT_SOURCES)
+        return;
+    //Keep the scheduler out while the event is recorded
+    primask = __get_PRIMASK();
+    __disable_irq();
+    event_raise(event);
+    __set_PRIMASK(primask);
+}
+
+/**
+ *  Sets up a message queue (see "fate.h")
+ */
+uint8_t Queue_init(queue_ctrl_blk *queue, void **slots, uint32_t size, enum events event)
+{
+    //The indexes wrap around through "mask": any other size would skip slots
+    if(!size || (size & (size - 1)))
+        return 1;
+    queue->slots = slots;
+    queue->mask = size - 1;
+    queue->head = 0;
+    queue->tail = 0;
+    queue->event = (uint8_t)event;
+    return 0;
+}
+
+/**
+ *  Puts a message in a queue (see "fate.h")
+ *  Only the producer calls it, so "head" cannot change under it.
+ */
+uint8_t Queue_put(queue_ctrl_blk *queue, void *message)
+{
+    uint32_t head = queue->head;
+    
+    if(head - queue->tail > queue->mask)
+        return 1;
+    queue->slots[head & queue->mask] = message;
+    //The message is in its slot before the consumer can see it
+    __DMB();
+    queue->head = head + 1;
+    __DMB();
+    //Had the consumer got every message before this one? It may have found the
+    //queue empty and stopped: activate it (it finds the message either way)
+    if(queue->tail == head)
+        Event_signal((enum events)queue->event);
+    return 0;
+}
+
+/**
+ *  Gets a message from a queue (see "fate.h")
+ *  Only the consumer calls it, so "tail" cannot change under it.
+ */
+uint8_t Queue_get(queue_ctrl_blk *queue, void **message)
+{
+    uint32_t tail = queue->tail;
+    
+    if(tail == queue->head)
+        return 1;
+    //The slot is read after "head" showed it full
+    __DMB();
+    *message = queue->slots[tail & queue->mask];
+    //And before it is given back to the producer
+    __DMB();
+    queue->tail = tail + 1;
+    return 0;
+}
+
+/**
+ *  Sets up a memory pool, with every block on the free list (see "fate.h")
+ */
+void Pool_init(pool_ctrl_blk *pool, void *memory, uint32_t block_size, uint32_t blocks)
+{
+    uint32_t i;
+    
+    //Room for the free list link, and aligned for it
+    if(block_size < sizeof(void *))
+        block_size = sizeof(void *);
+    block_size = (block_size + sizeof(void *) - 1) & ~(uint32_t)(sizeof(void *) - 1);
+    pool->memory = (uint8_t *)memory;
+    pool->block_size = block_size;
+    pool->blocks = blocks;
+    pool->used = 0;
+    pool->high_water = 0;
+    pool->failures = 0;
+    pool->free = (void *)0;
+    //Linked in reverse, so blocks are handed out in address order
+    for(i=blocks;i>0;i--)
+    {
+        *(void **)(pool->memory + (i - 1) * block_size) = pool->free;
+        pool->free = pool->memory + (i - 1) * block_size;
+    }
+}
+
+/**
+ *  Takes the first block off a pool's free list (see "fate.h")
+ */
+void *Pool_alloc(pool_ctrl_blk *pool)
+{
+    uint32_t primask = __get_PRIMASK();
+    void *block;
+    
+    __disable_irq();
+    block = pool->free;
+    if(block)
+    {
+        pool->free = *(void **)block;
+        if(++pool->used > pool->high_water)
+            pool->high_water = pool->used;
+    }
+    else
+        pool->failures++;
+    __set_PRIMASK(primask);
+    return block;
+}
+
+/**
+ *  Puts a block back at the head of its pool's free list (see "fate.h")
+ */
+uint8_t Pool_free(pool_ctrl_blk *pool, void *block)
+{
+    uint32_t primask, offset = (uint32_t)((uint8_t *)block - pool->memory);
+    
+    if(((uint8_t *)block < pool->memory) || (offset >= pool->blocks * pool->block_size) ||
+       (offset % pool->block_size))
+        return 1;
+    primask = __get_PRIMASK();
+    __disable_irq();
+    //No block is allocated: this one was freed already
+    if(!pool->used)
+    {
+        __set_PRIMASK(primask);
+        return 1;
+    }
+    *(void **)block = pool->free;
+    pool->free = block;
+    pool->used--;
+    __set_PRIMASK(primask);
+    return 0;
+}
+
+/**
+ *  Copies a pool's statistics (see "fate.h")
+ */
+void Pool_get_stats(const pool_ctrl_blk *pool, pool_stats *stats)
+{
+    uint32_t primask = __get_PRIMASK();
+    
+    __disable_irq();
+    stats->blocks = pool->blocks;
+    stats->used = pool->used;
+    stats->high_water = pool->high_water;
+    stats->failures = pool->failures;
+    __set_PRIMASK(primask);
+}
+
+/**
+ *  Called by an aperiodic task to get the time of the activation it is serving
+ */
+uint32_t Task_event_time(enum events event)
+{
+    event_ctrl_blk *entry;
+    
+    if(((uint32_t)event >= EVENT_SOURCES) || !event_slot[event])
+        return 0;
+    entry = &(Event_task_list[event_slot[event] - 1]);
+    return entry->timestamp[entry->head];
+}
+
+/**
+ *  Sets a task's overrun policy (see "fate.h")
+ */
+uint8_t Task_set_overrun(intptr_t function, enum overrun_policy policy)
+{
+    int i;
+    
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        if((Task_list[i].state != TASK_UNDEFINED) && (Task_list[i].function == function))
+        {
+            Task_list[i].overrun = policy;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+#if FATE_POLICY == FATE_POLICY_CYCLIC
+/**
+ *  Checks and sets the cyclic executive's dispatch table (see "fate.h")
+ */
+uint8_t Task_set_table(const cyclic_entry *table, uint32_t entries, uint32_t cycle)
+{
+    task_ctrl_blk *task;
+    uint32_t i;
+    
+    if(!entries || !cycle)
+        return 1;
+    for(i=0;i<entries;i++)
+    {
+        if((table[i].tick >= cycle) || (i && (table[i].tick < table[i - 1].tick)) ||
+           (table[i].task >= NUM_TASKS))
+            return 1;
+        task = &(Task_list[table[i].task]);
+        if(task->state == TASK_UNDEFINED)
+            return 1;
+        //Aperiodic tasks are released by their events, and the idle task never is
+        if((table[i].action == CYCLIC_RELEASE) && ((task == Task_list) || task->event))
+            return 1;
+    }
+    cyclic_table = table;
+    cyclic_entries = entries;
+    cyclic_length = cycle;
+    cyclic_next = 0;
+    //Entry tick t is due t + 1 ticks from now, as a start offset of t
+    cyclic_wait = TICKS(table[0].tick + 1);
+    slot_task = &(Task_list[0]);
+    return 0;
+}
+#endif
+
+#ifdef FATE_PREEMPTION_THRESHOLD
+/**
+ *  Sets a task's preemption threshold (see "fate.h")
+ */
+uint8_t Task_set_threshold(intptr_t function, intptr_t threshold)
+{
+    task_ctrl_blk *task = (task_ctrl_blk *)0, *level = (task_ctrl_blk *)0;
+#ifdef FATE_ADMISSION
+    task_ctrl_blk *previous;
+#endif
+    int i;
+    
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        if(Task_list[i].state == TASK_UNDEFINED)
+            continue;
+        if(Task_list[i].function == function)
+            task = &(Task_list[i]);
+        if(Task_list[i].function == threshold)
+            level = &(Task_list[i]);
+    }
+    if(!task || !level)
+        return 1;
+    
+#ifdef FATE_ADMISSION
+    previous = task->threshold;
+    task->threshold = level;
+    rank_tasks();
+    if(!task_set_schedulable())
+    {
+        task->threshold = previous;
+        rank_tasks();
+        return 2;
+    }
+#else
+    task->threshold = level;
+    rank_tasks();
+#endif
+    return 0;
+}
+#endif
+
+#ifdef FATE_RESOURCES
+/**
+ *  Records that a task uses a resource (see "fate.h")
+ */
+#ifdef FATE_ADMISSION
+uint8_t Resource_use(intptr_t function, uint8_t resource, uint32_t length)
+#else
+uint8_t Resource_use(intptr_t function, uint8_t resource)
+#endif
+{
+#ifdef FATE_ADMISSION
+    uint32_t users, previous;
+#endif
+    int i;
+    
+    if(resource >= NUM_RESOURCES)
+        return 1;
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        if((Task_list[i].state != TASK_UNDEFINED) && (Task_list[i].function == function))
+            break;
+    }
+    if(i == NUM_TASKS)
+        return 1;
+    
+#ifdef FATE_ADMISSION
+    users = resources[resource].users;
+    previous = resources[resource].length[i];
+    resources[resource].users |= (uint32_t)0x80000000 >> i;
+    if(length > previous)
+        resources[resource].length[i] = length;
+    if(!task_set_schedulable())
+    {
+        resources[resource].users = users;
+        resources[resource].length[i] = previous;
+        return 2;
+    }
+#else
+    resources[resource].users |= (uint32_t)0x80000000 >> i;
+#endif
+    resources[resource].ceiling = resource_ceiling(&(resources[resource]));
+    return 0;
+}
+
+/**
+ *  Locks a resource: raises the system ceiling to its ceiling (see "fate.h")
+ */
+uint8_t Resource_lock(uint8_t resource)
+{
+    uint32_t primask = __get_PRIMASK();
+    resource_ctrl_blk *locked;
+    
+    if(resource >= NUM_RESOURCES)
+        return 1;
+    locked = &(resources[resource]);
+    __disable_irq();
+    if(locked->holder || !(locked->users & ((uint32_t)0x80000000 >> (running_task - Task_list))))
+    {
+        __set_PRIMASK(primask);
+        return 1;
+    }
+    locked->holder = running_task;
+    locked->below = locked_resources;
+    locked_resources = locked;
+    if(locked->ceiling < system_ceiling)
+        system_ceiling = locked->ceiling;
+    __set_PRIMASK(primask);
+    return 0;
+}
+
+/**
+ *  Unlocks the last resource locked, and lets the jobs it held back start (see "fate.h")
+ */
+uint8_t Resource_unlock(uint8_t resource)
+{
+    uint32_t primask = __get_PRIMASK();
+    
+    __disable_irq();
+    if((resource >= NUM_RESOURCES) || (locked_resources != &(resources[resource])) ||
+       (resources[resource].holder != running_task))
+    {
+        __set_PRIMASK(primask);
+        return 1;
+    }
+    resource_release(&(resources[resource]));
+    //Run the scheduler: a job kept from starting may preempt this one now
+    NVIC_SetPendingIRQ(TA0_N_IRQn);
+    __set_PRIMASK(primask);
+    return 0;
+}
+#endif
+
+/**
+ *  Gets a task's deadline miss count (see "fate.h")
+ */
+uint32_t Task_get_misses(intptr_t function)
+{
+    int i;
+    
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        if((Task_list[i].state != TASK_UNDEFINED) && (Task_list[i].function == function))
+            return Task_list[i].misses;
+    }
+    return 0;
+}
+
+/**
+ *  Sets the deadline miss handler (see "fate.h")
+ */
+void Task_set_miss_handler(void (*handler)(intptr_t function))
+{
+    miss_handler = handler;
+}
+
+#if defined(FATE_TICKLESS) || defined(FATE_HIRES)
+/**
+ *  Number of system ticks until the next event that may change scheduling decisions:
+ *  a release (including the first one, after "start_offset"), the earliest deadline
+ *  of an active task passing, or (LLF, EDZL) a laxity inversion (see "laxity_wakeup"),
+ *  and never further than "MAX_SLEEP".
+ *  (The timer is programmed again whenever the scheduler runs, so the deadline of
+ *  an aperiodic job activated during a long sleep is not missed late.)
+ *
+ *  FATE_HIRES: in Timer A0 counts, from "tick_count", and never past the next tick
+ *  unless running tickless
+ */
+static uint32_t next_event_ticks(void)
+{
+    uint32_t next = MAX_SLEEP;
+#if FATE_LAXITY
+    uint32_t at;
+#endif
+    
+    if(release_queue && (release_queue->delta < next))
+        next = release_queue->delta;
+#if FATE_POLICY == FATE_POLICY_CYCLIC
+    if(cyclic_entries && (cyclic_wait < next))
+        next = cyclic_wait;
+#endif
+    //Deadlines still ahead (the ones that passed have left "deadline_heap")
+    if(deadline_count && (deadline_heap[0]->absolute_deadline - tick_count < next))
+        next = deadline_heap[0]->absolute_deadline - tick_count;
+#if FATE_LAXITY
+    //A laxity inversion: at the tick it falls in (the scheduler then decides), but not
+    //at once (FATE_HIRES: at the very count)
+    if(laxity_wakeup(&at))
+    {
+        at = COUNTS_TIME((uint32_t)(at - TIME_COUNTS(tick_count)));
+        if(at < next)
+            next = at ? at : 1;
+    }
+#endif
+#if defined(FATE_HIRES) && !defined(FATE_TICKLESS)
+    //The periodic tick
+    if(TICKS(1) - tick_count % TICKS(1) < next)
+        next = TICKS(1) - tick_count % TICKS(1);
+#endif
+    return next;
+}
+#endif
+
+/**
+ *  Programs Timer A0 to interrupt (CCR1 compare) at the next tick, or when running
+ *  tickless at the next event. FATE_HIRES: wherever it falls, releases and deadlines
+ *  not being bound to ticks.
+ */
+static void program_next_event(void)
+{
+#if defined(FATE_TICKLESS) || defined(FATE_HIRES)
+    timer_event = tick_count + next_event_ticks();
+#else
+    timer_event = tick_count + 1;
+#endif
+    TIMER_A0->CCR[1] = (uint16_t)(tick_base + TIME_COUNTS(timer_event - tick_count));
+    
+    //Passed already: the compare would only match once the counter wraps around
+    if(deadline_reached(timer_event, current_tick()))
+        NVIC_SetPendingIRQ(TA0_N_IRQn);
+}
+
+/**
+ *  Returning from a task function stops the task
+ */
+static void task_return(void)
+{
+    Task_stop(running_task->function);
+}
+
+/**
+ *  Builds the initial context of a new job at the top of the task's stack,
+ *  and returns the stack pointer PendSV restores it from
+ */
+static uint32_t *init_stack(task_ctrl_blk *task)
+{
+#if defined(FATE_SIM)
+    //Host simulation: the simulator builds a thread context instead
+    return (uint32_t *)sim_init_stack((uintptr_t)task->stack,
+                                      (void (*)(void))task->function, task_return);
+#else
+    uint32_t *sp = task->stack;
+    
+    //Exception frame, as if the task had been interrupted right at its entry point
+    *(--sp) = 0x01000000;                       //xPSR (Thumb state)
+    *(--sp) = (uint32_t)task->function & ~1u;   //PC
+    *(--sp) = (uint32_t)task_return;            //LR: returning stops the task
+    sp -= 5;                                    //R12, R3-R0
+    //Registers saved by PendSV: EXC_RETURN (thread mode, PSP, no FPU state), R11-R4
+    *(--sp) = 0xFFFFFFFD;
+    sp -= 8;
+    return sp;
+#endif
+}
+
+/**
+ *  Fixed execution time tasks (see "main.c") measure their execution time with
+ *  Timer A1-A3: the timers a task leaves counting must not count while it is switched out.
+ *  Stops them, and returns their modes (Timer An in bits 2n-1:2n-2).
+ */
+static uint8_t pause_exec_timers(void)
+{
+    uint8_t modes = (uint8_t)(((TA1CTL & TIMER_A_CTL_MC_MASK) >> 4) |
+                              ((TA2CTL & TIMER_A_CTL_MC_MASK) >> 2) |
+                              (TA3CTL & TIMER_A_CTL_MC_MASK));
+    
+    if(modes)
+    {
+        TA1CTL &= (uint16_t)~(TIMER_A_CTL_MC_MASK);
+        TA2CTL &= (uint16_t)~(TIMER_A_CTL_MC_MASK);
+        TA3CTL &= (uint16_t)~(TIMER_A_CTL_MC_MASK);
+    }
+    return modes;
+}
+
+/**
+ *  Restarts the timers "pause_exec_timers" stopped
+ */
+static void resume_exec_timers(uint8_t modes)
+{
+    if(modes & 0x03)
+        TA1CTL |= (uint16_t)((modes << 4) & TIMER_A_CTL_MC_MASK);
+    if(modes & 0x0C)
+        TA2CTL |= (uint16_t)((modes << 2) & TIMER_A_CTL_MC_MASK);
+    if(modes & 0x30)
+        TA3CTL |= (uint16_t)(modes & TIMER_A_CTL_MC_MASK);
+}
+
+#ifdef FATE_PROFILE
+/**
+ *  Charges the cycles since the last context switch to the job of "running_task",
+ *  and adds the job to the task's statistics if it is over
+ *  (any switch out of the idle task ends a stretch of idle time)
+ */
+static void profile_switch_out(uint8_t job_over)
+{
+    task_profile *profile = &(running_task->profile);
+    uint32_t now = DWT->CYCCNT;
+    
+    profile->current += now - switched_in;
+    switched_in = now;
+    
+    if(job_over || (running_task == Task_list))
+    {
+        profile->jobs++;
+        if(profile->current > profile->wcet)
+            profile->wcet = profile->current;
+        if(profile->current < profile->bcet)
+            profile->bcet = profile->current;
+        profile->total += profile->current;
+        profile->current = 0;
+    }
+}
+
+/**
+ *  Copies the statistics of a task (see "fate.h")
+ */
+uint8_t Task_get_profile(intptr_t function, task_profile *profile)
+{
+    uint32_t primask;
+    int i;
+    
+    for(i=0;i<NUM_TASKS;i++)
+    {
+        if((Task_list[i].state != TASK_UNDEFINED) && (Task_list[i].function == function))
+        {
+            //Consistent copy: context switches update the statistics
+            primask = __get_PRIMASK();
+            __disable_irq();
+            *profile = Task_list[i].profile;
+            __set_PRIMASK(primask);
+            profile->avg = profile->jobs ? (uint32_t)(profile->total / profile->jobs) : 0;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ *  Clears the statistics of every task (see "fate.h")
+ */
+void Task_reset_profiles(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    int i;
+    
+    __disable_irq();
+    for(i=0;i<NUM_TASKS;i++)
+    {
+        Task_list[i].profile.jobs = 0;
+        Task_list[i].profile.wcet = 0;
+        Task_list[i].profile.bcet = UINT32_MAX;
+        Task_list[i].profile.avg = 0;
+        Task_list[i].profile.total = 0;
+        Task_list[i].profile.current = 0;
+    }
+    __set_PRIMASK(primask);
+}
+#endif
+
+/**
+ *  Called by PendSV with the stack pointer of the task that was running,
+ *  after its registers are saved on its stack.
+ *  Returns the stack pointer of "current_task", whose registers PendSV restores.
+ */
+uint32_t *switch_context(uint32_t *sp)
+{
+#ifdef FATE_BENCH
+    uint32_t bench_start = BENCH_CLOCK();
+#endif
+    uint8_t modes = pause_exec_timers();
+#if FATE_LAXITY
+    charge_running();
+#endif
+    //Is the job of the task that was running over?
+    //(it stopped, or was released again and starts afresh)
+    uint8_t job_over = (running_task->state == TASK_STOPPED) || !running_task->sp;
+    
+#ifdef FATE_PROFILE
+    profile_switch_out(job_over);
+#endif
+    
+    //Keep the context of the task that was running, unless its job is over
+    if(!job_over)
+    {
+        running_task->sp = sp;
+        running_task->exec_timers = modes;
+    }
+    
+    TRACE(TRACE_SWITCH, current_task, running_task - Task_list);
+    running_task = current_task;
+    if(!running_task->sp)
+    {
+        running_task->sp = init_stack(running_task);
+        running_task->exec_timers = 0;
+#ifdef FATE_RESOURCES
+        //A new job starts: it is now the highest priority started job
+        if(running_task != Task_list)
+        {
+            started_remove(running_task);
+            started_jobs[started_count++] = running_task;
+        }
+#endif
+    }
+    resume_exec_timers(running_task->exec_timers);
+#ifdef FATE_BENCH
+    bench_record(BENCH_SWITCH, BENCH_CLOCK() - bench_start);
+#endif
+    return running_task->sp;
+}
+
+/**
+ *  PendSV: switches context
+ *  Lowest priority interrupt, so it only runs once the scheduler (and any other
+ *  interrupt) is done: saves the registers of the running task on its stack
+ *  (the process stack), and restores those of "current_task" from its own.
+ */
+#if defined(FATE_SIM)
+void PendSV_Handler(void)
+{
+    //Host simulation: the process stack pointer is a handle to a thread context,
+    //which the simulator saves and restores around this handler
+    __set_PSP((uintptr_t)switch_context((uint32_t *)__get_PSP()));
+}
+#elif defined(__ARMCC_VERSION)
+__asm void PendSV_Handler(void)
+{
+    IMPORT switch_context
+    PRESERVE8
+    
+    CPSID   I
+    MRS     r0, psp
+#if (__FPU_USED == 1)
+    //Lazily stacked FPU context: save the callee-saved FPU registers too
+    TST     lr, #0x10
+    IT      EQ
+    VSTMDBEQ r0!, {s16-s31}
+#endif
+    STMDB   r0!, {r4-r11, lr}
+    BL      switch_context
+    LDMIA   r0!, {r4-r11, lr}
+#if (__FPU_USED == 1)
+    TST     lr, #0x10
+    IT      EQ
+    VLDMIAEQ r0!, {s16-s31}
+#endif
+    MSR     psp, r0
+    CPSIE   I
+    BX      lr
+}
+#elif defined(__GNUC__)
+__attribute__((naked)) void PendSV_Handler(void)
+{
+    __ASM volatile (
+        "    CPSID   I                   \n"
+        "    MRS     r0, psp             \n"
+#if (__FPU_USED == 1)
+        //Lazily stacked FPU context: save the callee-saved FPU registers too
+        "    TST     lr, #0x10           \n"
+        "    IT      EQ                  \n"
+        "    VSTMDBEQ r0!, {s16-s31}     \n"
+#endif
+        "    STMDB   r0!, {r4-r11, lr}   \n"
+        "    BL      switch_context      \n"
+        "    LDMIA   r0!, {r4-r11, lr}   \n"
+#if (__FPU_USED == 1)
+        "    TST     lr, #0x10           \n"
+        "    IT      EQ                  \n"
+        "    VLDMIAEQ r0!, {s16-s31}     \n"
+#endif
+        "    MSR     psp, r0             \n"
+        "    CPSIE   I                   \n"
+        "    BX      lr                  \n"
+    );
+}
+#endif
+
+/**
+ *  Called by each task when it finishes execution (see "fate.h")
+ */
+void Task_stop(intptr_t function)
+{
+    int i;
+#ifdef FATE_BENCH
+    uint32_t bench_start = BENCH_CLOCK();
+#endif
+    
+    for(i=1;i<NUM_TASKS;i++)
+    {
+        if(Task_list[i].function == function)
+        {
+            TRACE(TRACE_STOP, &(Task_list[i]), 0);
+            Task_list[i].state = TASK_STOPPED;
+#ifdef FATE_BENCH
+            bench_record(BENCH_STOP, BENCH_CLOCK() - bench_start);
+#endif
+            NVIC_SetPendingIRQ(TA0_N_IRQn);
+            //The scheduler switches away from this job for good
+            while(1);
+        }
+    }
+}
+
+#ifdef FATE_BENCH
+/**
+ *  Copies the measurements of a scheduler path (see "fate.h")
+ */
+uint8_t Bench_get(enum bench_path path, uint32_t active, bench_stat *stat)
+{
+    if((path >= NUM_BENCH_PATHS) || (active >= NUM_TASKS))
+        return 1;
+    *stat = bench_stats[path][active];
+    return 0;
+}
+
+void Bench_reset(void)
+{
+    int path, i;
+    uint32_t start;
+    
+    for(path=0;path<NUM_BENCH_PATHS;path++)
+    {
+        for(i=0;i<NUM_TASKS;i++)
+        {
+            bench_stats[path][i].count = 0;
+            bench_stats[path][i].min = 0xFFFFFFFF;
+            bench_stats[path][i].max = 0;
+            bench_stats[path][i].total = 0;
+        }
+    }
+    
+    //Shortest of a few back to back reads
+    bench_overhead = 0xFFFFFFFF;
+    for(i=0;i<8;i++)
+    {
+        start = BENCH_CLOCK();
+        start = BENCH_CLOCK() - start;
+        if(start < bench_overhead)
+            bench_overhead = start;
+    }
+}
+#endif
+
+#ifdef FATE_TRACE
+/**
+ *  Takes the oldest complete record out of the trace ring buffer (see "fate.h")
+ */
+uint8_t Trace_read(trace_record *record)
+{
+    volatile trace_record *oldest = &(trace_buffer[trace_tail % TRACE_SIZE]);
+    
+    //Empty, or the oldest record is claimed but not written yet
+    if((trace_tail == trace_head) || (oldest->type == TRACE_EMPTY))
+        return 0;
+    record->timestamp = oldest->timestamp;
+    record->type = oldest->type;
+    record->task = oldest->task;
+    record->arg = oldest->arg;
+    oldest->type = TRACE_EMPTY;
+    trace_tail++;
+    return 1;
+}
+
+uint32_t Trace_dropped(void)
+{
+    return trace_dropped;
+}
+
+/**
+ *  Writes a word to the trace ITM stimulus port
+ */
+static void trace_send(uint32_t word)
+{
+#if defined(FATE_SIM)
+    sim_itm_write(TRACE_ITM_PORT, word);
+#else
+    //Wait for the port's FIFO
+    while(ITM->PORT[TRACE_ITM_PORT].u32 == 0);
+    ITM->PORT[TRACE_ITM_PORT].u32 = word;
+#endif
+}
+
+/**
+ *  Called by the idle task: sends the trace to ITM, if a debugger enabled the port
+ *  (otherwise the records stay in the ring buffer, for "Trace_read")
+ */
+static void trace_drain(void)
+{
+    trace_record record;
+    uint32_t dropped;
+    
+    if(!(ITM->TCR & ITM_TCR_ITMENA_Msk) || !(ITM->TER & (1UL << TRACE_ITM_PORT)))
+        return;
+    while(Trace_read(&record))
+    {
+        trace_send(record.timestamp);
+        trace_send((uint32_t)record.type | ((uint32_t)record.task << 8) | ((uint32_t)record.arg << 16));
+    }
+    //Records were lost after those sent (the buffer was full): say how many
+    dropped = trace_dropped - trace_reported;
+    if(dropped)
+    {
+        if(dropped > 0xFFFF)
+            dropped = 0xFFFF;
+        trace_reported += dropped;
+        trace_send(DWT->CYCCNT);
+        trace_send((uint32_t)TRACE_DROPPED | (dropped << 16));
+    }
+}
+#endif
+
+/**
+ *  Main scheduler implementation
+ *
+ *  Occurs every tick (or at the next event, if running tickless or FATE_HIRES),
+ *  whenever a task stops, and whenever an event activates a task
+ *
+ *  Updates task releases and deadlines so we keep track of time
+ *  Based on highest priority currently active task, updates information in
+ *  pointer to current task and Task_list, and pends PendSV to switch context to it.
+ */
+void TA0_N_IRQHandler()
+{
+    task_ctrl_blk *new_task;
+    uint32_t now;
+#ifdef FATE_BENCH
+    uint32_t bench_start = BENCH_CLOCK();
+    uint32_t bench_priority;
+    enum bench_path bench_path = (TIMER_A0->CCTL[1] & TIMER_A_CCTLN_CCIFG) ? BENCH_TICK : BENCH_RESCHEDULE;
+#endif
+    
+#if FATE_LAXITY
+    //Laxity of the job on the CPU, up to date (and its execution time, if it stopped)
+    charge_running();
+#endif
+    
+    //Has the current task stopped itself?
+    if(current_task->state == TASK_STOPPED)
+    {
+        retire_task(current_task);
+        //Aperiodic task: serve the next pending activation
+        if(current_task->event)
+            event_served(current_task->event);
+    }
+    
+    //clear compare interrupt flag first: a match from now on runs the scheduler again
+    TIMER_A0->CCTL[1] &= (uint16_t)(~TIMER_A_CCTLN_CCIFG);
+    
+    //If the next tick (or event) is due we need to update all of our counters,
+    //for every tick since: the interrupt may have been held off for longer than one
+    now = current_tick();
+    if(deadline_reached(timer_event, now)) {
+        missed_ticks += (now - timer_event) / TICKS(1);
+#ifdef FATE_TRACE
+        trace_tick(now - tick_count);
+#endif
+        advance_ticks(now - tick_count);
+#if !defined(FATE_TICKLESS) && !defined(FATE_HIRES)
+        program_next_event();
+#endif
+    }
+    
+    //Get pointer to highest priority active (running or suspended) task
+#ifdef FATE_BENCH
+    bench_priority = BENCH_CLOCK();
+    new_task = get_priority_task();
+    bench_priority = BENCH_CLOCK() - bench_priority;
+#else
+    new_task = get_priority_task();
+#endif
+    
+    //Is the current highest priority active task not the currently running task?
+    if(new_task != current_task)
+    {
+        //Yes, it is
+        //Set current task to "suspended", if it is "running"; it might have stopped itself
+        if(current_task->state == TASK_RUNNING)
+            current_task->state = TASK_SUSPENDED;
+        //Set new task to "running"
+        new_task->state = TASK_RUNNING;
+        //Update current task pointer
+        current_task = new_task;
+    }
+    else
+    {
+        //No, we're still running highest priority active task
+        //Is the current task finished?
+        if(current_task->state == TASK_STOPPED)
+        {
+            //Yes: go back to idle task
+            current_task = &(Task_list[0]);
+            current_task->state = TASK_RUNNING;
+        }
+        //No, current task is not finished
+        //Return to same task (do nothing)
+    }
+    
+#if defined(FATE_TICKLESS) || defined(FATE_HIRES)
+    //A job activated by an event may have the earliest deadline now
+    //(and, under LLF and EDZL, the job now on the CPU sets when laxities are due)
+    program_next_event();
+#endif
+    
+#ifdef FATE_PREEMPTION_THRESHOLD
+    //The job on the CPU has started: from now on, it runs at its threshold
+    if(current_task != Task_list)
+        started_tasks |= (uint32_t)0x80000000 >> current_task->rank;
+#endif
+    
+    //Switch context, unless we return to the job that is already on the CPU
+    //(a new job starts afresh, even if the task that just stopped is released again)
+    if((current_task != running_task) || !current_task->sp)
+        SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+    
+#ifdef FATE_BENCH
+    //Not counting the time taken to measure "get_priority_task"
+    bench_record(bench_path, BENCH_CLOCK() - bench_start - bench_overhead);
+    bench_record(BENCH_PRIORITY, bench_priority);
+#endif
+}
+
+/**
+ *  Port interrupt handlers
+ *  Process events for aperiodic tasks
+ *
+ *  Each read of PxIV returns the lowest pending pin as 2 * (pin + 1), 0 if none,
+ *  and clears its flag: an event costs one register read and one table lookup,
+ *  however many pins are configured.
+ */
+#define PORT_IRQ_HANDLER(n)                                             \
+void PORT##n##_IRQHandler(void)                                         \
+{                                                                       \
+    uint16_t iv;                                                        \
+                                                                        \
+    while((iv = P##n##IV) != 0)                                         \
+        event_raise((uint32_t)EVENT_PORT_PIN(n, 0) + (iv >> 1) - 1);    \
+}
+
+PORT_IRQ_HANDLER(1)
+PORT_IRQ_HANDLER(2)
+PORT_IRQ_HANDLER(3)
+PORT_IRQ_HANDLER(4)
+PORT_IRQ_HANDLER(5)
+PORT_IRQ_HANDLER(6)
+
+/*
+ Configures Timer for system tick, NVIC and CPU interrupts,
+ and starts the idle task
+ */
+void Task_schedule(void)
+{
+#ifdef FATE_RESOURCES
+    int i;
+    
+    //Ceilings from the preemption levels of every task added
+    for(i=0;i<NUM_RESOURCES;i++)
+        resources[i].ceiling = resource_ceiling(&(resources[i]));
+    
+#endif
+    //configure timer
+    TA0CTL |= timer_ctl; //ACLK, unless "Task_set_tick" changed it
+    TIMER_A0->EX0 = timer_ex0;
+    TA0CTL |= (uint16_t)BIT2; //Clear, for the dividers to take effect
+    //Free running: interrupts on CCR1 at the next tick or event (no roll over
+    //interrupt), so late interrupts cannot lose ticks
+    TIMER_A0->CCTL[1] = TIMER_A_CCTLN_CCIE;
+    program_next_event();
+    TA0CTL |= (uint16_t)BIT5; //CONTINUOUS MODE
+    
+    //enable NVIC timer interrupts
+    NVIC_EnableIRQ(TA0_N_IRQn);
+    NVIC_SetPriority(TA0_N_IRQn, 2);
+    
+    //PendSV at the lowest priority: context switches wait for every other interrupt
+    NVIC_SetPriority(PendSV_IRQn, (1 << __NVIC_PRIO_BITS) - 1);
+    
+#if defined(FATE_PROFILE) || defined(FATE_TRACE) || defined(FATE_BENCH)
+    //Start the DWT cycle counter
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+#ifdef FATE_PROFILE
+    switched_in = 0;
+#endif
+#ifdef FATE_BENCH
+    Bench_reset();
+#endif
+    
+    //The idle task runs on its own stack too: switch thread mode to the process stack
+    Task_list[0].sp = Task_list[0].stack;
+    running_task = &(Task_list[0]);
+    __set_PSP((uintptr_t)Task_list[0].sp);
+    __set_CONTROL(0x02);
+    __ISB();
+    
+    //enable CPU interrupts
+    __ASM("CPSIE I");
+    
+    idle_thread();
+}
+
@@ -0,0 +1,1047 @@
+/*****************************************************
+
+
+FATE_OS_H v2.0
+The "Fake Time Environment Operating System"
+
+Developed by 
+Paulo Garcia
+Dpt. of Systems and Computer Engineering
+Carleton University
+Ottawa, Ontario, Canada
+
+This code if for educational purposes only (SYSC3310 - Introduction to Real Time Systems)
+We do not guarantee this code will work on any given situation. 
+Do not use this code in production software.
+
+
+V1.0:
+
+Basic support for up to 8 periodic tasks.
+Tasks cannot call other functions nor should they have local variables.
+
+V1.1:
+Added support for aperiodic tasks (port interrupt events only)
+
+V1.2:
+EDF scheduling, with start offsets and deadlines
+Optional tickless operation (FATE_TICKLESS)
+Releases and deadlines kept in delta queues (per-tick work only for due events)
+Context switching through PendSV, with a stack per task: preempted tasks resume
+where they left off, and may use local variables, call functions and return
+Events run the scheduler immediately, instead of at the next tick
+Aperiodic task activations are counted (and time stamped), so bursts are not lost
+Table-driven events: any pin of ports P1-P6, or software events (Event_signal)
+Optional execution time profiling with the DWT cycle counter (FATE_PROFILE)
+Optional scheduler trace, drained to ITM (FATE_TRACE)
+Optional scheduler cost measurement (FATE_BENCH)
+Optional admission control with the EDF processor demand test (FATE_ADMISSION)
+Deadline misses detected and counted per task, with an optional handler and
+an overrun policy per task (continue, abort the job, or skip the next release)
+Absolute deadlines, with active jobs in a binary heap in EDF order
+Aperiodic jobs get a deadline relative to their activation, instead of being most urgent
+
+V2.0:
+One kernel for every scheduling policy, chosen at compile time (FATE_POLICY):
+EDF, rate monotonic, deadline monotonic or fixed priorities
+Fixed priority policies rank tasks when they are added, and find the highest
+priority active task with a single CLZ
+Admission control runs response time analysis for fixed priority policies
+Least laxity first (FATE_POLICY_LLF) and EDF until zero laxity (FATE_POLICY_EDZL),
+from execution times measured by the kernel
+Optional preemption thresholds for fixed priority policies (FATE_PREEMPTION_THRESHOLD),
+assigned offline by "host/fate_threshold", and checked by admission control
+(response time analysis of Wang and Saksena)
+Optional shared resources under the Stack Resource Policy (FATE_RESOURCES)
+Lock-free single producer, single consumer message queues (Queue_put, Queue_get)
+Fixed block memory pools, O(1) and interrupt safe (Pool_alloc, Pool_free)
+Time-triggered cyclic executive (FATE_POLICY_CYCLIC): jobs are released and
+given the CPU by a static dispatch table (Task_set_table)
+Optional high resolution timing (FATE_HIRES): releases and deadlines in Timer A0
+counts, on a compare channel of the free running timer
+Tick rate and Timer A0 clock source set at run time (Task_set_tick), and task times
+in microseconds or milliseconds (Task_add_us, Task_add_ms), with rounding errors reported
+64 bit monotonic time since the scheduler started (Time_ticks, Time_us), read lock-free,
+counted by the free running Timer A0: ticks missed by a late scheduler are caught up
+
+******************************************************/
+
+#ifndef FATE_OS_H
+#define FATE_OS_H
+
+#include <msp.h>
+#include <stdint.h>
+
+
+/** Scheduling policies, for "FATE_POLICY" */
+/** Earliest deadline first */
+#define FATE_POLICY_EDF 1
+/** Rate monotonic: fixed priorities, shorter period first */
+#define FATE_POLICY_RM 2
+/** Deadline monotonic: fixed priorities, shorter deadline first */
+#define FATE_POLICY_DM 3
+/** Fixed priorities, as given to "Task_add" and "Task_event_add" */
+#define FATE_POLICY_FP 4
+/** Least laxity first: the job with the least time to spare before its deadline */
+#define FATE_POLICY_LLF 5
+/** EDF until zero laxity: EDF, except that a job with no time to spare runs first */
+#define FATE_POLICY_EDZL 6
+/**
+ *  Cyclic executive: the CPU goes to the tasks of a dispatch table, stepped through
+ *  one entry at a time (see "Task_set_table"); other active jobs, e.g. aperiodic
+ *  ones, use the time the table leaves idle, earliest deadline first
+ */
+#define FATE_POLICY_CYCLIC 7
+
+/** Scheduling policy (e.g. -DFATE_POLICY=FATE_POLICY_RM) */
+#ifndef FATE_POLICY
+#define FATE_POLICY FATE_POLICY_EDF
+#endif
+
+/** Policies that order tasks once and for all, when they are added */
+#define FATE_FIXED_PRIORITY ((FATE_POLICY == FATE_POLICY_RM) || (FATE_POLICY == FATE_POLICY_DM) || \
+                             (FATE_POLICY == FATE_POLICY_FP))
+
+/**
+ *  Policies that need each job's laxity: the time to its deadline, minus the
+ *  execution time it has left (its task's budget, minus what it has run so far)
+ */
+#define FATE_LAXITY ((FATE_POLICY == FATE_POLICY_LLF) || (FATE_POLICY == FATE_POLICY_EDZL))
+
+/** Size of "Task_list", idle task included (at most 32: ready sets hold one bit per task) */
+#ifndef NUM_TASKS
+#define NUM_TASKS 8
+#endif
+
+/** Number of events that can have a task attached */
+#define NUM_EVENTS 8
+
+/** Number of software events (see "Event_signal") */
+#define NUM_SOFTWARE_EVENTS 8
+
+/** Number of shared resources (see "Resource_lock") */
+#define NUM_RESOURCES 8
+
+/** Timer A0 clock (ACLK), in Hz */
+#define TIMER_HZ 32768
+
+/** SMCLK frequency, in Hz, for "TICK_SMCLK" (3MHz out of reset) */
+#ifndef SMCLK_HZ
+#define SMCLK_HZ 3000000
+#endif
+
+/** Timer A0 period for one system tick, in ACLK counts minus one (10ms), unless "Task_set_tick" changes it */
+#define TICK_COUNTS 328
+
+/** System tick length in microseconds, rounded down (with the default tick) */
+#define TICK_US (((TICK_COUNTS) + 1) * 1000000UL / TIMER_HZ)
+
+/**
+ *  Largest rounding error accepted when a time in microseconds or milliseconds is
+ *  converted to system ticks (FATE_HIRES: Timer A0 counts), or a tick rate to Timer A0
+ *  counts, in parts per thousand of the time
+ */
+#ifndef TIME_TOLERANCE
+#define TIME_TOLERANCE 50
+#endif
+
+/**
+ *  Define to run tickless: instead of interrupting every tick, Timer A0 is
+ *  programmed to interrupt at the next release, start offset expiration or
+ *  deadline, and task events are caught up when it does.
+ */
+//#define FATE_TICKLESS
+
+/**
+ *  Define for high resolution timing: Timer A0 counts freely, and releases,
+ *  deadlines and event time stamps are kept in its counts (30.5us) instead of
+ *  system ticks. A compare channel interrupts at the next release or deadline,
+ *  wherever it falls between ticks, so tasks can be added with times in
+ *  microseconds ("Task_add_us"). The scheduler still runs on every tick too,
+ *  unless FATE_TICKLESS is also defined.
+ */
+//#define FATE_HIRES
+
+/**
+ *  Define to measure the execution time of every job with the DWT cycle counter
+ *  (see "Task_get_profile").
+ */
+//#define FATE_PROFILE
+
+/**
+ *  Define to record scheduler activity (releases, events, context switches,
+ *  stops, deadline misses) in a ring buffer in RAM, time stamped with the DWT
+ *  cycle counter. The idle task drains it to ITM stimulus port "TRACE_ITM_PORT"
+ *  when a debugger enables the port; "host/fate_trace" decodes the stream.
+ */
+//#define FATE_TRACE
+
+/**
+ *  Define to measure the cost of the scheduler itself: the tick handler,
+ *  "get_priority_task", the context switch and "Task_stop" are timed with the
+ *  DWT cycle counter (host nanoseconds in the simulator), per number of
+ *  active tasks (see "Bench_get" and "bench.c").
+ */
+//#define FATE_BENCH
+
+/**
+ *  Define to check, whenever a task is added, that every job still meets its
+ *  deadline under the chosen policy: response time analysis for fixed priority
+ *  policies (Wang and Saksena's, with FATE_PREEMPTION_THRESHOLD), the processor
+ *  demand test otherwise (exact for EDF, and for LLF and EDZL, which are just as
+ *  optimal on one processor). "Task_add" and "Task_event_add" then also take the
+ *  task's worst case execution time, and "Task_event_add" the minimum time
+ *  between events, and reject the task if the test fails.
+ */
+//#define FATE_ADMISSION
+
+/**
+ *  Define, with a fixed priority policy, to give tasks preemption thresholds
+ *  (see "Task_set_threshold"): once a job has started, only tasks of higher
+ *  priority than its task's threshold preempt it. Admission control then
+ *  accounts for the blocking this causes.
+ */
+//#define FATE_PREEMPTION_THRESHOLD
+
+#if defined(FATE_PREEMPTION_THRESHOLD) && !FATE_FIXED_PRIORITY
+#error "FATE_PREEMPTION_THRESHOLD needs a fixed priority policy (FATE_POLICY_RM, _DM or _FP)"
+#endif
+
+/**
+ *  Define to share resources (peripherals, buffers) between tasks under the
+ *  Stack Resource Policy (see "Resource_lock"): a job only starts once its
+ *  preemption level is above the ceilings of every locked resource, so it never
+ *  blocks once started, is blocked by at most one critical section of a lower
+ *  level job, and locks never deadlock. Preemption levels follow the fixed
+ *  priorities, or, under EDF, the relative deadlines (shorter is higher).
+ *  Admission control then accounts for that blocking.
+ */
+//#define FATE_RESOURCES
+
+#if defined(FATE_RESOURCES) && (FATE_LAXITY || (FATE_POLICY == FATE_POLICY_CYCLIC))
+#error "FATE_RESOURCES needs jobs of fixed priority: EDF or a fixed priority policy"
+#endif
+
+/** Number of records the trace ring buffer holds (power of 2) */
+#define TRACE_SIZE 256
+
+/** ITM stimulus port the trace is sent to */
+#define TRACE_ITM_PORT 1
+
+/** Number of activations of an aperiodic task that can be pending (further ones are lost) */
+#define EVENT_QUEUE_SIZE 4
+
+/** Stack size of each task (including the idle task), in bytes (multiple of 8) */
+#define STACK_SIZE 512
+
+
+/** Definitions for different Task states. */
+enum task_state {
+    /** Undefined: corresponding task has not been initialized. */
+    TASK_STOPPED,
+    /** Stopped: corresponding task is not scheduled to run (no start event, i.e., period expiration, yet) */
+    TASK_SUSPENDED,
+    /** Suspended: task is ready to run, but is not yet the highest priority task */
+    TASK_RUNNING,
+    /** Running: currently executing task */
+    TASK_UNDEFINED
+};
+
+/** What happens to a job that is still active when its deadline passes */
+enum overrun_policy {
+    /** The job runs to completion (under EDF, ahead of every job whose deadline has not passed) */
+    OVERRUN_CONTINUE,
+    /** The job is dropped: the task stops until its next release (or pending activation) */
+    OVERRUN_ABORT,
+    /** The job runs to completion, and the task's next release is skipped to catch up */
+    OVERRUN_SKIP
+};
+
+/** Clock sources of Timer A0, which keeps the system tick (see "Task_set_tick") */
+enum tick_clock {
+    /** ACLK (TIMER_HZ): keeps counting in every low power mode */
+    TICK_ACLK,
+    /** SMCLK (SMCLK_HZ): finer times, for short ticks and FATE_HIRES */
+    TICK_SMCLK
+};
+
+/** Event of the active edge on a pin of ports P1-P6 */
+#define EVENT_PORT_PIN(port, pin) (((port) - 1) * 8 + (pin))
+
+/** Software event, raised by calling "Event_signal" (e.g. from a peripheral ISR) */
+#define EVENT_SOFTWARE(n) (EVENT_PORT_PIN(7, 0) + (n))
+
+/** Number of event sources: port pins, then software events */
+#define EVENT_SOURCES EVENT_SOFTWARE(NUM_SOFTWARE_EVENTS)
+
+/** No event: "Event_signal" ignores it */
+#define EVENT_NONE EVENT_SOURCES
+
+/**
+ *  List of events that can be used to start aperiodic tasks
+ *  Any "EVENT_PORT_PIN" or "EVENT_SOFTWARE" can be used; these are the switches.
+ */
+enum events {
+    /** Switch p1.1 */
+    SWITCH_P1_1 = EVENT_PORT_PIN(1, 1),
+    /** Switch p1.4 */
+    SWITCH_P1_4 = EVENT_PORT_PIN(1, 4)
+};
+
+/**
+ *  Entry of a delta queue, which keeps future task events in time order:
+ *  only the first entry has to be updated as time passes.
+ */
+typedef struct timer_node
+{
+    /** Next entry in the queue (expires at the same time or later) */
+    struct timer_node *next;
+    /** Number of system ticks between the previous entry's expiration and this one's */
+    uint32_t delta;
+    /** Task this entry belongs to */
+    struct task_ctrl_blk *task;
+}
+timer_node;
+
+/** Structure that holds information for each event */
+typedef struct event_ctrl_blk
+{
+    /** Task the event activates (0 if none) */
+    struct task_ctrl_blk *task;
+    /** Event source ("enum events") */
+    uint8_t source;
+    /** Activations received and not yet served (the active job's included) */
+    uint8_t pending;
+    /** Position of the oldest pending activation in "timestamp" */
+    uint8_t head;
+    /** Activations dropped because "EVENT_QUEUE_SIZE" were already pending */
+    uint16_t lost;
+    /** System tick on which each pending activation happened */
+    uint32_t timestamp[EVENT_QUEUE_SIZE];
+}
+event_ctrl_blk;
+
+/** What a dispatch table entry does (see "cyclic_entry") */
+enum cyclic_action {
+    /** The task's active job gets the CPU (if its job is over, other jobs get it) */
+    CYCLIC_RESUME,
+    /** A new job of the task is released, and gets the CPU */
+    CYCLIC_RELEASE
+};
+
+/**
+ *  Entry of a cyclic executive's dispatch table (see "Task_set_table")
+ *  From its tick until the next entry's, the CPU belongs to its task.
+ */
+typedef struct cyclic_entry
+{
+    /** System tick the entry takes effect on, counted from the start of the cycle */
+    uint32_t tick;
+    /** Position of the task in "Task_list": tasks are numbered from 1 in the order
+        they are added (0, the idle task, leaves the CPU to other active jobs) */
+    uint8_t task;
+    /** What happens to the task's job */
+    enum cyclic_action action:8;
+}
+cyclic_entry;
+
+/**
+ *  Single producer, single consumer ring of message pointers (see "Queue_init")
+ *  The producer only writes "head", the consumer only writes "tail": each
+ *  side sees the other's progress without locks or disabling interrupts.
+ */
+typedef struct queue_ctrl_blk
+{
+    /** Message slots, a power of 2 of them */
+    void **slots;
+    /** Number of slots minus one */
+    uint32_t mask;
+    /** Messages put so far (wraps around) */
+    volatile uint32_t head;
+    /** Messages got so far (wraps around) */
+    volatile uint32_t tail;
+    /** Event signaled when a message is put in the empty queue */
+    uint8_t event;
+}
+queue_ctrl_blk;
+
+/**
+ *  Pool of fixed size memory blocks (see "Pool_init")
+ *  Free blocks are linked through their first word.
+ */
+typedef struct pool_ctrl_blk
+{
+    /** First free block (0 if none) */
+    void *free;
+    /** Storage of the blocks */
+    uint8_t *memory;
+    /** Block size in bytes, rounded up to a multiple of the size of a pointer */
+    uint32_t block_size;
+    /** Number of blocks */
+    uint32_t blocks;
+    /** Blocks allocated now */
+    uint32_t used;
+    /** Most blocks ever allocated at once */
+    uint32_t high_water;
+    /** Allocations that failed because every block was in use */
+    uint32_t failures;
+}
+pool_ctrl_blk;
+
+/** Storage for a pool of "blocks" blocks of "block_size" bytes, pointer aligned */
+#define POOL_MEMORY(name, block_size, blocks) \
+    void *name[((block_size) + sizeof(void *) - 1) / sizeof(void *) * (blocks)]
+
+/** Statistics of a pool (see "Pool_get_stats") */
+typedef struct pool_stats
+{
+    /** Number of blocks */
+    uint32_t blocks;
+    /** Blocks allocated now */
+    uint32_t used;
+    /** Most blocks ever allocated at once */
+    uint32_t high_water;
+    /** Allocations that failed */
+    uint32_t failures;
+}
+pool_stats;
+
+#ifdef FATE_PROFILE
+/**
+ *  Execution time statistics of a task, in CPU (MCLK) cycles
+ *  A job's execution time includes the interrupts taken while it runs.
+ */
+typedef struct task_profile
+{
+    /** Number of completed jobs */
+    uint32_t jobs;
+    /** Longest completed job (worst case execution time observed) */
+    uint32_t wcet;
+    /** Shortest completed job (best case execution time observed) */
+    uint32_t bcet;
+    /** Average of the completed jobs (only filled in by "Task_get_profile") */
+    uint32_t avg;
+    /** Total of the completed jobs */
+    uint64_t total;
+    /** Cycles executed so far by the active job */
+    uint32_t current;
+}
+task_profile;
+#endif
+
+#ifdef FATE_BENCH
+/** Scheduler paths timed by FATE_BENCH */
+enum bench_path {
+    /** TA0_N_IRQHandler, on a tick (or the next event, if running tickless or FATE_HIRES) */
+    BENCH_TICK,
+    /** TA0_N_IRQHandler, run by a task stopping or an event */
+    BENCH_RESCHEDULE,
+    /** get_priority_task, called by TA0_N_IRQHandler */
+    BENCH_PRIORITY,
+    /** Task_stop, up to running the scheduler */
+    BENCH_STOP,
+    /** Context switch: "switch_context", called by PendSV_Handler */
+    BENCH_SWITCH,
+    NUM_BENCH_PATHS
+};
+
+/**
+ *  Measurements of one scheduler path, over the calls that finished
+ *  with a given number of tasks active (Running or Suspended, idle task excluded)
+ */
+typedef struct bench_stat
+{
+    /** Number of calls measured */
+    uint32_t count;
+    /** Shortest call */
+    uint32_t min;
+    /** Longest call */
+    uint32_t max;
+    /** Total of all calls */
+    uint64_t total;
+}
+bench_stat;
+
+/** Clock the scheduler is timed with, and its unit */
+#ifdef FATE_SIM
+#define BENCH_CLOCK() sim_host_clock()
+#define BENCH_UNIT "host_ns"
+#else
+#define BENCH_CLOCK() (DWT->CYCCNT)
+#define BENCH_UNIT "cycles"
+#endif
+#endif
+
+#ifdef FATE_TRACE
+/** Trace record types */
+enum trace_type {
+    /** Slot claimed, record not written yet */
+    TRACE_EMPTY,
+    /** A release or deadline came due on a tick (or event, if running tickless):
+        "arg" system ticks (FATE_HIRES: Timer A0 counts) elapsed since the last
+        TRACE_TICK record, at most 65535. Ticks that change nothing are not recorded */
+    TRACE_TICK,
+    /** Periodic task released ("arg" is 1 if it was still active, so the release is skipped) */
+    TRACE_RELEASE,
+    /** Event "arg" activated the task (or queued an activation) */
+    TRACE_EVENT,
+    /** Event "arg" was lost: too many activations pending */
+    TRACE_EVENT_LOST,
+    /** Context switch to the task, from task "arg" */
+    TRACE_SWITCH,
+    /** Task stopped (job finished) */
+    TRACE_STOP,
+    /** The task's active job missed its deadline ("arg" is the task's "enum overrun_policy") */
+    TRACE_DEADLINE_MISS,
+    /** Sent by the idle task after the records before it: "arg" records (at most 65535)
+        were dropped since, the ring buffer being full (see "Trace_dropped") */
+    TRACE_DROPPED
+};
+
+/**
+ *  Trace record
+ *  Sent to ITM as two words: "timestamp", then type | task << 8 | arg << 16.
+ */
+typedef struct trace_record
+{
+    /** DWT cycle count */
+    uint32_t timestamp;
+    /** "enum trace_type" */
+    uint8_t type;
+    /** Position of the task in "Task_list" */
+    uint8_t task;
+    /** Depends on the type */
+    uint16_t arg;
+}
+trace_record;
+#endif
+
+/** Structure that holds information for each task */
+typedef struct task_ctrl_blk
+{
+    /** Address of function that implements thread */
+	intptr_t function;
+    /** Thread's periodicity in number of system ticks (FATE_HIRES: Timer A0 counts, as all times below) */
+	uint32_t period;
+    /** Number of system ticks to wait before scheduling task */
+    uint32_t start_offset;
+    /** The number of ticks from when the task starts to when it must complete */
+    uint32_t deadline;
+    /** Release queue entry: ticks until the task is next released (periodic tasks) */
+    timer_node release_timer;
+    /** Deadline of the active job, in system ticks since the scheduler started */
+    uint32_t absolute_deadline;
+    /** Position of the active job in the deadline heap (HEAP_NONE if it is not in it) */
+    uint8_t heap_index;
+#if FATE_POLICY == FATE_POLICY_FP
+    /** Priority given when the task was added (high numbers are prioritized) */
+    uint32_t priority;
+#endif
+#if FATE_FIXED_PRIORITY
+    /** Position in the priority order (0 is the highest) */
+    uint8_t rank;
+#endif
+#ifdef FATE_PREEMPTION_THRESHOLD
+    /** Task whose priority is the preemption threshold (0: the task's own) */
+    struct task_ctrl_blk *threshold;
+    /** Rank of the preemption threshold: a started job is only preempted by higher ranks */
+    uint8_t threshold_rank;
+#endif
+#if FATE_LAXITY
+    /** Execution time budget: the longest job measured so far, in Timer A0 counts */
+    uint32_t budget;
+    /** Execution time of the active job so far, in Timer A0 counts */
+    uint32_t executed;
+    /** Latest start time of the active job (its deadline minus the budget it has left),
+        in Timer A0 counts: laxity is this minus the current time */
+    uint32_t latest_start;
+    /** Position of the active job in the laxity heap (HEAP_NONE if it is not in it) */
+    uint8_t slack_index;
+#endif
+    /** Saved stack pointer while switched out (0: the active job has not started yet) */
+    uint32_t *sp;
+    /** Top of the task's stack */
+    uint32_t *stack;
+    /** Modes of the Timer A1-A3 the task left counting when switched out */
+    uint8_t exec_timers;
+    /** Event that activates the task (0 for periodic tasks) */
+    struct event_ctrl_blk *event;
+#ifdef FATE_PROFILE
+    /** Execution time statistics */
+    task_profile profile;
+#endif
+#ifdef FATE_ADMISSION
+    /** Worst case execution time, in microseconds */
+    uint32_t wcet;
+    /** Aperiodic tasks: minimum number of system ticks between events */
+    uint32_t interarrival;
+#endif
+    /** Number of deadlines missed */
+    uint32_t misses;
+    /** What happens to a job that misses its deadline */
+    enum overrun_policy overrun:8;
+    /** Set by OVERRUN_SKIP: the next release is skipped */
+    uint8_t skip_release;
+    /** -1 not initialized, 0 stopped, 1 suspended, 2 running */
+    enum task_state state:8;
+}
+task_ctrl_blk;
+
+
+// Various function definitions
+
+/**
+ *  Initilize the task list to defualt values.
+ *
+ *  @note This function should be called before any other fate functions.
+ */
+void Task_list_init(void);
+
+/**
+ *  Set the system tick rate, and the clock Timer A0 counts (100Hz from ACLK by default).
+ *  A tick is a whole number of counts: the clock is divided by up to 64 if one tick
+ *  would take more than half the 16 bit timer.
+ *
+ *  @param clock Clock source
+ *  @param hz System ticks per second
+ *
+ *  @note Call it right after "Task_list_init": times are converted when tasks are added.
+ *
+ *  @return 0 if the tick was set (1 if a task was added already, or the rate is out of
+ *          range for the clock, 3 if whole counts would be off by more than TIME_TOLERANCE)
+ */
+uint8_t Task_set_tick(enum tick_clock clock, uint32_t hz);
+
+/**
+ *  Add a new periodic task to the task list.
+ *
+ *  @param function The function which should be called for this task
+ *  @param period Number of system ticks per task
+ *  @param start_offset Number of system ticks to wait before scheduling the task for the first time
+ *  @param deadline Number of system ticks from each release to when the job must complete
+ *  @param priority (FATE_POLICY_FP) The priority of this task, high numbers are prioritized
+ *                  (other policies ignore it)
+ *  @param wcet (FATE_ADMISSION) Worst case execution time, in microseconds
+ *
+ *  @return 0 if the task was successfully added to the task list
+ *          (1 if there is no room, 2 if it failed the admission test)
+ */
+#ifdef FATE_ADMISSION
+uint8_t Task_add(intptr_t function, uint32_t period, uint32_t start_offset,
+                uint32_t deadline, uint32_t priority, uint32_t wcet);
+#else
+uint8_t Task_add(intptr_t function, uint32_t period, uint32_t start_offset,
+                uint32_t deadline, uint32_t priority);
+#endif
+
+/**
+ *  Add a new aperiodic task to the task list.
+ *
+ *  @param function The function which should be called for this task
+ *  @param event The event which should trigger this task
+ *  @param deadline Number of system ticks from each event to when the job must complete
+ *  @param priority (FATE_POLICY_FP) The priority of this task, high numbers are prioritized
+ *                  (other policies ignore it; rate monotonic ranks it by its deadline)
+ *  @param wcet (FATE_ADMISSION) Worst case execution time, in microseconds
+ *  @param interarrival (FATE_ADMISSION) Minimum number of system ticks between events
+ *
+ *  @note Port pins are configured as inputs with pull-up resistors,
+ *        triggering on the falling edge (active low switches).
+ *
+ *  @return 0 if the task was successfully added to the task list
+ *          (1 if there is no room, or the event already has a task,
+ *          2 if it failed the admission test)
+ */
+#ifdef FATE_ADMISSION
+uint8_t Task_event_add(intptr_t function, enum events event, uint32_t deadline,
+                       uint32_t priority, uint32_t wcet, uint32_t interarrival);
+#else
+uint8_t Task_event_add(intptr_t function, enum events event, uint32_t deadline,
+                       uint32_t priority);
+#endif
+
+/**
+ *  Add a new periodic task, with its period, start offset and deadline in microseconds
+ *  ("Task_add_us") or milliseconds ("Task_add_ms"), rounded to the nearest system tick
+ *  (FATE_HIRES: Timer A0 count); otherwise as "Task_add".
+ *  FATE_HIRES: the first release is "start_offset" after "Task_schedule", not on the tick after.
+ *
+ *  @return 0 if the task was successfully added to the task list
+ *          (1 if there is no room, 2 if it failed the admission test,
+ *          3 if a time, once rounded, would be off by more than TIME_TOLERANCE)
+ */
+#ifdef FATE_ADMISSION
+uint8_t Task_add_us(intptr_t function, uint32_t period, uint32_t start_offset,
+                    uint32_t deadline, uint32_t priority, uint32_t wcet);
+uint8_t Task_add_ms(intptr_t function, uint32_t period, uint32_t start_offset,
+                    uint32_t deadline, uint32_t priority, uint32_t wcet);
+#else
+uint8_t Task_add_us(intptr_t function, uint32_t period, uint32_t start_offset,
+                    uint32_t deadline, uint32_t priority);
+uint8_t Task_add_ms(intptr_t function, uint32_t period, uint32_t start_offset,
+                    uint32_t deadline, uint32_t priority);
+#endif
+
+/**
+ *  Add a new aperiodic task, with its deadline (and minimum time between events) in
+ *  microseconds ("Task_event_add_us") or milliseconds ("Task_event_add_ms"), rounded
+ *  to the nearest system tick (FATE_HIRES: Timer A0 count); otherwise as "Task_event_add"
+ *  (the worst case execution time is in microseconds either way).
+ *
+ *  @return 0 if the task was successfully added to the task list
+ *          (1 if there is no room, or the event already has a task,
+ *          2 if it failed the admission test,
+ *          3 if a time, once rounded, would be off by more than TIME_TOLERANCE)
+ */
+#ifdef FATE_ADMISSION
+uint8_t Task_event_add_us(intptr_t function, enum events event, uint32_t deadline,
+                          uint32_t priority, uint32_t wcet, uint32_t interarrival);
+uint8_t Task_event_add_ms(intptr_t function, enum events event, uint32_t deadline,
+                          uint32_t priority, uint32_t wcet, uint32_t interarrival);
+#else
+uint8_t Task_event_add_us(intptr_t function, enum events event, uint32_t deadline,
+                          uint32_t priority);
+uint8_t Task_event_add_ms(intptr_t function, enum events event, uint32_t deadline,
+                          uint32_t priority);
+#endif
+
+/**
+ *  Get the time an aperiodic task's current job was activated.
+ *
+ *  @param event The event which triggers the calling task
+ *
+ *  @return The system tick on which the event happened
+ *          (FATE_HIRES: the Timer A0 count, since "Task_schedule";
+ *          0 if the event is out of range, or has no task)
+ */
+uint32_t Task_event_time(enum events event);
+
+/**
+ *  Get the time since "Task_schedule", in system ticks ("Time_ticks") or in
+ *  microseconds ("Time_us", to the Timer A0 count, rounded down).
+ *  Counted from Timer A0 itself, which runs freely: it does not drift, and
+ *  ticks the scheduler caught up late still count.
+ *
+ *  @note Can be called from tasks, and from interrupt handlers of any priority:
+ *        it reads again if the scheduler moved time on meanwhile, and never
+ *        waits for it.
+ *
+ *  @return 64 bit time, that never goes back
+ */
+uint64_t Time_ticks(void);
+uint64_t Time_us(void);
+
+/**
+ *  Get the number of ticks that passed without their own timer interrupt, the
+ *  scheduler being held off (e.g. by a critical section) for longer than a tick.
+ *  Releases and deadlines that fell due meanwhile are caught up late, when it runs
+ *  (a task due more than once is released once). Only up to 2^16 Timer A0 counts
+ *  after the tick before (2s from ACLK, 21ms from SMCLK) can be told apart.
+ *
+ *  @return Ticks caught up late, since "Task_list_init"
+ */
+uint32_t Time_missed_ticks(void);
+
+/**
+ *  Raise an event, like a port interrupt does for its pins:
+ *  activates the event's task (if any), and runs the scheduler.
+ *
+ *  @param event The event to raise, usually an "EVENT_SOFTWARE"
+ *
+ *  @note Can be called from tasks, and from interrupt handlers
+ *        of any priority.
+ */
+void Event_signal(enum events event);
+
+/**
+ *  Set up a message queue. Messages are pointers: the buffers they point to
+ *  pass from the producer to the consumer without being copied (the producer
+ *  must not touch a buffer once it has put it in the queue).
+ *
+ *  @param queue The queue
+ *  @param slots Storage for "size" message pointers
+ *  @param size Number of slots: a power of 2
+ *  @param event Event signaled whenever a message is put in the empty queue,
+ *               to activate the consumer task (usually an "EVENT_SOFTWARE"),
+ *               or EVENT_NONE
+ *
+ *  @note One task or interrupt handler puts messages, and one other gets them.
+ *        A consumer task activated by the event gets messages until the queue
+ *        is empty: a message put meanwhile activates it again if it is missed.
+ *
+ *  @return 0 if the queue was set up (1 if "size" is not a power of 2)
+ */
+uint8_t Queue_init(queue_ctrl_blk *queue, void **slots, uint32_t size, enum events event);
+
+/**
+ *  Put a message in a queue (producer side).
+ *
+ *  @param queue The queue
+ *  @param message The message
+ *
+ *  @return 0 if the message was queued (1 if the queue is full)
+ */
+uint8_t Queue_put(queue_ctrl_blk *queue, void *message);
+
+/**
+ *  Get the oldest message from a queue (consumer side).
+ *
+ *  @param queue The queue
+ *  @param message Set to the message
+ *
+ *  @return 0 if there was a message (1 if the queue is empty)
+ */
+uint8_t Queue_get(queue_ctrl_blk *queue, void **message);
+
+/**
+ *  Set up a memory pool.
+ *
+ *  @param pool The pool
+ *  @param memory Storage for the blocks, declared with "POOL_MEMORY"
+ *  @param block_size Size of each block, in bytes (at least the size of a pointer,
+ *                    rounded up to a multiple of it)
+ *  @param blocks Number of blocks
+ */
+void Pool_init(pool_ctrl_blk *pool, void *memory, uint32_t block_size, uint32_t blocks);
+
+/**
+ *  Allocate a block from a pool, in constant time.
+ *
+ *  @param pool The pool
+ *
+ *  @note Can be called from tasks, and from interrupt handlers of any priority.
+ *
+ *  @return The block (pointer aligned), or 0 if every block is in use
+ */
+void *Pool_alloc(pool_ctrl_blk *pool);
+
+/**
+ *  Give a block back to its pool, in constant time.
+ *
+ *  @param pool The pool the block was allocated from
+ *  @param block The block
+ *
+ *  @note Can be called from tasks, and from interrupt handlers of any priority.
+ *        A block freed twice is only refused if no block of the pool is allocated
+ *        then: otherwise it is not detected, and the block would be handed out twice.
+ *
+ *  @return 0 if the block was freed (1 if it is not a block of the pool, or no block
+ *          of the pool is allocated)
+ */
+uint8_t Pool_free(pool_ctrl_blk *pool, void *block);
+
+/**
+ *  Get the usage statistics of a pool.
+ *
+ *  @param pool The pool
+ *  @param stats Filled in with the pool's statistics
+ */
+void Pool_get_stats(const pool_ctrl_blk *pool, pool_stats *stats);
+
+/**
+ *  Set what happens when a task's job misses its deadline.
+ *
+ *  @param function The function of the task
+ *  @param policy OVERRUN_CONTINUE (the default), OVERRUN_ABORT or OVERRUN_SKIP
+ *
+ *  @return 0 if the task was found
+ */
+uint8_t Task_set_overrun(intptr_t function, enum overrun_policy policy);
+
+#if FATE_POLICY == FATE_POLICY_CYCLIC
+/**
+ *  Set the dispatch table of the cyclic executive. The table repeats every "cycle"
+ *  system ticks (usually the hyperperiod), and is the only thing that releases
+ *  periodic tasks: the periods and start offsets given to "Task_add" are only used
+ *  by admission control. Deadlines are counted from each release, as usual.
+ *  Entry tick t takes effect t + 1 ticks after "Task_schedule" (as a start
+ *  offset of t does), and again every cycle: the scheduler only looks up the next
+ *  entry, and the tick it is due on. "host/fate_cyclic" builds tables from a task set.
+ *
+ *  @param table Entries, in tick order (entries on the same tick take effect in
+ *               table order, the CPU going to the last one's task)
+ *  @param entries Number of entries
+ *  @param cycle Length of the cycle, in system ticks
+ *
+ *  @note Call it after every task has been added, before "Task_schedule".
+ *        The table is not copied: it must stay in memory (e.g. const).
+ *        Only periodic tasks can be released by an entry; an entry can resume an
+ *        aperiodic task, to give it a reserved time slot.
+ *
+ *  @return 0 if the table was set (1 if an entry is out of order or past the
+ *          cycle, or names a task that was not added or cannot be released)
+ */
+uint8_t Task_set_table(const cyclic_entry *table, uint32_t entries, uint32_t cycle);
+#endif
+
+#ifdef FATE_PREEMPTION_THRESHOLD
+/**
+ *  Set a task's preemption threshold: once one of its jobs has started, it is only
+ *  preempted by tasks of higher priority than the threshold task.
+ *  "host/fate_threshold" computes thresholds that keep a task set schedulable.
+ *
+ *  @param function The function of the task
+ *  @param threshold The function of the task whose priority is the threshold (the
+ *                   task's own function, the default, lets any higher priority task
+ *                   preempt it; a lower priority task is taken as the task itself)
+ *
+ *  @note Call it after every task has been added, before "Task_schedule".
+ *
+ *  @return 0 if the threshold was set
+ *          (1 if either task was not found, 2 if it failed the admission test)
+ */
+uint8_t Task_set_threshold(intptr_t function, intptr_t threshold);
+#endif
+
+#ifdef FATE_RESOURCES
+/**
+ *  Declare that a task uses a shared resource (its ceiling is the highest
+ *  preemption level of the tasks that use it).
+ *
+ *  @param function The function of the task
+ *  @param resource Resource number, below NUM_RESOURCES
+ *  @param length (FATE_ADMISSION) The task's longest critical section on the
+ *                resource, in microseconds
+ *
+ *  @note Call it after every task has been added, before "Task_schedule".
+ *
+ *  @return 0 if the use was recorded
+ *          (1 if the task or resource was not found, 2 if it failed the admission test)
+ */
+#ifdef FATE_ADMISSION
+uint8_t Resource_use(intptr_t function, uint8_t resource, uint32_t length);
+#else
+uint8_t Resource_use(intptr_t function, uint8_t resource);
+#endif
+
+/**
+ *  Lock a shared resource, from a task that declared it uses it.
+ *  Never waits: the Stack Resource Policy kept every job that could hold it
+ *  from running. Jobs of tasks at or below its ceiling are not started until
+ *  it is unlocked.
+ *
+ *  @param resource Resource number
+ *
+ *  @return 0 if it was locked (1 if there is no such resource, or it is
+ *          already locked: a task that uses it was not declared)
+ */
+uint8_t Resource_lock(uint8_t resource);
+
+/**
+ *  Unlock a shared resource, locked by the calling task. Resources are unlocked
+ *  in the reverse order they were locked in; a job that ends (or is aborted)
+ *  unlocks those it still holds.
+ *
+ *  @param resource Resource number
+ *
+ *  @return 0 if it was unlocked (1 if it is not the last resource the task locked)
+ */
+uint8_t Resource_unlock(uint8_t resource);
+#endif
+
+/**
+ *  Get the number of deadlines a task has missed.
+ *
+ *  @param function The function of the task
+ *
+ *  @return The number of misses (0 if the task was not found)
+ */
+uint32_t Task_get_misses(intptr_t function);
+
+/**
+ *  Set a function to call whenever a job misses its deadline,
+ *  before the task's overrun policy is applied.
+ *
+ *  @param handler Called with the function of the task (0 for none)
+ *
+ *  @note The handler runs in the scheduler's interrupt: it must be short,
+ *        and may only call "Event_signal" and the functions above.
+ */
+void Task_set_miss_handler(void (*handler)(intptr_t function));
+
+#ifdef FATE_PROFILE
+/**
+ *  Get the execution time statistics of a task.
+ *
+ *  @param function The function of the task (idle_thread for the idle task,
+ *                  whose every stretch of idle time counts as a job)
+ *  @param profile Filled in with the task's statistics
+ *
+ *  @return 0 if the task was found
+ */
+uint8_t Task_get_profile(intptr_t function, task_profile *profile);
+
+/**
+ *  Clear the execution time statistics of every task.
+ */
+void Task_reset_profiles(void);
+#endif
+
+#ifdef FATE_BENCH
+/**
+ *  Get the measurements of a scheduler path.
+ *
+ *  @param path The path
+ *  @param active Number of active tasks the calls finished with (0 to NUM_TASKS - 1)
+ *  @param stat Filled in with the measurements
+ *
+ *  @return 0 if the path and number of tasks are valid
+ */
+uint8_t Bench_get(enum bench_path path, uint32_t active, bench_stat *stat);
+
+/**
+ *  Clear every measurement.
+ */
+void Bench_reset(void);
+#endif
+
+#ifdef FATE_TRACE
+/**
+ *  Take the oldest record out of the trace ring buffer, e.g. to send it over a UART.
+ *
+ *  @param record Filled in with the record
+ *
+ *  @return 1 if there was a record, 0 if the buffer is empty
+ *
+ *  @note Only one context may read the trace: the idle task does when the ITM
+ *        port is enabled.
+ */
+uint8_t Trace_read(trace_record *record);
+
+/**
+ *  Get the number of records dropped because the trace ring buffer was full.
+ */
+uint32_t Trace_dropped(void);
+#endif
+
+/**
+ *  Start the task scheduler.
+ *
+ *  @note This function does not return.
+ */
+void Task_schedule(void);
+
+
+/**
+ *  List of tasks.
+ */
+extern task_ctrl_blk Task_list[NUM_TASKS];
+
+/**
+ *  List of events, and the task each one activates.
+ */
+extern event_ctrl_blk Event_task_list[NUM_EVENTS];
+
+/**
+ *  Called by each task when it finishes execution
+ *  (returning from the task function does the same).
+ *
+ *  Finds the calling task by function address in the task list
+ *  and changes its state to Stopped. It then sets the pending bit for the timer A0
+ *  interrupt so that the scheduler will run.
+ *
+ *  @note This function does not return.
+ */
+void Task_stop(intptr_t function);
+
+#endif
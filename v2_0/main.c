@@ -0,0 +1,201 @@
+#include <msp.h>
+
+//Must always include our OS header file
+#include "fate.h"
+
+
+// Prototypes
+void LED_toggle(void);
+void LED_RGB_toggle(void);
+void Task_1 (void);
+void Task_2 (void);
+void Task_3 (void);
+
+//Functions that implement our 2 periodic tasks
+//Return type and arguments must always be void
+//Each task has its own stack ("STACK_SIZE" in "fate.h"), so local variables
+//and calls to other functions are fine
+//When execution is finished, call "Task_stop" with its name (or just return)
+void LED_toggle(void)
+{
+	P1OUT ^= (uint8_t)BIT0;
+	Task_stop((intptr_t)LED_toggle);
+}
+void LED_RGB_toggle(void)
+{
+	P2OUT = (uint8_t)((P2OUT & (uint8_t)0xF8) | ((P2OUT + (uint8_t)1) & ((uint8_t)7)));
+	Task_stop((intptr_t)LED_RGB_toggle);
+}
+
+// The RGB LED (P2.0-2.2) is shared by the three tasks below: with FATE_RESOURCES,
+// every change to it is a critical section on resource RGB_LED
+#define RGB_LED 0
+
+static void RGB_set(uint8_t colour)
+{
+#ifdef FATE_RESOURCES
+    Resource_lock(RGB_LED);
+#endif
+    P2->OUT = (P2->OUT & ~((1<<0)|(1<<1)|(1<<2))) | colour;
+#ifdef FATE_RESOURCES
+    Resource_unlock(RGB_LED);
+#endif
+}
+
+// Tasks with fixed execution time
+void Task_1 (void)
+{
+    if (!(TIMER_A1->CTL & (TIMER_A_CTL_TASSEL_1))) {
+        // Timer is not already running
+        
+        // Clock from ACLK, divide by 8
+        TIMER_A1->CTL = TIMER_A_CTL_TASSEL_1 | TIMER_A_CTL_ID__8;
+        TIMER_A1->CTL |= TIMER_A_CTL_CLR;
+        // Set top
+        TIMER_A1->CCR[0] = 4096;
+    }
+    // Start in up mode
+    TIMER_A1->CTL |= TIMER_A_CTL_MC_1;
+    
+    RGB_set(1<<2);
+    
+    // Wait for overflow
+    while (!(TIMER_A1->CTL & (TIMER_A_CTL_IFG)));
+    
+    RGB_set(0);
+    
+    // Disable timer
+    TIMER_A1->CTL = 0;
+    Task_stop((intptr_t)Task_1);
+}
+
+void Task_2 (void)
+{
+    if (!(TIMER_A2->CTL & (TIMER_A_CTL_TASSEL_1))) {
+        // Timer is not already running
+        
+        // Clock from ACLK, divide by 8
+        TIMER_A2->CTL = TIMER_A_CTL_TASSEL_1 | TIMER_A_CTL_ID__8;
+        TIMER_A2->CTL |= TIMER_A_CTL_CLR;
+        // Set top
+        TIMER_A2->CCR[0] = 40960;
+    }
+    // Start in up mode
+    TIMER_A2->CTL |= TIMER_A_CTL_MC_1;
+    
+    RGB_set(1<<0);
+    
+    // Wait for overflow
+    while (!(TIMER_A2->CTL & (TIMER_A_CTL_IFG)));
+    
+    RGB_set(0);
+    
+    // Disable timer
+    TIMER_A2->CTL = 0;
+    Task_stop((intptr_t)Task_2);
+}
+
+void Task_3 (void)
+{
+    if (!(TIMER_A3->CTL & (TIMER_A_CTL_TASSEL_1))) {
+        // Timer is not already running
+        
+        // Clock from ACLK, divide by 8
+        TIMER_A3->CTL = TIMER_A_CTL_TASSEL_1 | TIMER_A_CTL_ID__8;
+        TIMER_A3->CTL |= TIMER_A_CTL_CLR;
+        // Set top
+        TIMER_A3->CCR[0] = 12288;
+    }
+    // Start in up mode
+    TIMER_A3->CTL |= TIMER_A_CTL_MC_1;
+    
+    RGB_set(1<<1);
+    
+    // Wait for overflow
+    while (!(TIMER_A3->CTL & (TIMER_A_CTL_IFG)));
+    
+    RGB_set(0);
+    
+    // Disable timer
+    TIMER_A3->CTL = 0;
+    Task_stop((intptr_t)Task_3);
+}
+
+#if FATE_POLICY == FATE_POLICY_CYCLIC
+// The EDF schedule of the three tasks below, as a dispatch table that repeats
+// every 1500 ticks (tasks are numbered in the order they are added), generated
+// from their FATE_ADMISSION "Task_add" calls by host/fate_cyclic:
+//     cd host && make fate_cyclic && ./fate_cyclic -p edf ../v2_0/main.c
+// Task_2 starts, Task_3 preempts it, Task_1 preempts Task_3, then each resumes,
+// and the CPU is idle from the end of Task_2's job until the cycle repeats
+/* fate_cyclic -p edf: cycle of 1500 ticks, 6 entries (48 bytes) */
+static const cyclic_entry schedule[] = {
+    {0, 2, CYCLIC_RELEASE}, /* Task_2 */
+    {100, 3, CYCLIC_RELEASE}, /* Task_3 */
+    {300, 1, CYCLIC_RELEASE}, /* Task_1 */
+    {400, 3, CYCLIC_RESUME}, /* Task_3 */
+    {499, 2, CYCLIC_RESUME}, /* Task_2 */
+    {1396, 0, CYCLIC_RESUME} /* idle */
+};
+#endif
+
+int main(void)
+{
+	
+	//configure Ports
+	
+	//LED p1.0 (Red)
+	P1SEL0 &= (uint8_t)(~(BIT0));
+	P1SEL1 &= (uint8_t)(~(BIT0));
+	P1DIR |= (uint8_t)BIT0;
+	P1OUT &= (uint8_t)(~(BIT0));
+	
+	//LED P2.0.1.2 (RGB)
+	P2SEL0 &= (uint8_t)(~(BIT0)|(BIT1)|(BIT2));
+	P2SEL1 &= (uint8_t)(~((BIT0)|(BIT1)|(BIT2)));
+	P2DIR |= (uint8_t)((BIT0)|(BIT1)|(BIT2));
+	P2OUT &= (uint8_t)(~((BIT0)|(BIT1)|(BIT2)));
+	
+	//Initialize Task list, includes setting up idle task
+	//Always the first function that must be called
+	Task_list_init();
+	
+	//Initialize periodic task, with periods 100
+	//Task_add((intptr_t)LED_toggle, 100, 150, 10000, 1);
+    // Aperiodic task pased on P1.4 button
+	//Task_event_add((intptr_t)LED_RGB_toggle, SWITCH_P1_4, 100, 4);
+    
+    // Priorities only matter with FATE_POLICY_FP (these follow the deadlines)
+#ifdef FATE_ADMISSION
+    // Execution times: one period of each task's timer (1s, 10s and 3s)
+    Task_add((intptr_t)Task_1, 1500, 300, 100, 3, 1000000);
+    Task_add((intptr_t)Task_2, 1500, 0, 1500, 1, 10000000);
+    Task_add((intptr_t)Task_3, 1500, 100, 700, 2, 3000000);
+#else
+    Task_add((intptr_t)Task_1, 1500, 300, 100, 3);
+    Task_add((intptr_t)Task_2, 1500, 0, 1500, 1);
+    Task_add((intptr_t)Task_3, 1500, 100, 700, 2);
+#endif
+    
+#if FATE_POLICY == FATE_POLICY_CYCLIC
+    Task_set_table(schedule, sizeof(schedule) / sizeof(schedule[0]), 1500);
+#endif
+    
+#ifdef FATE_RESOURCES
+    // Tasks that share the RGB LED (FATE_ADMISSION: critical sections of at most 10us)
+#ifdef FATE_ADMISSION
+    Resource_use((intptr_t)Task_1, RGB_LED, 10);
+    Resource_use((intptr_t)Task_2, RGB_LED, 10);
+    Resource_use((intptr_t)Task_3, RGB_LED, 10);
+#else
+    Resource_use((intptr_t)Task_1, RGB_LED);
+    Resource_use((intptr_t)Task_2, RGB_LED);
+    Resource_use((intptr_t)Task_3, RGB_LED);
+#endif
+#endif
+
+	//This will begin scheduling our tasks 
+	Task_schedule();
+	
+	return 0;
+}